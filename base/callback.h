@@ -1,7 +1,11 @@
 #ifndef BASE_CALLBACK_H_
 #define BASE_CALLBACK_H_
 
+#include <stddef.h>
+#include <cstddef>
 #include <memory>
+#include <new>
+#include <type_traits>
 #include <utility>
 #include "base/ptr_util.h"
 
@@ -38,6 +42,158 @@ template<class Closure>
 static std::unique_ptr<QueuedTask> NewClosure(Closure &&closure) {
   return base::MakeUnique<ClosureTask<Closure>>(std::forward<Closure>(closure));
 }
+
+// Move-only void() callable with inline storage. Callables that fit in
+// kInlineSize bytes and are nothrow-movable (std::bind of a member function
+// with a few arguments, small lambdas) are stored inside the object, so
+// creating, moving and destroying a SmallClosure does not allocate. Larger
+// callables fall back to the heap. A std::unique_ptr<QueuedTask> can be
+// wrapped as well. Unlike QueuedTask, a SmallClosure may be run repeatedly.
+class SmallClosure {
+public:
+ static const size_t kInlineSize = 48;
+
+ SmallClosure() : ops_(nullptr) {}
+
+ template<class Closure,
+     typename std::enable_if<
+         !std::is_same<typename std::decay<Closure>::type, SmallClosure>::value &&
+         !std::is_convertible<Closure, std::unique_ptr<QueuedTask>>::value>::type * = nullptr>
+ SmallClosure(Closure &&closure) : ops_(nullptr) {
+   typedef typename std::decay<Closure>::type Functor;
+   Init<Functor>(std::forward<Closure>(closure),
+                 std::integral_constant<bool, FitsInline<Functor>::value>());
+ }
+
+ SmallClosure(std::unique_ptr<QueuedTask> task) : ops_(nullptr) {
+   if (task)
+     Init<QueuedTaskRunner>(QueuedTaskRunner(std::move(task)), std::true_type());
+ }
+
+ SmallClosure(SmallClosure &&other) : ops_(other.ops_) {
+   if (ops_) {
+     ops_->move(&storage_, &other.storage_);
+     other.ops_ = nullptr;
+   }
+ }
+
+ SmallClosure &operator=(SmallClosure &&other) {
+   if (this != &other) {
+     reset();
+     ops_ = other.ops_;
+     if (ops_) {
+       ops_->move(&storage_, &other.storage_);
+       other.ops_ = nullptr;
+     }
+   }
+   return *this;
+ }
+
+ ~SmallClosure() {
+   reset();
+ }
+
+ void operator()() {
+   ops_->run(&storage_);
+ }
+
+ explicit operator bool() const { return ops_ != nullptr; }
+
+ void reset() {
+   if (ops_) {
+     const Ops *ops = ops_;
+     ops_ = nullptr;
+     ops->destroy(&storage_);
+   }
+ }
+
+private:
+ typedef typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type Storage;
+
+ struct Ops {
+   void (*run)(void *storage);
+   // Move-constructs into |dst| and destroys |src|.
+   void (*move)(void *dst, void *src);
+   void (*destroy)(void *storage);
+ };
+
+ struct QueuedTaskRunner {
+   explicit QueuedTaskRunner(std::unique_ptr<QueuedTask> task) : task(std::move(task)) {}
+   void operator()() { task->Run(); }
+   std::unique_ptr<QueuedTask> task;
+ };
+
+ template<class Functor>
+ struct FitsInline {
+   static const bool value = sizeof(Functor) <= kInlineSize &&
+       alignof(Functor) <= alignof(Storage) &&
+       std::is_nothrow_move_constructible<Functor>::value;
+ };
+
+ template<class Functor>
+ struct InlineOps {
+   static void Run(void *storage) {
+     (*static_cast<Functor *>(storage))();
+   }
+   static void Move(void *dst, void *src) {
+     new (dst) Functor(std::move(*static_cast<Functor *>(src)));
+     static_cast<Functor *>(src)->~Functor();
+   }
+   static void Destroy(void *storage) {
+     static_cast<Functor *>(storage)->~Functor();
+   }
+   static const Ops ops;
+ };
+
+ template<class Functor>
+ struct HeapOps {
+   static Functor *&Get(void *storage) {
+     return *static_cast<Functor **>(storage);
+   }
+   static void Run(void *storage) {
+     (*Get(storage))();
+   }
+   static void Move(void *dst, void *src) {
+     new (dst) Functor *(Get(src));
+   }
+   static void Destroy(void *storage) {
+     delete Get(storage);
+   }
+   static const Ops ops;
+ };
+
+ template<class Functor, class Closure>
+ void Init(Closure &&closure, std::true_type /* inline */) {
+   new (&storage_) Functor(std::forward<Closure>(closure));
+   ops_ = &InlineOps<Functor>::ops;
+ }
+
+ template<class Functor, class Closure>
+ void Init(Closure &&closure, std::false_type /* inline */) {
+   new (&storage_) Functor *(new Functor(std::forward<Closure>(closure)));
+   ops_ = &HeapOps<Functor>::ops;
+ }
+
+ Storage storage_;
+ const Ops *ops_;
+
+ SmallClosure(const SmallClosure &) = delete;
+ SmallClosure &operator=(const SmallClosure &) = delete;
+};
+
+template<class Functor>
+const SmallClosure::Ops SmallClosure::InlineOps<Functor>::ops = {
+    &SmallClosure::InlineOps<Functor>::Run,
+    &SmallClosure::InlineOps<Functor>::Move,
+    &SmallClosure::InlineOps<Functor>::Destroy,
+};
+
+template<class Functor>
+const SmallClosure::Ops SmallClosure::HeapOps<Functor>::ops = {
+    &SmallClosure::HeapOps<Functor>::Run,
+    &SmallClosure::HeapOps<Functor>::Move,
+    &SmallClosure::HeapOps<Functor>::Destroy,
+};
 }  // namespace base
 
 #endif  // BASE_CALLBACK_H_
@@ -72,6 +72,15 @@
 #define HAS_FEATURE(FEATURE) 0
 #endif
 
+// Branch prediction hints.
+#if defined(COMPILER_GCC)
+#define LIKELY(x) __builtin_expect(!!(x), 1)
+#define UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define LIKELY(x) (x)
+#define UNLIKELY(x) (x)
+#endif
+
 // Macro for telling -Wimplicit-fallthrough that a fallthrough is intentional.
 #if __cplusplus >= 201703L  // C++17
 #define FALLTHROUGH [[fallthrough]]
@@ -0,0 +1,65 @@
+#ifndef BASE_CONTAINERS_INTRUSIVE_MPSC_QUEUE_H_
+#define BASE_CONTAINERS_INTRUSIVE_MPSC_QUEUE_H_
+
+#include <atomic>
+#include "base/macros.h"
+
+namespace base {
+
+// Lock-free multi-producer/single-consumer queue of nodes that carry their
+// own link. T must have a public |T* next_| member, which the queue owns while
+// the node is queued; no memory is allocated by the queue itself.
+//
+// Producers push with a single compare-and-swap on the head, so a producer
+// never waits for another producer or for the consumer, and a preempted
+// producer cannot hold anybody up. The consumer detaches the whole list with
+// one exchange and reverses it into push order. Because nodes are never
+// popped one at a time, the usual ABA problem of a CAS-based stack does not
+// arise.
+template <typename T>
+class IntrusiveMpscQueue {
+ public:
+  constexpr IntrusiveMpscQueue() : head_(nullptr) {}
+
+  // The owner must drain the queue with TakeAll() before destroying it.
+  ~IntrusiveMpscQueue() {}
+
+  // Any thread. Returns true if the queue was empty, i.e. the consumer may
+  // be asleep and needs a wakeup.
+  bool Push(T* node) {
+    T* head = head_.load(std::memory_order_relaxed);
+    do {
+      node->next_ = head;
+    } while (!head_.compare_exchange_weak(head, node,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed));
+    return head == nullptr;
+  }
+
+  // Detaches every queued node and returns them linked through |next_| in
+  // the order they were pushed, or nullptr. Safe to call from several
+  // threads at once: each node is handed to exactly one caller.
+  T* TakeAll() {
+    T* node = head_.exchange(nullptr, std::memory_order_acquire);
+    T* reversed = nullptr;
+    while (node) {
+      T* next = node->next_;
+      node->next_ = reversed;
+      reversed = node;
+      node = next;
+    }
+    return reversed;
+  }
+
+  // Any thread. A snapshot.
+  bool Empty() const { return head_.load(std::memory_order_seq_cst) == nullptr; }
+
+ private:
+  std::atomic<T*> head_;
+
+  DISALLOW_COPY_AND_ASSIGN(IntrusiveMpscQueue);
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_INTRUSIVE_MPSC_QUEUE_H_
@@ -0,0 +1,119 @@
+#ifndef BASE_CONTAINERS_SPSC_RING_H_
+#define BASE_CONTAINERS_SPSC_RING_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace base {
+
+// Fixed-capacity, lock-free ring buffer for exactly one producer thread and
+// one consumer thread. TryPush() may only be called on the producer thread,
+// TryPop() and Front() only on the consumer thread. Size() may be called from
+// any thread and returns a snapshot.
+//
+// The read and write indices live on separate cache lines, and each side
+// keeps a cached copy of the other side's index so that the shared line is
+// only touched when the ring looks full (producer) or empty (consumer).
+// Indices increase monotonically and are masked into a power-of-two slot
+// array, so wrap-around of size_t is harmless.
+template <typename T>
+class SpscRing {
+ public:
+  explicit SpscRing(size_t capacity)
+      : capacity_(capacity),
+        mask_(0),
+        head_(0),
+        cached_tail_(0),
+        tail_(0),
+        cached_head_(0) {
+    DCHECK_GT(capacity, 0u);
+    size_t slots = 1;
+    while (slots < capacity)
+      slots <<= 1;
+    slots_.resize(slots);
+    mask_ = slots - 1;
+  }
+
+  ~SpscRing() {}
+
+  // Producer only. Returns false when the ring is full.
+  bool TryPush(const T& value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ >= capacity_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head - cached_tail_ >= capacity_)
+        return false;
+    }
+    slots_[head & mask_] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer only.
+  bool Full() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ < capacity_)
+      return false;
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    return head - cached_tail_ >= capacity_;
+  }
+
+  // Consumer only. Returns the oldest element without removing it, or
+  // nullptr when the ring is empty. The pointer stays valid until the next
+  // TryPop().
+  T* Front() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == cached_head_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail == cached_head_)
+        return nullptr;
+    }
+    return &slots_[tail & mask_];
+  }
+
+  // Consumer only. Returns false when the ring is empty.
+  bool TryPop(T* value) {
+    T* front = Front();
+    if (!front)
+      return false;
+    *value = *front;
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Any thread. The tail is read first so the result is never negative.
+  size_t Size() const {
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t head = head_.load(std::memory_order_acquire);
+    return head - tail;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  static const size_t kCacheLineSize = 64;
+
+  std::vector<T> slots_;
+  size_t capacity_;
+  size_t mask_;
+  char pad0_[kCacheLineSize];
+  // Written by the producer.
+  std::atomic<size_t> head_;
+  size_t cached_tail_;
+  char pad1_[kCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  // Written by the consumer.
+  std::atomic<size_t> tail_;
+  size_t cached_head_;
+  char pad2_[kCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+  DISALLOW_COPY_AND_ASSIGN(SpscRing);
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_SPSC_RING_H_
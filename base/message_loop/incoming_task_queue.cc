@@ -4,19 +4,19 @@
 
 #include "base/message_loop/incoming_task_queue.h"
 #include "base/message_loop/message_loop.h"
+#include "base/threading/platform_thread.h"
 
 namespace base {
 
 IncomingTaskQueue::IncomingTaskQueue(MessageLoop *message_loop)
     : message_loop_(message_loop),
-      message_loop_scheduled_(false),
+      posters_(0),
       is_ready_for_scheduling_(false) {
 }
 
 bool IncomingTaskQueue::AddToIncomingQueue(
-    std::unique_ptr<QueuedTask> task,
+    SmallClosure task,
     TimeDelta delay) {
-  AutoLock locked(incoming_queue_lock_);
   std::unique_ptr<PendingTask> pending_task(
       new PendingTask(std::move(task), CalculateDelayedRuntime(delay)));
   return PostPendingTask(std::move(pending_task));
@@ -26,34 +26,31 @@ void IncomingTaskQueue::ReloadWorkQueue(TaskQueue *work_queue) {
   // Make sure no tasks are lost.
   DCHECK(work_queue->empty());
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  AutoLock lock(incoming_queue_lock_);
-  if (incoming_queue_.empty()) {
-    // If the loop attempts to reload but there are no tasks in the incoming
-    // queue, that means it will go to sleep waiting for more work. If the
-    // incoming queue becomes nonempty we need to schedule it again.
-    message_loop_scheduled_ = false;
-  } else {
-    incoming_queue_.Swap(work_queue);
-  }
+  // Acquire everything from the inter-thread queue with one exchange. If it
+  // is empty the loop goes to sleep, and the next post will see an empty
+  // queue and wake it up again.
+  work_queue->Append(incoming_queue_.TakeAll());
 }
 
 void IncomingTaskQueue::WillDestroyCurrentMessageLoop() {
-  AutoLock lock(incoming_queue_lock_);
-  message_loop_ = nullptr;
+  message_loop_.store(nullptr);
+  while (posters_.load() > 0)
+    PlatformThread::YieldCurrentThread();
 }
 
 void IncomingTaskQueue::StartScheduling() {
-  AutoLock lock(incoming_queue_lock_);
-  DCHECK(!is_ready_for_scheduling_);
-  DCHECK(!message_loop_scheduled_);
-  is_ready_for_scheduling_ = true;
-  if (!incoming_queue_.empty())
-    ScheduleWork();
+  DCHECK(!is_ready_for_scheduling_.load());
+  is_ready_for_scheduling_.store(true);
+  // Pairs with the check in PostPendingTask(): either the poster sees that
+  // scheduling has started, or we see its task here.
+  if (!incoming_queue_.Empty())
+    message_loop_.load()->ScheduleWork();
 }
 
 IncomingTaskQueue::~IncomingTaskQueue() {
-  DCHECK(!message_loop_);
+  DCHECK(!message_loop_.load());
+  TaskQueue leftover;
+  leftover.Append(incoming_queue_.TakeAll());
 }
 
 TimeTicks IncomingTaskQueue::CalculateDelayedRuntime(TimeDelta delay) {
@@ -65,26 +62,20 @@ TimeTicks IncomingTaskQueue::CalculateDelayedRuntime(TimeDelta delay) {
 }
 
 bool IncomingTaskQueue::PostPendingTask(std::unique_ptr<PendingTask> task) {
-  if (!message_loop_) {
+  posters_.fetch_add(1);
+  MessageLoop *message_loop = message_loop_.load();
+  if (!message_loop) {
+    posters_.fetch_sub(1);
     task.reset();
     return false;
   }
 
-  bool was_empty = incoming_queue_.empty();
-  incoming_queue_.push(std::move(task));
-
-  if (is_ready_for_scheduling_ &&
-      !message_loop_scheduled_ && was_empty) {
-    ScheduleWork();
-  }
+  bool was_empty = incoming_queue_.Push(task.release());
+  if (was_empty && is_ready_for_scheduling_.load())
+    message_loop->ScheduleWork();
 
+  posters_.fetch_sub(1);
   return true;
 }
 
-void IncomingTaskQueue::ScheduleWork() {
-  DCHECK(is_ready_for_scheduling_);
-  message_loop_->ScheduleWork();
-  message_loop_scheduled_ = true;
-}
-
 }  // namespace base
@@ -5,23 +5,27 @@
 #ifndef BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 #define BASE_MESSAGE_LOOP_INCOMING_TASK_QUEUE_H_
 
+#include <atomic>
+#include "base/containers/intrusive_mpsc_queue.h"
 #include "base/macros.h"
 #include "base/pending_task.h"
-#include "base/synchronization/lock.h"
 #include "base/time/time.h"
-#include "base/pending_task.h"
 
 namespace base {
 
 class MessageLoop;
 
+// Tasks posted to a MessageLoop from any thread. Posting is lock-free: the
+// task is pushed onto an IntrusiveMpscQueue and the loop is woken only when
+// the queue was empty, so a poster never blocks behind another (possibly
+// preempted) poster or behind the loop thread.
 class IncomingTaskQueue {
 public:
  explicit IncomingTaskQueue(MessageLoop *message_loop);
 
  virtual ~IncomingTaskQueue();
 
- bool AddToIncomingQueue(std::unique_ptr<QueuedTask> task,
+ bool AddToIncomingQueue(SmallClosure task,
                          TimeDelta delay);
 
  void ReloadWorkQueue(TaskQueue *work_queue);
@@ -36,17 +40,15 @@ private:
 
  bool PostPendingTask(std::unique_ptr<PendingTask> task);
 
- void ScheduleWork();
-
- MessageLoop *message_loop_;
-
- bool message_loop_scheduled_;
+ // Cleared by WillDestroyCurrentMessageLoop(), which then waits for posts
+ // that are already in flight (counted in |posters_|) to finish.
+ std::atomic<MessageLoop *> message_loop_;
 
- bool is_ready_for_scheduling_;
+ std::atomic<int> posters_;
 
- base::Lock incoming_queue_lock_;
+ std::atomic<bool> is_ready_for_scheduling_;
 
- TaskQueue incoming_queue_;
+ IntrusiveMpscQueue<PendingTask> incoming_queue_;
 
  DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
 };
@@ -2,10 +2,11 @@
 #include "base/posix/eintr_wrapper.h"
 #include "base/message_loop/incoming_task_queue.h"
 
+#include <algorithm>
 #include <csignal>
 #include <unistd.h>
-#include <fcntl.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
 
 extern "C" {
 #include <event2/event.h>
@@ -14,11 +15,6 @@ extern "C" {
 
 namespace base {
 namespace {
-bool SetNonBlocking(int fd) {
-  const int flags = fcntl(fd, F_GETFL);
-  return (flags & O_NONBLOCK) || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
-}
-
 void IgnoreSigPipeSignalOnCurrentThread() {
   sigset_t sigpipe_mask;
   sigemptyset(&sigpipe_mask);
@@ -39,61 +35,60 @@ pthread_key_t GetQueuePtrTls() {
 }
 }
 
-class MessageLoop::DelayedTask {
-public:
- explicit DelayedTask(std::unique_ptr<QueuedTask> task)
-     : event_(nullptr), task_(std::move(task)) {}
+MessageLoop::DelayedTask::DelayedTask(SmallClosure task,
+                                      TimeTicks delayed_run_time,
+                                      uint64_t sequence_num)
+    : task(std::move(task)),
+      delayed_run_time(delayed_run_time),
+      sequence_num(sequence_num) {}
+
+MessageLoop::DelayedTask::DelayedTask(DelayedTask &&other) = default;
 
- virtual ~DelayedTask() {
-   if (event_) {
-     event_free(event_);
-     event_ = nullptr;
-   }
- }
+MessageLoop::DelayedTask &MessageLoop::DelayedTask::operator=(DelayedTask &&other) = default;
 
- void Run() {
-   if (task_) {
-     task_->Run();
-     task_.reset();
-   }
- }
- struct event *event_;
-private:
- std::unique_ptr<QueuedTask> task_;
- DISALLOW_COPY_AND_ASSIGN(DelayedTask);
-};
+MessageLoop::DelayedTask::~DelayedTask() = default;
+
+bool MessageLoop::DelayedTask::operator<(const DelayedTask &other) const {
+  // The heap keeps the "largest" element on top, so invert the comparison to
+  // get the earliest run time (and then the lowest sequence number) first.
+  if (delayed_run_time != other.delayed_run_time)
+    return delayed_run_time > other.delayed_run_time;
+  return sequence_num > other.sequence_num;
+}
 
 MessageLoop::MessageLoop()
     : event_base_(event_base_new()),
-      wakeup_pipe_in_(-1),
-      wakeup_pipe_out_(-1),
+      wakeup_fd_(-1),
       wakeup_event_(nullptr),
       keep_running_(true),
+      delayed_work_event_(nullptr),
+      next_sequence_num_(0),
       incoming_task_queue_(new IncomingTaskQueue(this)) {
   if (!Init())
     NOTREACHED();
 }
 
 MessageLoop::~MessageLoop() {
-  for (auto &i: delayed_tasks_) {
-    delete i;
+  // Stop new posts from scheduling work and wait out the ones in flight
+  // before the eventfd they write to is closed.
+  incoming_task_queue_->WillDestroyCurrentMessageLoop();
+
+  // Pending delayed tasks are destroyed without running.
+  delayed_work_queue_.clear();
+  if (delayed_work_event_) {
+    event_del(delayed_work_event_);
+    event_free(delayed_work_event_);
   }
-  delayed_tasks_.clear();
 
   event_del(wakeup_event_);
   event_free(wakeup_event_);
 
   IgnoreSigPipeSignalOnCurrentThread();
 
-  if (wakeup_pipe_in_ >= 0) {
-    if (IGNORE_EINTR(close(wakeup_pipe_in_)) < 0)
-      DPLOG(ERROR) << "close";
-  }
-  if (wakeup_pipe_out_ >= 0) {
-    if (IGNORE_EINTR(close(wakeup_pipe_out_)) < 0)
+  if (wakeup_fd_ >= 0) {
+    if (IGNORE_EINTR(close(wakeup_fd_)) < 0)
       DPLOG(ERROR) << "close";
   }
-  incoming_task_queue_->WillDestroyCurrentMessageLoop();
   incoming_task_queue_.reset();
   event_base_free(event_base_);
   if (current() == this)
@@ -101,31 +96,20 @@ MessageLoop::~MessageLoop() {
 }
 
 bool MessageLoop::Init() {
-  evutil_socket_t fds[2];
-  if (pipe(fds)) {
-    close(fds[0]);
-    close(fds[1]);
-    DLOG(ERROR) << "pipe() failed, errno: " << errno;
-    return false;
-  }
-  if (!SetNonBlocking(fds[0])) {
-    DLOG(ERROR) << "SetNonBlocking for pipe fd[0] failed, errno: " << errno;
-    return false;
-  }
-  if (!SetNonBlocking(fds[1])) {
-    DLOG(ERROR) << "SetNonBlocking for pipe fd[1] failed, errno: " << errno;
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    DLOG(ERROR) << "eventfd() failed, errno: " << errno;
     return false;
   }
-  wakeup_pipe_out_ = fds[0];
-  wakeup_pipe_in_ = fds[1];
   wakeup_event_ = event_new(event_base_,
-                            wakeup_pipe_out_,
+                            wakeup_fd_,
                             EV_READ | EV_PERSIST,
                             &MessageLoop::OnWakeup,
                             this);
   if (event_add(wakeup_event_, nullptr))
     return false;
-  return true;
+  delayed_work_event_ = event_new(event_base_, -1, 0, &MessageLoop::RunTimer, this);
+  return delayed_work_event_ != nullptr;
 }
 
 void MessageLoop::BindToCurrentThread() {
@@ -145,9 +129,9 @@ void MessageLoop::QuitNow() {
 }
 
 void MessageLoop::ScheduleWork() {
-  char buf = 0;
-  int nwrite = HANDLE_EINTR(write(wakeup_pipe_in_, &buf, 1));
-  DCHECK(nwrite == 1 || errno == EAGAIN)
+  uint64_t value = 1;
+  ssize_t nwrite = HANDLE_EINTR(write(wakeup_fd_, &value, sizeof(value)));
+  DCHECK(nwrite == sizeof(value) || errno == EAGAIN)
   << "[nwrite:" << nwrite << "] [errno:" << errno << "]";
 }
 
@@ -160,9 +144,12 @@ event_base *MessageLoop::base() {
 }
 
 void MessageLoop::OnWakeup(evutil_socket_t socket, short flags, void *context) {
-  char buf;
-  int nread = HANDLE_EINTR(read(socket, &buf, 1));
-  DCHECK_EQ(nread, 1);
+  // Reading resets the counter, so any number of ScheduleWork() calls since
+  // the last wakeup cost a single read.
+  uint64_t count;
+  ssize_t nread = HANDLE_EINTR(read(socket, &count, sizeof(count)));
+  DCHECK(nread == sizeof(count) || errno == EAGAIN)
+  << "[nread:" << nread << "] [errno:" << errno << "]";
 
   auto ptr = reinterpret_cast<MessageLoop *>(context);
   for (;;) {
@@ -171,8 +158,7 @@ void MessageLoop::OnWakeup(evutil_socket_t socket, short flags, void *context) {
     if (work_queue.empty())
       break;
     do {
-      std::unique_ptr<PendingTask> pending_task(std::move(work_queue.front()));
-      work_queue.pop();
+      std::unique_ptr<PendingTask> pending_task = work_queue.pop();
       if (!pending_task->delayed_run_time_.is_null()) {
         ptr->AddToDelayedWorkQueue(std::move(pending_task));
       } else {
@@ -182,7 +168,7 @@ void MessageLoop::OnWakeup(evutil_socket_t socket, short flags, void *context) {
   }
 }
 
-void MessageLoop::PostDelayedTask(std::unique_ptr<QueuedTask> task,
+void MessageLoop::PostDelayedTask(SmallClosure task,
                                   TimeDelta delay) {
   incoming_task_queue_->AddToIncomingQueue(std::move(task), delay);
 }
@@ -196,21 +182,41 @@ void MessageLoop::AddToDelayedWorkQueue(std::unique_ptr<PendingTask> task) {
   if (task->delayed_run_time_ <= now) {
     task->Run();
   } else {
-    base::TimeDelta delay = task->delayed_run_time_ - now;
-    auto delayed_task = new DelayedTask(std::move(task->task_));
-    delayed_task->event_ = event_new(event_base_, -1, EV_TIMEOUT, &MessageLoop::RunTimer, delayed_task);
-    timeval tv = {static_cast<__time_t>(delay.InSeconds()),
-                  static_cast<__suseconds_t>(delay.InMicroseconds() % Time::kMicrosecondsPerSecond)};
-    event_add(delayed_task->event_, &tv);
-    delayed_tasks_.push_back(delayed_task);
+    delayed_work_queue_.emplace_back(std::move(task->task_),
+                                     task->delayed_run_time_,
+                                     next_sequence_num_++);
+    std::push_heap(delayed_work_queue_.begin(), delayed_work_queue_.end());
+    ScheduleDelayedWork();
   }
 }
 
+void MessageLoop::ScheduleDelayedWork() {
+  if (delayed_work_queue_.empty())
+    return;
+  TimeTicks next_run_time = delayed_work_queue_.front().delayed_run_time;
+  if (!delayed_work_time_.is_null() && delayed_work_time_ <= next_run_time)
+    return;
+  TimeDelta delay = std::max(next_run_time - TimeTicks::Now(), TimeDelta());
+  timeval tv = {static_cast<__time_t>(delay.InSeconds()),
+                static_cast<__suseconds_t>(delay.InMicroseconds() % Time::kMicrosecondsPerSecond)};
+  // Adding a pending timer event reschedules it.
+  event_add(delayed_work_event_, &tv);
+  delayed_work_time_ = next_run_time;
+}
+
 void MessageLoop::RunTimer(evutil_socket_t socket, short flags, void *context) {
-  auto task = reinterpret_cast<DelayedTask *>(context);
-  task->Run();
-  auto ptr = MessageLoop::current();
-  ptr->delayed_tasks_.remove(task);
-  delete task;
+  auto ptr = reinterpret_cast<MessageLoop *>(context);
+  ptr->delayed_work_time_ = TimeTicks();
+  TimeTicks now = TimeTicks::Now();
+  while (!ptr->delayed_work_queue_.empty() &&
+         ptr->delayed_work_queue_.front().delayed_run_time <= now) {
+    std::pop_heap(ptr->delayed_work_queue_.begin(), ptr->delayed_work_queue_.end());
+    SmallClosure task(std::move(ptr->delayed_work_queue_.back().task));
+    ptr->delayed_work_queue_.pop_back();
+    task();
+    if (!ptr->keep_running_)
+      return;
+  }
+  ptr->ScheduleDelayedWork();
 }
 }
\ No newline at end of file
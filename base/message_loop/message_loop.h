@@ -5,8 +5,8 @@
 #ifndef BASE_MESSAGE_LOOP_MESSAGE_LOOP_H_
 #define BASE_MESSAGE_LOOP_MESSAGE_LOOP_H_
 
-#include <queue>
-#include <list>
+#include <stdint.h>
+#include <vector>
 #include "base/time/time.h"
 #include "base/callback.h"
 #include "base/pending_task.h"
@@ -26,7 +26,7 @@ public:
  MessageLoop();
  virtual ~MessageLoop();
 
- void PostDelayedTask(std::unique_ptr<QueuedTask> task,
+ void PostDelayedTask(SmallClosure task,
                       TimeDelta delay);
  void Run();
 
@@ -41,7 +41,23 @@ public:
 private:
  friend class Thread;
 
- class DelayedTask;
+ // A delayed task waiting in |delayed_work_queue_|. Tasks with the same run
+ // time run in the order they were posted.
+ struct DelayedTask {
+   DelayedTask(SmallClosure task,
+               TimeTicks delayed_run_time,
+               uint64_t sequence_num);
+   DelayedTask(DelayedTask &&other);
+   DelayedTask &operator=(DelayedTask &&other);
+   ~DelayedTask();
+
+   // Ordering for a min-heap on std algorithms (which build max-heaps).
+   bool operator<(const DelayedTask &other) const;
+
+   SmallClosure task;
+   TimeTicks delayed_run_time;
+   uint64_t sequence_num;
+ };
 
  bool Init();
 
@@ -51,21 +67,34 @@ private:
 
  void AddToDelayedWorkQueue(std::unique_ptr<PendingTask> task);
 
+ // Arms |delayed_work_event_| for the earliest delayed task, if it is not
+ // already armed for that time.
+ void ScheduleDelayedWork();
+
  static void OnWakeup(evutil_socket_t socket, short flags, void *context);
 
  static void RunTimer(evutil_socket_t socket, short flags, void *context);
 
  event_base *event_base_;
 
- evutil_socket_t wakeup_pipe_in_;
-
- evutil_socket_t wakeup_pipe_out_;
+ // eventfd written by ScheduleWork(). Posts made before the loop reads it
+ // are coalesced into a single counter read.
+ evutil_socket_t wakeup_fd_;
 
  event *wakeup_event_;
 
  bool keep_running_;
 
- std::list<DelayedTask *> delayed_tasks_;
+ // Min-heap of delayed tasks ordered by run time, driven by the single
+ // timer event |delayed_work_event_|.
+ std::vector<DelayedTask> delayed_work_queue_;
+
+ event *delayed_work_event_;
+
+ // The run time |delayed_work_event_| is armed for, null when idle.
+ TimeTicks delayed_work_time_;
+
+ uint64_t next_sequence_num_;
 
  std::unique_ptr<IncomingTaskQueue> incoming_task_queue_;
 
@@ -0,0 +1,63 @@
+#include "base/metrics/log_histogram.h"
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+namespace base {
+
+LogHistogram::LogHistogram() {
+  Reset();
+}
+
+LogHistogram::~LogHistogram() = default;
+
+void LogHistogram::Add(int64_t sample) {
+  if (sample < 0)
+    sample = 0;
+  ++buckets_[BucketIndex(sample)];
+  ++count_;
+  max_ = std::max(max_, sample);
+}
+
+void LogHistogram::Reset() {
+  memset(buckets_, 0, sizeof(buckets_));
+  count_ = 0;
+  max_ = 0;
+}
+
+int64_t LogHistogram::Percentile(double percentile) const {
+  if (count_ == 0)
+    return 0;
+  double rank = std::ceil(percentile / 100.0 * count_);
+  uint64_t target = rank < 1 ? 1 : std::min(static_cast<uint64_t>(rank), count_);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i];
+    if (seen >= target)
+      return std::min(BucketUpperBound(i), max_);
+  }
+  return max_;
+}
+
+// static
+int LogHistogram::BucketIndex(int64_t sample) {
+  if (sample < kSubBuckets)
+    return static_cast<int>(sample);
+  int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(sample));
+  int shift = exponent - kSubBucketBits;
+  int sub = static_cast<int>((sample >> shift) & (kSubBuckets - 1));
+  return kSubBuckets + shift * kSubBuckets + sub;
+}
+
+// static
+int64_t LogHistogram::BucketUpperBound(int index) {
+  if (index < kSubBuckets)
+    return index;
+  int shift = (index - kSubBuckets) / kSubBuckets;
+  int64_t sub = (index - kSubBuckets) % kSubBuckets;
+  int64_t lower = (kSubBuckets + sub) << shift;
+  return lower + (static_cast<int64_t>(1) << shift) - 1;
+}
+
+}  // namespace base
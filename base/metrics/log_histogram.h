@@ -0,0 +1,48 @@
+#ifndef BASE_METRICS_LOG_HISTOGRAM_H_
+#define BASE_METRICS_LOG_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "base/macros.h"
+
+namespace base {
+
+// Counts non-negative int64_t samples in log-linear buckets (8 per power of
+// two), so it can cover an unbounded run in fixed memory. Percentiles are
+// exact below 8 and otherwise within 12.5% of the true value; Max() is exact.
+// Negative samples are counted as 0. Not thread safe.
+class LogHistogram {
+public:
+ LogHistogram();
+
+ ~LogHistogram();
+
+ void Add(int64_t sample);
+
+ void Reset();
+
+ uint64_t count() const { return count_; }
+
+ // Returns the upper bound of the bucket holding the sample at |percentile|
+ // (0-100, nearest-rank), capped at Max(), or 0 when there are no samples.
+ int64_t Percentile(double percentile) const;
+
+ int64_t Max() const { return max_; }
+
+private:
+ static const int kSubBucketBits = 3;
+ static const int kSubBuckets = 1 << kSubBucketBits;
+ static const int kBucketCount = kSubBuckets + (63 - kSubBucketBits) * kSubBuckets;
+
+ static int BucketIndex(int64_t sample);
+
+ static int64_t BucketUpperBound(int index);
+
+ uint64_t buckets_[kBucketCount];
+ uint64_t count_;
+ int64_t max_;
+ DISALLOW_COPY_AND_ASSIGN(LogHistogram);
+};
+}  // namespace base
+
+#endif  // BASE_METRICS_LOG_HISTOGRAM_H_
@@ -0,0 +1,60 @@
+#include "base/metrics/sample_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace base {
+
+SampleStats::SampleStats(size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1),
+      next_(0) {
+  samples_.reserve(capacity_);
+}
+
+SampleStats::~SampleStats() = default;
+
+void SampleStats::Add(int64_t sample) {
+  if (samples_.size() < capacity_) {
+    samples_.push_back(sample);
+    return;
+  }
+  samples_[next_] = sample;
+  next_ = (next_ + 1) % capacity_;
+}
+
+void SampleStats::Reset() {
+  samples_.clear();
+  next_ = 0;
+}
+
+size_t SampleStats::count() const {
+  return samples_.size();
+}
+
+int64_t SampleStats::Percentile(double percentile) const {
+  if (samples_.empty())
+    return 0;
+  std::vector<int64_t> sorted(samples_);
+  double rank = std::ceil(percentile / 100.0 * sorted.size());
+  size_t index = rank < 1 ? 0 : static_cast<size_t>(rank) - 1;
+  index = std::min(index, sorted.size() - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+  return sorted[index];
+}
+
+int64_t SampleStats::Max() const {
+  if (samples_.empty())
+    return 0;
+  return *std::max_element(samples_.begin(), samples_.end());
+}
+
+double SampleStats::Mean() const {
+  if (samples_.empty())
+    return 0;
+  double sum = 0;
+  for (int64_t sample : samples_)
+    sum += sample;
+  return sum / samples_.size();
+}
+
+}  // namespace base
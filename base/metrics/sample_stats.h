@@ -0,0 +1,44 @@
+#ifndef BASE_METRICS_SAMPLE_STATS_H_
+#define BASE_METRICS_SAMPLE_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "base/macros.h"
+
+namespace base {
+
+// Collects int64_t samples and answers percentile queries over them.
+// Only the most recent |capacity| samples are kept, older ones are
+// overwritten, so memory stays bounded for long running sessions.
+// Not thread safe.
+class SampleStats {
+public:
+ explicit SampleStats(size_t capacity = 4096);
+
+ ~SampleStats();
+
+ void Add(int64_t sample);
+
+ void Reset();
+
+ // Number of samples currently kept, at most |capacity|.
+ size_t count() const;
+
+ // Returns the sample at |percentile| (0-100) using the nearest-rank
+ // method, or 0 when there are no samples.
+ int64_t Percentile(double percentile) const;
+
+ int64_t Max() const;
+
+ double Mean() const;
+
+private:
+ std::vector<int64_t> samples_;
+ size_t capacity_;
+ size_t next_;
+ DISALLOW_COPY_AND_ASSIGN(SampleStats);
+};
+}  // namespace base
+
+#endif  // BASE_METRICS_SAMPLE_STATS_H_
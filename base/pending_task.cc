@@ -4,23 +4,106 @@
 
 #include "base/pending_task.h"
 
+#include <new>
+#include "base/containers/intrusive_mpsc_queue.h"
+
 namespace base {
 
-PendingTask::PendingTask(std::unique_ptr<QueuedTask> task,
+namespace {
+
+// A recycled PendingTask. Only the storage is reused, so the link lives in
+// the node itself rather than in the (destroyed) PendingTask.
+union FreeNode {
+  FreeNode *next_;
+  alignas(PendingTask) char storage[sizeof(PendingTask)];
+};
+
+// Nodes freed on any thread. Allocating threads take the whole list at once
+// into their own cache, so the shared list is touched once per batch rather
+// than once per task.
+IntrusiveMpscQueue<FreeNode> g_free_nodes;
+
+struct LocalCache {
+  FreeNode *head = nullptr;
+
+  ~LocalCache() {
+    while (head) {
+      FreeNode *node = head;
+      head = node->next_;
+      g_free_nodes.Push(node);
+    }
+  }
+};
+
+thread_local LocalCache t_cache;
+
+}  // namespace
+
+// static
+void *PendingTask::operator new(size_t size) {
+  if (size != sizeof(FreeNode))
+    return ::operator new(size);
+  LocalCache &cache = t_cache;
+  if (!cache.head)
+    cache.head = g_free_nodes.TakeAll();
+  if (FreeNode *node = cache.head) {
+    cache.head = node->next_;
+    return node;
+  }
+  return ::operator new(sizeof(FreeNode));
+}
+
+// static
+void PendingTask::operator delete(void *ptr, size_t size) {
+  if (!ptr)
+    return;
+  if (size != sizeof(FreeNode)) {
+    ::operator delete(ptr);
+    return;
+  }
+  g_free_nodes.Push(static_cast<FreeNode *>(ptr));
+}
+
+PendingTask::PendingTask(SmallClosure task,
                          base::TimeTicks delayed_run_time)
     : task_(std::move(task)),
-      delayed_run_time_(delayed_run_time) {}
+      delayed_run_time_(delayed_run_time),
+      next_(nullptr) {}
 
 PendingTask::~PendingTask() = default;
 
 void PendingTask::Run() {
   if (task_) {
-    task_->Run();
+    task_();
     task_.reset();
   }
 }
 
-void TaskQueue::Swap(TaskQueue *queue) {
-  c.swap(queue->c);
+TaskQueue::TaskQueue() : head_(nullptr), tail_(nullptr) {}
+
+TaskQueue::~TaskQueue() {
+  while (!empty())
+    pop();
+}
+
+void TaskQueue::Append(PendingTask *first) {
+  if (!first)
+    return;
+  if (tail_)
+    tail_->next_ = first;
+  else
+    head_ = first;
+  tail_ = first;
+  while (tail_->next_)
+    tail_ = tail_->next_;
+}
+
+std::unique_ptr<PendingTask> TaskQueue::pop() {
+  PendingTask *task = head_;
+  head_ = task->next_;
+  if (!head_)
+    tail_ = nullptr;
+  task->next_ = nullptr;
+  return std::unique_ptr<PendingTask>(task);
 }
 }  // namespace base
@@ -5,7 +5,7 @@
 #ifndef BASE_PENDING_TASK_H_
 #define BASE_PENDING_TASK_H_
 
-#include <queue>
+#include <memory>
 #include "base/time/time.h"
 #include "base/callback.h"
 
@@ -13,22 +13,47 @@ namespace base {
 
 class PendingTask {
 public:
- explicit PendingTask(std::unique_ptr<QueuedTask> task,
+ explicit PendingTask(SmallClosure task,
                       base::TimeTicks delayed_run_time);
 
  virtual ~PendingTask();
 
+ // PendingTasks are recycled through a process-wide free list instead of
+ // going back to malloc, so posting a task whose closure fits inline in
+ // SmallClosure does not allocate once the pool is warm.
+ static void *operator new(size_t size);
+
+ static void operator delete(void *ptr, size_t size);
+
  void Run();
 
- std::unique_ptr<QueuedTask> task_;
+ SmallClosure task_;
  base::TimeTicks delayed_run_time_;
+ // Intrusive link used by IncomingTaskQueue and TaskQueue, so queueing a
+ // task does not allocate.
+ PendingTask *next_;
 private:
  DISALLOW_COPY_AND_ASSIGN(PendingTask);
 };
 
-class TaskQueue : public std::queue<std::unique_ptr<PendingTask>> {
+// FIFO of PendingTasks linked through |next_|. Owns the queued tasks.
+class TaskQueue {
 public:
- void Swap(TaskQueue *queue);
+ TaskQueue();
+
+ ~TaskQueue();
+
+ bool empty() const { return head_ == nullptr; }
+
+ // Takes ownership of a chain of tasks linked through |next_|.
+ void Append(PendingTask *first);
+
+ std::unique_ptr<PendingTask> pop();
+
+private:
+ PendingTask *head_;
+ PendingTask *tail_;
+ DISALLOW_COPY_AND_ASSIGN(TaskQueue);
 };
 
 }  // namespace base
@@ -0,0 +1,61 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/synchronization/condition_variable.h"
+
+#include <ctime>
+#include "base/logging.h"
+
+namespace base {
+
+ConditionVariable::ConditionVariable(Lock *user_lock)
+    : user_mutex_(&user_lock->native_handle_) {
+  pthread_condattr_t attrs;
+  pthread_condattr_init(&attrs);
+  pthread_condattr_setclock(&attrs, CLOCK_MONOTONIC);
+  int rv = pthread_cond_init(&condition_, &attrs);
+  pthread_condattr_destroy(&attrs);
+  DCHECK_EQ(0, rv);
+}
+
+ConditionVariable::~ConditionVariable() {
+  int rv = pthread_cond_destroy(&condition_);
+  DCHECK_EQ(0, rv);
+}
+
+void ConditionVariable::Wait() {
+  int rv = pthread_cond_wait(&condition_, user_mutex_);
+  DCHECK_EQ(0, rv);
+}
+
+void ConditionVariable::TimedWait(const TimeDelta &max_time) {
+  int64_t usecs = max_time.InMicroseconds();
+  if (usecs < 0)
+    usecs = 0;
+
+  struct timespec absolute_time{};
+  clock_gettime(CLOCK_MONOTONIC, &absolute_time);
+  absolute_time.tv_sec += usecs / Time::kMicrosecondsPerSecond;
+  absolute_time.tv_nsec +=
+      (usecs % Time::kMicrosecondsPerSecond) * Time::kNanosecondsPerMicrosecond;
+  if (absolute_time.tv_nsec >= Time::kNanosecondsPerSecond) {
+    absolute_time.tv_sec++;
+    absolute_time.tv_nsec -= Time::kNanosecondsPerSecond;
+  }
+
+  int rv = pthread_cond_timedwait(&condition_, user_mutex_, &absolute_time);
+  DCHECK(rv == 0 || rv == ETIMEDOUT);
+}
+
+void ConditionVariable::Broadcast() {
+  int rv = pthread_cond_broadcast(&condition_);
+  DCHECK_EQ(0, rv);
+}
+
+void ConditionVariable::Signal() {
+  int rv = pthread_cond_signal(&condition_);
+  DCHECK_EQ(0, rv);
+}
+
+}  // namespace base
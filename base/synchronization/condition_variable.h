@@ -0,0 +1,55 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// ConditionVariable wraps pthreads condition variable synchronization.
+// A ConditionVariable is always bound to a user supplied Lock, which must be
+// held by the caller of Wait() and TimedWait(). Wait() atomically releases
+// the lock, blocks, and re-acquires the lock before returning.
+//
+// As with all condition variables, spurious wakeups are possible, so callers
+// must re-check their predicate in a loop:
+//
+//   AutoLock l(lock_);
+//   while (!ready_)
+//     cond_.Wait();
+
+#ifndef BASE_SYNCHRONIZATION_CONDITION_VARIABLE_H_
+#define BASE_SYNCHRONIZATION_CONDITION_VARIABLE_H_
+
+#include <pthread.h>
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+
+namespace base {
+
+class ConditionVariable {
+public:
+ // Construct a cv for use with ONLY one user lock.
+ explicit ConditionVariable(Lock *user_lock);
+
+ ~ConditionVariable();
+
+ // Wait() releases the caller's critical section atomically as it starts to
+ // sleep, and the reacquires it when it is signaled.
+ void Wait();
+
+ // Same as Wait(), but gives up after |max_time| on the monotonic clock.
+ void TimedWait(const TimeDelta &max_time);
+
+ // Broadcast() revives all waiting threads.
+ void Broadcast();
+
+ // Signal() revives one waiting thread.
+ void Signal();
+
+private:
+ pthread_cond_t condition_{};
+ pthread_mutex_t *user_mutex_;
+ DISALLOW_COPY_AND_ASSIGN(ConditionVariable);
+};
+
+}  // namespace base
+
+#endif  // BASE_SYNCHRONIZATION_CONDITION_VARIABLE_H_
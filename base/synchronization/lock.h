@@ -15,6 +15,9 @@ public:
  bool Try();
 
 private:
+ // ConditionVariable needs the underlying mutex to wait on.
+ friend class ConditionVariable;
+
  pthread_mutex_t native_handle_{};
  DISALLOW_COPY_AND_ASSIGN(Lock);
 };
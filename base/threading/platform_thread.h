@@ -174,6 +174,12 @@ class PlatformThread {
 
   static ThreadPriority GetCurrentThreadPriority();
 
+  // Sets how far the kernel may defer the current thread's timer expirations
+  // (timerfd, epoll_wait timeouts, nanosleep) to batch them with other
+  // wakeups. The default is 50us. Ignored by the kernel for real-time
+  // threads, which never get slack.
+  static void SetCurrentThreadTimerSlack(TimeDelta slack);
+
  private:
   DISALLOW_IMPLICIT_CONSTRUCTORS(PlatformThread);
 };
@@ -8,6 +8,8 @@
 #include <sched.h>
 #include <stddef.h>
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/threading/platform_thread_internal_posix.h"
 
@@ -71,6 +73,15 @@ void PlatformThread::SetName(const std::string &name) {
     DPLOG(ERROR) << "prctl(PR_SET_NAME)";
 }
 
+// static
+void PlatformThread::SetCurrentThreadTimerSlack(TimeDelta slack) {
+  // A value of 0 restores the default slack, so ask for at least 1ns.
+  unsigned long slack_ns = std::max<int64_t>(
+      slack.InMicroseconds() * Time::kNanosecondsPerMicrosecond, 1);
+  if (prctl(PR_SET_TIMERSLACK, slack_ns) < 0)
+    DPLOG(ERROR) << "prctl(PR_SET_TIMERSLACK)";
+}
+
 size_t GetDefaultThreadStackSize(const pthread_attr_t &attributes) {
   // ThreadSanitizer bloats the stack heavily. Evidence has been that the
   // default stack size isn't enough for some browser tests.
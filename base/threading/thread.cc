@@ -121,11 +121,20 @@ void Thread::ThreadMain() {
 }
 
 void Thread::PostTask(std::unique_ptr<QueuedTask> task) {
-  PostDelayedTask(std::move(task), TimeDelta());
+  PostDelayedTask(SmallClosure(std::move(task)), TimeDelta());
 }
 
 void Thread::PostDelayedTask(std::unique_ptr<QueuedTask> task,
                              const base::TimeDelta &delay) {
+  PostDelayedTask(SmallClosure(std::move(task)), delay);
+}
+
+void Thread::PostTask(SmallClosure task) {
+  PostDelayedTask(std::move(task), TimeDelta());
+}
+
+void Thread::PostDelayedTask(SmallClosure task,
+                             const base::TimeDelta &delay) {
   message_loop_->PostDelayedTask(std::move(task), delay);
 }
 }  // namespace base
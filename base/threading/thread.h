@@ -28,6 +28,11 @@ public:
  void PostDelayedTask(std::unique_ptr<QueuedTask> task,
                       const base::TimeDelta &delay);
 
+ void PostTask(SmallClosure task);
+
+ void PostDelayedTask(SmallClosure task,
+                      const base::TimeDelta &delay);
+
  // std::enable_if is used here to make sure that calls to PostTask() with
  // std::unique_ptr<SomeClassDerivedFromQueuedTask> would not end up being
  // caught by this template.
@@ -36,7 +41,7 @@ public:
          Closure,
          std::unique_ptr<QueuedTask>>::value>::type * = nullptr>
  void PostTask(Closure &&closure) {
-   PostTask(NewClosure(std::forward<Closure>(closure)));
+   PostTask(SmallClosure(std::forward<Closure>(closure)));
  }
 
  // See documentation above for performance expectations.
@@ -45,7 +50,7 @@ public:
          Closure,
          std::unique_ptr<QueuedTask>>::value>::type * = nullptr>
  void PostDelayedTask(Closure &&closure, const base::TimeDelta &delay) {
-   PostDelayedTask(NewClosure(std::forward<Closure>(closure)), delay);
+   PostDelayedTask(SmallClosure(std::forward<Closure>(closure)), delay);
  }
 
  // Returns the name of this thread (for display in debugger too).
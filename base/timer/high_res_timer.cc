@@ -0,0 +1,147 @@
+#include "base/timer/high_res_timer.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/message_loop/message_loop.h"
+#include <event2/event.h>
+
+namespace base {
+namespace {
+struct timespec ToTimeSpec(TimeTicks ticks) {
+  // TimeTicks counts microseconds of CLOCK_MONOTONIC.
+  return (ticks - TimeTicks()).ToTimeSpec();
+}
+}
+
+HighResTimer::HighResTimer()
+    : timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      event_(nullptr),
+      running_(false),
+      missed_periods_(0),
+      generation_(0) {
+  if (timer_fd_ < 0)
+    DPLOG(ERROR) << "timerfd_create";
+}
+
+HighResTimer::~HighResTimer() {
+  Stop();
+  if (event_) {
+    event_free(event_);
+    event_ = nullptr;
+  }
+  if (timer_fd_ >= 0)
+    IGNORE_EINTR(close(timer_fd_));
+}
+
+void HighResTimer::StartAt(SmallClosure task, TimeTicks deadline) {
+  Arm(std::move(task), deadline, TimeDelta());
+}
+
+void HighResTimer::Start(SmallClosure task, const TimeDelta &delay) {
+  Arm(std::move(task), TimeTicks::Now() + delay, TimeDelta());
+}
+
+void HighResTimer::StartPeriodic(SmallClosure task,
+                                 TimeTicks first_deadline,
+                                 const TimeDelta &interval) {
+  DCHECK(interval > TimeDelta());
+  Arm(std::move(task), first_deadline, interval);
+}
+
+void HighResTimer::Stop() {
+  ++generation_;
+  running_ = false;
+  task_.reset();
+  if (event_)
+    event_del(event_);
+  if (timer_fd_ >= 0) {
+    struct itimerspec spec = {};
+    timerfd_settime(timer_fd_, 0, &spec, nullptr);
+  }
+}
+
+void HighResTimer::Arm(SmallClosure task, TimeTicks deadline, const TimeDelta &interval) {
+  Stop();
+
+  struct event_base *ev = MessageLoop::current()->base();
+  if (!ev) return;
+
+  if (!event_) {
+    if (timer_fd_ >= 0)
+      event_ = event_new(ev, timer_fd_, EV_READ | EV_PERSIST, &HighResTimer::RunTimer, this);
+    else
+      event_ = event_new(ev, -1, EV_TIMEOUT, &HighResTimer::RunTimer, this);
+  }
+  task_ = std::move(task);
+  deadline_ = deadline;
+  interval_ = interval;
+  missed_periods_ = 0;
+  running_ = true;
+
+  if (timer_fd_ < 0) {
+    AddTimeout();
+    return;
+  }
+  struct itimerspec spec;
+  spec.it_value = ToTimeSpec(deadline);
+  spec.it_interval = interval.ToTimeSpec();
+  // A zero it_value would disarm the timer instead of firing now.
+  if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+    spec.it_value.tv_nsec = 1;
+  if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    DPLOG(ERROR) << "timerfd_settime";
+    return;
+  }
+  event_add(event_, nullptr);
+}
+
+void HighResTimer::AddTimeout() {
+  TimeDelta delay = deadline_ - TimeTicks::Now();
+  if (delay < TimeDelta())
+    delay = TimeDelta();
+  timeval tv = {static_cast<__time_t>(delay.InSeconds()),
+                static_cast<__suseconds_t>(delay.InMicroseconds() % Time::kMicrosecondsPerSecond)};
+  event_add(event_, &tv);
+}
+
+// static
+void HighResTimer::RunTimer(evutil_socket_t /*fd*/, short /*event*/, void *arg) {
+  auto timer = reinterpret_cast<HighResTimer *>(arg);
+  if (!timer->running_)
+    return;
+
+  uint64_t expirations = 1;
+  if (timer->timer_fd_ >= 0) {
+    ssize_t n = HANDLE_EINTR(read(timer->timer_fd_, &expirations, sizeof(expirations)));
+    // EAGAIN: the timer was re-armed after the expiration was reported.
+    if (n != sizeof(expirations))
+      return;
+  } else if (timer->interval_ > TimeDelta()) {
+    // Count the periods the libevent timeout slept through, as timerfd does.
+    TimeTicks now = TimeTicks::Now();
+    expirations = (now - timer->deadline_) / timer->interval_ + 1;
+  }
+
+  if (timer->interval_ > TimeDelta()) {
+    timer->missed_periods_ += expirations - 1;
+    timer->deadline_ += timer->interval_ * static_cast<int64_t>(expirations);
+    if (timer->timer_fd_ < 0)
+      timer->AddTimeout();
+  } else {
+    timer->running_ = false;
+    if (timer->timer_fd_ >= 0)
+      event_del(timer->event_);
+  }
+
+  // The task may restart or stop the timer, which replaces task_ while it
+  // runs. Put it back only if that did not happen.
+  uint64_t generation = timer->generation_;
+  SmallClosure task(std::move(timer->task_));
+  task();
+  if (timer->generation_ == generation && timer->running_)
+    timer->task_ = std::move(task);
+}
+}  // namespace base
@@ -0,0 +1,103 @@
+#ifndef BASE_TIMER_HIGH_RES_TIMER_H_
+#define BASE_TIMER_HIGH_RES_TIMER_H_
+
+#include <stdint.h>
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "base/callback.h"
+
+extern "C" {
+#include <event2/util.h>
+}
+
+struct event;
+
+namespace base {
+
+// Timer with absolute deadlines on CLOCK_MONOTONIC, backed by a timerfd armed
+// with TFD_TIMER_ABSTIME and watched by the current MessageLoop. Unlike Timer,
+// which converts a relative delay into a libevent timeout when it is started,
+// the deadline does not depend on when Start*() is called, so re-arming from
+// the callback for deadline + interval cannot accumulate drift.
+//
+// Must be started, stopped and destroyed on the thread of the MessageLoop it
+// runs on. The task may restart or stop the timer. If timerfd is not
+// available, the deadline is turned into a libevent timeout instead.
+class HighResTimer {
+public:
+ HighResTimer();
+
+ virtual ~HighResTimer();
+
+ // Runs |task| once at |deadline|. A deadline in the past runs the task on
+ // the next loop iteration.
+ void StartAt(SmallClosure task, TimeTicks deadline);
+
+ // Same as StartAt(task, TimeTicks::Now() + delay).
+ void Start(SmallClosure task, const TimeDelta &delay);
+
+ // Runs |task| at |first_deadline| and then every |interval|. The schedule
+ // is kept by the kernel: a late callback does not move later deadlines, and
+ // periods that expire while the task is late are merged into one callback
+ // and counted in missed_periods().
+ void StartPeriodic(SmallClosure task,
+                    TimeTicks first_deadline,
+                    const TimeDelta &interval);
+
+ template<class Closure>
+ void StartAt(Closure &&closure, TimeTicks deadline) {
+   StartAt(SmallClosure(std::forward<Closure>(closure)), deadline);
+ }
+
+ template<class Closure>
+ void Start(Closure &&closure, const TimeDelta &delay) {
+   Start(SmallClosure(std::forward<Closure>(closure)), delay);
+ }
+
+ template<class Closure>
+ void StartPeriodic(Closure &&closure,
+                    TimeTicks first_deadline,
+                    const TimeDelta &interval) {
+   StartPeriodic(SmallClosure(std::forward<Closure>(closure)), first_deadline, interval);
+ }
+
+ void Stop();
+
+ bool IsRunning() const { return running_; }
+
+ // The deadline of the next run.
+ TimeTicks deadline() const { return deadline_; }
+
+ uint64_t missed_periods() const { return missed_periods_; }
+
+private:
+ void Arm(SmallClosure task, TimeTicks deadline, const TimeDelta &interval);
+
+ // Without timerfd: arms the libevent timeout for |deadline_|.
+ void AddTimeout();
+
+ static void RunTimer(evutil_socket_t fd, short event, void *arg);
+
+ int timer_fd_;
+
+ struct event *event_;
+
+ bool running_;
+
+ TimeTicks deadline_;
+
+ // Zero for a one-shot timer.
+ TimeDelta interval_;
+
+ uint64_t missed_periods_;
+
+ // Bumped by every Start*() and Stop(), so RunTimer can tell whether the
+ // task replaced itself while it ran.
+ uint64_t generation_;
+
+ SmallClosure task_;
+ DISALLOW_COPY_AND_ASSIGN(HighResTimer);
+};
+}  // namespace base
+
+#endif  // BASE_TIMER_HIGH_RES_TIMER_H_
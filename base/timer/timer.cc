@@ -20,6 +20,11 @@ Timer::~Timer() {
 
 void Timer::Start(std::unique_ptr<QueuedTask> task,
                   const TimeDelta &delay) {
+  Start(SmallClosure(std::move(task)), delay);
+}
+
+void Timer::Start(SmallClosure task,
+                  const TimeDelta &delay) {
   Stop();
 
   struct event_base *ev = MessageLoop::current()->base();
@@ -47,6 +52,12 @@ void Timer::Stop() {
 
 void Timer::RunTimer(evutil_socket_t listener, short event, void *arg) {
   auto timer = reinterpret_cast<Timer *>(arg);
-  timer->task_->Run();
+  if (timer->is_repeating_) {
+    timer->task_();
+    return;
+  }
+  // The task may restart this timer, which replaces task_ while it runs.
+  SmallClosure task(std::move(timer->task_));
+  task();
 }
 }  // namespace base
@@ -23,12 +23,17 @@ public:
  void Start(std::unique_ptr<QueuedTask> task,
             const TimeDelta &delay);
 
+ // Re-arming from inside the task is allowed; small closures are stored
+ // inline, so a timer restarted on every tick does not allocate.
+ void Start(SmallClosure task,
+            const TimeDelta &delay);
+
  template<class Closure,
      typename std::enable_if<!std::is_convertible<
          Closure,
          std::unique_ptr<QueuedTask>>::value>::type * = nullptr>
  void Start(Closure &&closure, const base::TimeDelta &delay) {
-   Start(NewClosure(std::forward<Closure>(closure)), delay);
+   Start(SmallClosure(std::forward<Closure>(closure)), delay);
  }
 
  void Stop();
@@ -41,7 +46,7 @@ private:
 
  struct event *event_;
 
- std::unique_ptr<QueuedTask> task_;
+ SmallClosure task_;
  DISALLOW_COPY_AND_ASSIGN(Timer);
 };
 }  // namespace base
@@ -0,0 +1,94 @@
+#ifndef BASE_TRACE_EVENT_TRACE_EVENT_H_
+#define BASE_TRACE_EVENT_TRACE_EVENT_H_
+
+// Low-overhead tracing in the Chrome trace-event format.
+//
+//   TRACE_EVENT0("decoder", "RKMppDecoder::SendInput");
+//   TRACE_EVENT1("render", "VideoView::paint", "pts", pts);
+//
+// record a slice covering the rest of the enclosing scope. Flow events with
+// the same name and id draw arrows between the slices enclosing them, across
+// threads, which is how a frame is followed from demux to paint by its pts:
+//
+//   TRACE_EVENT_FLOW_BEGIN0("media", "VideoFrame", pts);  // demux
+//   TRACE_EVENT_FLOW_STEP0("media", "VideoFrame", pts);   // decode, queue
+//   TRACE_EVENT_FLOW_END0("media", "VideoFrame", pts);    // paint
+//
+// Category, name and argument name must be string literals. Arguments are
+// only evaluated while tracing is enabled.
+//
+// Tracing is started with TraceLog::SetEnabled() and written out with
+// TraceLog::WriteJsonFile(). While it is off every macro costs one relaxed
+// load and a well-predicted branch. Building with ENABLE_TRACE_EVENTS=0
+// removes the macros entirely.
+
+#include "base/compiler_specific.h"
+#include "base/trace_event/trace_log.h"
+
+#if !defined(ENABLE_TRACE_EVENTS)
+#define ENABLE_TRACE_EVENTS 1
+#endif
+
+#if ENABLE_TRACE_EVENTS
+
+#define TRACE_EVENT_CONCAT_INTERNAL(a, b) a##b
+#define TRACE_EVENT_CONCAT(a, b) TRACE_EVENT_CONCAT_INTERNAL(a, b)
+#define TRACE_EVENT_UID(prefix) TRACE_EVENT_CONCAT(prefix, __LINE__)
+
+#define TRACE_EVENT1(category, name, arg_name, arg_value)                    \
+  base::trace_event::ScopedTraceEvent TRACE_EVENT_UID(trace_event_scope_);   \
+  if (UNLIKELY(base::trace_event::TraceLog::IsEnabled()))                    \
+    TRACE_EVENT_UID(trace_event_scope_).Begin(                               \
+        category, name, arg_name, static_cast<int64_t>(arg_value))
+
+#define TRACE_EVENT0(category, name) TRACE_EVENT1(category, name, nullptr, 0)
+
+#define TRACE_EVENT_ADD_INTERNAL(phase, category, name, id, arg_name, arg_value) \
+  do {                                                                       \
+    if (UNLIKELY(base::trace_event::TraceLog::IsEnabled()))                  \
+      base::trace_event::TraceLog::GetInstance()->AddEvent(                  \
+          phase, category, name, static_cast<uint64_t>(id), arg_name,       \
+          static_cast<int64_t>(arg_value));                                  \
+  } while (0)
+
+#else  // ENABLE_TRACE_EVENTS
+
+#define TRACE_EVENT1(category, name, arg_name, arg_value)
+#define TRACE_EVENT0(category, name)
+#define TRACE_EVENT_ADD_INTERNAL(phase, category, name, id, arg_name, arg_value) \
+  do {                                                                       \
+  } while (0)
+
+#endif  // ENABLE_TRACE_EVENTS
+
+#define TRACE_EVENT_INSTANT0(category, name)                                 \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseInstant, category, name, \
+                           0, nullptr, 0)
+
+#define TRACE_EVENT_INSTANT1(category, name, arg_name, arg_value)            \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseInstant, category, name, \
+                           0, arg_name, arg_value)
+
+#define TRACE_EVENT_FLOW_BEGIN0(category, name, id)                            \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseFlowBegin, category, name, \
+                           id, nullptr, 0)
+
+#define TRACE_EVENT_FLOW_STEP0(category, name, id)                            \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseFlowStep, category, name, \
+                           id, nullptr, 0)
+
+#define TRACE_EVENT_FLOW_END0(category, name, id)                            \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseFlowEnd, category, name, \
+                           id, nullptr, 0)
+
+// Async slices may begin and end on different threads, e.g. the time a frame
+// spends in a queue.
+#define TRACE_EVENT_ASYNC_BEGIN0(category, name, id)                            \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseAsyncBegin, category, name, \
+                           id, nullptr, 0)
+
+#define TRACE_EVENT_ASYNC_END0(category, name, id)                            \
+  TRACE_EVENT_ADD_INTERNAL(base::trace_event::kPhaseAsyncEnd, category, name, \
+                           id, nullptr, 0)
+
+#endif  // BASE_TRACE_EVENT_TRACE_EVENT_H_
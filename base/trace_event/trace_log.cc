@@ -0,0 +1,258 @@
+#include "base/trace_event/trace_log.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "base/logging.h"
+#include "base/time/time.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+// Retires the calling thread's ring when the thread exits.
+struct ThreadBufferHolder {
+  ThreadTraceBuffer *buffer = nullptr;
+
+  ~ThreadBufferHolder() {
+    if (buffer)
+      buffer->Retire();
+  }
+};
+
+thread_local ThreadBufferHolder t_buffer;
+
+std::string CurrentThreadName() {
+  char name[17] = {};
+  if (prctl(PR_GET_NAME, name) < 0)
+    return std::string();
+  return name;
+}
+
+void AppendEscaped(std::string *out, const char *str) {
+  out->push_back('"');
+  for (const char *p = str; *p; ++p) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out->append(escaped);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendEvent(std::string *out, int pid, PlatformThreadId tid, const TraceEvent &event) {
+  char buf[128];
+  out->append("{\"ph\":\"");
+  out->push_back(event.phase);
+  out->append("\",\"cat\":");
+  AppendEscaped(out, event.category);
+  out->append(",\"name\":");
+  AppendEscaped(out, event.name);
+  snprintf(buf, sizeof(buf), ",\"pid\":%d,\"tid\":%d,\"ts\":%" PRId64,
+           pid, static_cast<int>(tid), event.timestamp_us);
+  out->append(buf);
+  switch (event.phase) {
+    case kPhaseComplete:
+      snprintf(buf, sizeof(buf), ",\"dur\":%" PRId64, event.duration_us);
+      out->append(buf);
+      break;
+    case kPhaseInstant:
+      out->append(",\"s\":\"t\"");
+      break;
+    case kPhaseFlowEnd:
+      // Bind to the slice enclosing the event, like the begin and steps.
+      snprintf(buf, sizeof(buf), ",\"bp\":\"e\",\"id\":\"0x%" PRIx64 "\"", event.id);
+      out->append(buf);
+      break;
+    default:
+      snprintf(buf, sizeof(buf), ",\"id\":\"0x%" PRIx64 "\"", event.id);
+      out->append(buf);
+      break;
+  }
+  if (event.arg_name) {
+    out->append(",\"args\":{");
+    AppendEscaped(out, event.arg_name);
+    snprintf(buf, sizeof(buf), ":%" PRId64 "}", event.arg_value);
+    out->append(buf);
+  }
+  out->append("}");
+}
+
+}  // namespace
+
+ThreadTraceBuffer::ThreadTraceBuffer(size_t capacity)
+    : slots_(new Slot[capacity]()),
+      capacity_(capacity),
+      written_(0),
+      retired_(false),
+      thread_id_(0) {}
+
+ThreadTraceBuffer::~ThreadTraceBuffer() = default;
+
+void ThreadTraceBuffer::CopyTo(std::vector<TraceEvent> *events) const {
+  uint64_t end = written_.load(std::memory_order_acquire);
+  uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+  for (uint64_t i = begin; i < end; ++i) {
+    const Slot &slot = slots_[i % capacity_];
+    uint32_t sequence = SequenceFor(i);
+    // Already overwritten (or being overwritten) by a newer event.
+    if (slot.sequence.load(std::memory_order_acquire) != sequence)
+      continue;
+    uint32_t words[kWordsPerEvent];
+    for (size_t j = 0; j < kWordsPerEvent; ++j)
+      words[j] = slot.words[j].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+      continue;
+    TraceEvent event;
+    memcpy(&event, words, sizeof(event));
+    events->push_back(event);
+  }
+}
+
+void ThreadTraceBuffer::Attach(PlatformThreadId thread_id, const std::string &thread_name) {
+  thread_id_ = thread_id;
+  thread_name_ = thread_name;
+  written_.store(0, std::memory_order_relaxed);
+  retired_.store(false, std::memory_order_relaxed);
+}
+
+std::atomic<bool> TraceLog::enabled_(false);
+
+// static
+TraceLog *TraceLog::GetInstance() {
+  // Leaked on purpose: threads may still record while static objects are
+  // being destroyed.
+  static TraceLog *instance = new TraceLog();
+  return instance;
+}
+
+// static
+void TraceLog::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+// static
+int64_t TraceLog::NowMicros() {
+  return (TimeTicks::Now() - TimeTicks()).InMicroseconds();
+}
+
+TraceLog::TraceLog() = default;
+
+TraceLog::~TraceLog() = default;
+
+void TraceLog::AddEvent(char phase,
+                        const char *category,
+                        const char *name,
+                        uint64_t id,
+                        const char *arg_name,
+                        int64_t arg_value) {
+  TraceEvent event;
+  event.timestamp_us = NowMicros();
+  event.duration_us = 0;
+  event.category = category;
+  event.name = name;
+  event.arg_name = arg_name;
+  event.arg_value = arg_value;
+  event.id = id;
+  event.phase = phase;
+  GetThreadBuffer()->Add(event);
+}
+
+void TraceLog::AddCompleteEvent(const char *category,
+                                const char *name,
+                                int64_t begin_us,
+                                const char *arg_name,
+                                int64_t arg_value) {
+  TraceEvent event;
+  event.timestamp_us = begin_us;
+  event.duration_us = NowMicros() - begin_us;
+  event.category = category;
+  event.name = name;
+  event.arg_name = arg_name;
+  event.arg_value = arg_value;
+  event.id = 0;
+  event.phase = kPhaseComplete;
+  GetThreadBuffer()->Add(event);
+}
+
+ThreadTraceBuffer *TraceLog::GetThreadBuffer() {
+  ThreadTraceBuffer *buffer = t_buffer.buffer;
+  if (!buffer) {
+    buffer = CreateThreadBuffer();
+    t_buffer.buffer = buffer;
+  }
+  return buffer;
+}
+
+ThreadTraceBuffer *TraceLog::CreateThreadBuffer() {
+  base::AutoLock l(lock_);
+  ThreadTraceBuffer *buffer = nullptr;
+  if (buffers_.size() >= kMaxThreadBuffers) {
+    for (auto &b : buffers_) {
+      if (b->retired()) {
+        buffer = b.get();
+        break;
+      }
+    }
+  }
+  if (!buffer) {
+    buffers_.emplace_back(new ThreadTraceBuffer(kEventsPerThread));
+    buffer = buffers_.back().get();
+  }
+  buffer->Attach(PlatformThread::CurrentId(), CurrentThreadName());
+  return buffer;
+}
+
+std::string TraceLog::ToJson() {
+  int pid = static_cast<int>(getpid());
+  std::string out("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first = true;
+  std::vector<TraceEvent> events;
+  base::AutoLock l(lock_);
+  for (auto &buffer : buffers_) {
+    if (!first)
+      out.push_back(',');
+    first = false;
+    char buf[96];
+    snprintf(buf, sizeof(buf), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+             pid, static_cast<int>(buffer->thread_id()));
+    out.append(buf);
+    AppendEscaped(&out, buffer->thread_name().c_str());
+    out.append("}}");
+
+    events.clear();
+    buffer->CopyTo(&events);
+    for (const TraceEvent &event : events) {
+      out.push_back(',');
+      AppendEvent(&out, pid, buffer->thread_id(), event);
+    }
+  }
+  out.append("]}\n");
+  return out;
+}
+
+bool TraceLog::WriteJsonFile(const std::string &path) {
+  std::string json = ToJson();
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file) {
+    PLOG(ERROR) << "Can not open trace file " << path;
+    return false;
+  }
+  bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+  ok = fclose(file) == 0 && ok;
+  LOG(INFO) << "Trace written to " << path << ", " << json.size() << " bytes";
+  return ok;
+}
+
+}  // namespace trace_event
+}  // namespace base
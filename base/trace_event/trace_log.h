@@ -0,0 +1,206 @@
+#ifndef BASE_TRACE_EVENT_TRACE_LOG_H_
+#define BASE_TRACE_EVENT_TRACE_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+
+namespace base {
+namespace trace_event {
+
+// Phases, as used by the Chrome trace-event JSON format.
+const char kPhaseComplete = 'X';
+const char kPhaseInstant = 'i';
+const char kPhaseFlowBegin = 's';
+const char kPhaseFlowStep = 't';
+const char kPhaseFlowEnd = 'f';
+const char kPhaseAsyncBegin = 'b';
+const char kPhaseAsyncEnd = 'e';
+
+// One recorded event. |category|, |name| and |arg_name| must be string
+// literals (or otherwise outlive the TraceLog); only the pointers are kept.
+struct TraceEvent {
+  int64_t timestamp_us;
+  int64_t duration_us;
+  const char *category;
+  const char *name;
+  const char *arg_name;
+  int64_t arg_value;
+  uint64_t id;
+  char phase;
+};
+
+// Fixed-size ring of the most recent events of one thread. Only the owning
+// thread writes, without locks; the oldest events are overwritten.
+//
+// Readers may copy the ring while the owner keeps writing, so each slot is a
+// seqlock: the event is stored as relaxed 32-bit atomic words between an odd
+// and an even sequence number, and a reader keeps its copy only if the
+// sequence was the same even value before and after.
+class ThreadTraceBuffer {
+public:
+ explicit ThreadTraceBuffer(size_t capacity);
+
+ ~ThreadTraceBuffer();
+
+ // Owning thread only.
+ void Add(const TraceEvent &event) {
+   uint64_t written = written_.load(std::memory_order_relaxed);
+   Slot &slot = slots_[written % capacity_];
+   uint32_t sequence = SequenceFor(written);
+   slot.sequence.store(sequence - 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   uint32_t words[kWordsPerEvent];
+   memcpy(words, &event, sizeof(event));
+   for (size_t i = 0; i < kWordsPerEvent; ++i)
+     slot.words[i].store(words[i], std::memory_order_relaxed);
+   slot.sequence.store(sequence, std::memory_order_release);
+   written_.store(written + 1, std::memory_order_release);
+ }
+
+ // Any thread. Appends the events currently in the ring, oldest first.
+ // Events overwritten while copying are dropped.
+ void CopyTo(std::vector<TraceEvent> *events) const;
+
+ // Called by TraceLog when the buffer is (re)assigned to a thread.
+ void Attach(PlatformThreadId thread_id, const std::string &thread_name);
+
+ PlatformThreadId thread_id() const { return thread_id_; }
+
+ const std::string &thread_name() const { return thread_name_; }
+
+ // Set when the owning thread exits; the events stay until the buffer is
+ // handed to a new thread.
+ bool retired() const { return retired_.load(std::memory_order_acquire); }
+
+ void Retire() { retired_.store(true, std::memory_order_release); }
+
+private:
+ static_assert(sizeof(TraceEvent) % sizeof(uint32_t) == 0, "TraceEvent is copied as 32-bit words");
+ static const size_t kWordsPerEvent = sizeof(TraceEvent) / sizeof(uint32_t);
+
+ struct Slot {
+   std::atomic<uint32_t> sequence;
+   std::atomic<uint32_t> words[kWordsPerEvent];
+ };
+
+ // Even value a slot holds once event |index| is completely written; the odd
+ // value just below it marks the write in progress.
+ static uint32_t SequenceFor(uint64_t index) {
+   return static_cast<uint32_t>(2 * index + 2);
+ }
+
+ std::unique_ptr<Slot[]> slots_;
+ size_t capacity_;
+ std::atomic<uint64_t> written_;
+ std::atomic<bool> retired_;
+ PlatformThreadId thread_id_;
+ std::string thread_name_;
+ DISALLOW_COPY_AND_ASSIGN(ThreadTraceBuffer);
+};
+
+// Process-wide trace recorder. Events go to per-thread rings, so recording
+// takes no lock; a lock is only taken the first time a thread records and
+// when writing the trace out. Use the TRACE_EVENT* macros in
+// base/trace_event/trace_event.h rather than calling this directly.
+class TraceLog {
+public:
+ // Events kept per thread.
+ static const size_t kEventsPerThread = 16384;
+
+ // Rings of exited threads are reused once this many exist, so a player that
+ // is recreated for every clip does not grow memory without bound.
+ static const size_t kMaxThreadBuffers = 64;
+
+ static TraceLog *GetInstance();
+
+ // The single check done by every macro while tracing is off.
+ static bool IsEnabled() {
+   return enabled_.load(std::memory_order_relaxed);
+ }
+
+ static void SetEnabled(bool enabled);
+
+ static int64_t NowMicros();
+
+ void AddEvent(char phase,
+               const char *category,
+               const char *name,
+               uint64_t id,
+               const char *arg_name,
+               int64_t arg_value);
+
+ void AddCompleteEvent(const char *category,
+                       const char *name,
+                       int64_t begin_us,
+                       const char *arg_name,
+                       int64_t arg_value);
+
+ // Writes everything still in the rings as Chrome trace-event JSON, which
+ // chrome://tracing and ui.perfetto.dev open directly. Can be called from any
+ // thread while tracing is running. Returns false if the file can not be
+ // written.
+ bool WriteJsonFile(const std::string &path);
+
+ std::string ToJson();
+
+private:
+ TraceLog();
+
+ ~TraceLog();
+
+ ThreadTraceBuffer *GetThreadBuffer();
+
+ ThreadTraceBuffer *CreateThreadBuffer();
+
+ static std::atomic<bool> enabled_;
+
+ base::Lock lock_;
+ std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers_;
+ DISALLOW_COPY_AND_ASSIGN(TraceLog);
+};
+
+// Records a complete ('X') event covering its lifetime. Started only by
+// TRACE_EVENT0/1 when tracing is on; otherwise the destructor does nothing.
+class ScopedTraceEvent {
+public:
+ ScopedTraceEvent()
+     : category_(nullptr),
+       name_(nullptr),
+       arg_name_(nullptr),
+       arg_value_(0),
+       begin_us_(0) {}
+
+ ~ScopedTraceEvent() {
+   if (name_)
+     TraceLog::GetInstance()->AddCompleteEvent(category_, name_, begin_us_, arg_name_, arg_value_);
+ }
+
+ void Begin(const char *category, const char *name, const char *arg_name, int64_t arg_value) {
+   category_ = category;
+   name_ = name;
+   arg_name_ = arg_name;
+   arg_value_ = arg_value;
+   begin_us_ = TraceLog::NowMicros();
+ }
+
+private:
+ const char *category_;
+ const char *name_;
+ const char *arg_name_;
+ int64_t arg_value_;
+ int64_t begin_us_;
+ DISALLOW_COPY_AND_ASSIGN(ScopedTraceEvent);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_LOG_H_
@@ -0,0 +1,134 @@
+// 解封装吞吐量,对比默认的文件读取,mmap AVIOContext 以及 mmap + 索引零拷贝三种方式
+// 同一个文件循环读多遍(和循环播放广告片一样, page cache 是热的),
+// 统计每秒包数,read 系统调用次数(/proc/self/io 的 syscr)和缺页次数
+//
+// 用法: demux_bench [目录] [循环次数]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <string>
+#include "base/time/time.h"
+#include "bench/synthetic_mp4.h"
+#include "media/mp4_dataset.h"
+#include "media/packet_queue.h"
+
+namespace {
+struct Mode {
+  const char *name;
+  bool use_index;
+  bool use_mmap;
+};
+
+const Mode kModes[] = {
+    {"file", true, false},
+    {"mmap", false, true},
+    {"mmap+index", true, true},
+};
+
+uint64_t ReadSyscalls() {
+  FILE *fp = fopen("/proc/self/io", "r");
+  if (!fp)
+    return 0;
+  char line[128];
+  unsigned long long value = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "syscr: %llu", &value) == 1)
+      break;
+  }
+  fclose(fp);
+  return value;
+}
+
+long MinorFaults() {
+  struct rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+// 取出并释放队列中的包,返回包数
+uint64_t Drain(media::PacketQueue *queue, uint64_t *bytes) {
+  uint64_t count = 0;
+  while (AVPacket *pkt = queue->get()) {
+    if (pkt->data == media::PacketQueue::kFlushPkt.data)
+      continue;
+    if (pkt->size > 0) {
+      ++count;
+      *bytes += pkt->size;
+    }
+    av_packet_free(&pkt);
+  }
+  return count;
+}
+
+bool Run(const std::string &file, const Mode &mode, int loops) {
+  media::Mp4Dataset::Options options;
+  options.use_index = mode.use_index;
+  options.use_mmap = mode.use_mmap;
+  std::unique_ptr<media::Mp4Dataset> dataset = media::Mp4Dataset::create(file, options);
+  if (!dataset)
+    return false;
+  std::unique_ptr<media::PacketQueue> audio_queue;
+  if (dataset->getAudioStream()) {
+    audio_queue.reset(new media::PacketQueue(dataset->getAudioStream(), base::TimeDelta::Max(), SIZE_MAX));
+    dataset->setAudioPacketQueue(audio_queue.get());
+  }
+  media::PacketQueue video_queue(dataset->getVideoStream(), base::TimeDelta::Max(), SIZE_MAX);
+  dataset->setVideoPacketQueue(&video_queue);
+
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  uint64_t syscalls = ReadSyscalls();
+  long faults = MinorFaults();
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < loops; ++i) {
+    dataset->rewind();
+    while (dataset->demuxNextPacket() == media::DemuxResult::OK) {
+      packets += Drain(&video_queue, &bytes);
+      if (audio_queue)
+        packets += Drain(audio_queue.get(), &bytes);
+    }
+    packets += Drain(&video_queue, &bytes);
+    if (audio_queue)
+      packets += Drain(audio_queue.get(), &bytes);
+  }
+  double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+  printf("%12s %10llu %12.0f %10.1f %10llu %10ld\n",
+         mode.name,
+         static_cast<unsigned long long>(packets),
+         packets / seconds,
+         bytes / seconds / (1024 * 1024),
+         static_cast<unsigned long long>(ReadSyscalls() - syscalls),
+         MinorFaults() - faults);
+  return true;
+}
+}
+
+int main(int argc, char **argv) {
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  int loops = argc > 2 ? atoi(argv[2]) : 5;
+  if (loops < 1) loops = 1;
+  av_log_set_level(AV_LOG_QUIET);
+  media::PacketQueue::Init();
+
+  //5 分钟 30fps,码率约 2Mbps
+  bench::SyntheticMp4Options options;
+  options.video_samples = 9000;
+  options.keyframe_size = 48 * 1024;
+  options.frame_size = 6 * 1024;
+  std::string file = dir + "/demux_bench.mp4";
+  if (!bench::WriteSyntheticMp4(file, options)) {
+    fprintf(stderr, "failed to write %s\n", file.c_str());
+    return 1;
+  }
+
+  printf("%12s %10s %12s %10s %10s %10s\n", "mode", "packets", "packets/s", "MB/s", "read()", "minflt");
+  for (const Mode &mode : kModes) {
+    if (!Run(file, mode, loops)) {
+      fprintf(stderr, "failed to open %s in %s mode\n", file.c_str(), mode.name);
+    }
+  }
+  remove(file.c_str());
+  return 0;
+}
@@ -0,0 +1,245 @@
+// 解码帧队列的开销: 原来的 加锁 + std::map 排序 的队列,和现在的 重排窗口 + 无锁 FrameRing
+// 一个线程按解码顺序(IBBP,B 帧的 PTS 比前面的 P 帧小)写入,另一个线程按显示顺序读出,
+// 和解码线程/render 线程一样,写满时等待可写,读空时等待可读
+// 输出每秒通过的帧数,以及从写入到读出的延迟分位数
+// 两个线程的结果受调度影响很大(单核上主要是线程切换的开销),所以另外在一个线程中交替读写,
+// 队列不会满也不会空,只测 put/get 本身的开销
+// locked 和 ring 缓冲的总帧数相同,都是 队列容量: ring 中只有 容量 - 重排深度 帧,其余在写的一侧的窗口中,
+// 读的一方看不到。ring+d 的 ring 和 locked 一样大(总共多缓冲 重排深度 帧),用来区分两种开销
+//
+// 用法: frame_queue_bench [帧数] [队列容量] [重排深度]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <vector>
+#include "base/synchronization/lock.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/time/time.h"
+#include "media/frame_ring.h"
+
+namespace {
+const int64_t kFrameBytes = 1920 * 1088 * 3 / 2;
+
+void ReleaseNothing(int64_t) {}
+
+size_t FrameBytes(int64_t) {
+  return kFrameBytes;
+}
+
+// 解码顺序: 每 4 帧一组 P B B B,P 的 PTS 是组内最大的
+int64_t DecodeOrderPts(int64_t i) {
+  int64_t group = i / 4;
+  int64_t k = i % 4;
+  return k == 0 ? group * 4 + 3 : group * 4 + k - 1;
+}
+
+// 原来的 VideoFrameQueue
+class LockedQueue {
+public:
+ explicit LockedQueue(size_t max_size)
+     : max_size_(max_size), not_full_cond_(&lock_), not_empty_cond_(&lock_) {}
+
+ void wait_for_writable() {
+   base::AutoLock l(lock_);
+   while (frames_.size() >= max_size_)
+     not_full_cond_.Wait();
+ }
+
+ void wait_for_readable() {
+   base::AutoLock l(lock_);
+   while (frames_.empty())
+     not_empty_cond_.Wait();
+ }
+
+ void put(int64_t pts) {
+   base::AutoLock l(lock_);
+   frames_.insert(std::make_pair(pts, pts));
+   not_empty_cond_.Signal();
+ }
+
+ bool get(int64_t render_time, int64_t *pts) {
+   base::AutoLock l(lock_);
+   if (frames_.empty() || frames_.begin()->first > render_time)
+     return false;
+   *pts = frames_.begin()->second;
+   frames_.erase(frames_.begin());
+   not_full_cond_.Signal();
+   return true;
+ }
+
+private:
+ size_t max_size_;
+ std::map<int64_t, int64_t> frames_;
+ base::Lock lock_;
+ base::ConditionVariable not_full_cond_;
+ base::ConditionVariable not_empty_cond_;
+};
+
+// 现在的 VideoFrameQueue: 写的一侧排序,ring 中已经是显示顺序
+class RingQueue {
+public:
+ RingQueue(size_t max_size, size_t depth)
+     : depth_(depth), ring_(max_size > depth ? max_size - depth : 1, ReleaseNothing, FrameBytes) {
+   window_.reserve(depth + 1);
+ }
+
+ void wait_for_writable() {
+   ring_.wait_for_writable(base::TimeDelta::Max());
+ }
+
+ void wait_for_readable() {
+   ring_.wait_for_readable(base::TimeDelta::Max());
+ }
+
+ void put(int64_t pts) {
+   auto iter = window_.end();
+   while (iter != window_.begin() && *(iter - 1) > pts)
+     --iter;
+   window_.insert(iter, pts);
+   if (window_.size() > depth_) {
+     if (ring_.full())
+       ring_.wait_for_writable(base::TimeDelta::Max());
+     ring_.Push(window_.front(), false);
+     window_.erase(window_.begin());
+   }
+ }
+
+ // 最后几帧留在窗口中,实际是由 EOS 带出来的
+ void finish() {
+   for (int64_t pts : window_) {
+     if (ring_.full())
+       ring_.wait_for_writable(base::TimeDelta::Max());
+     ring_.Push(pts, false);
+   }
+   window_.clear();
+ }
+
+ bool get(int64_t render_time, int64_t *pts) {
+   int64_t *front = ring_.Front(nullptr);
+   if (!front || *front > render_time)
+     return false;
+   *pts = ring_.Pop();
+   return true;
+ }
+
+private:
+ size_t depth_;
+ media::FrameRing<int64_t> ring_;
+ std::vector<int64_t> window_;
+};
+
+void Finish(LockedQueue *) {}
+
+void Finish(RingQueue *queue) {
+  queue->finish();
+}
+
+template <typename Queue>
+void RunSingleThread(const char *name, Queue *queue, int64_t frames) {
+  int64_t expected = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int64_t i = 0; i < frames; ++i) {
+    queue->put(DecodeOrderPts(i));
+    int64_t pts;
+    while (queue->get(expected, &pts))
+      ++expected;
+  }
+  Finish(queue);
+  int64_t pts;
+  while (queue->get(expected, &pts))
+    ++expected;
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  printf("%-8s %12.1f %8s\n", name, elapsed.InMicroseconds() * 1000.0 / frames, expected == frames ? "yes" : "NO");
+}
+
+template <typename Queue>
+void Run(const char *name, Queue *queue, int64_t frames) {
+  //写入时间按 PTS 记录,读出时计算延迟
+  std::vector<int64_t> put_time(frames);
+  std::vector<int64_t> latency;
+  latency.reserve(frames);
+  bool ordered = true;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  std::thread producer([&]() {
+    for (int64_t i = 0; i < frames; ++i) {
+      int64_t pts = DecodeOrderPts(i);
+      queue->wait_for_writable();
+      put_time[pts] = (base::TimeTicks::Now() - base::TimeTicks()).InMicroseconds();
+      queue->put(pts);
+    }
+    Finish(queue);
+  });
+
+  int64_t expected = 0;
+  while (expected < frames) {
+    //render 时间正好是下一帧的 PTS,B 帧之前的 P 帧不能先被取走
+    int64_t pts;
+    if (!queue->get(expected, &pts)) {
+      queue->wait_for_readable();
+      std::this_thread::yield();
+      continue;
+    }
+    latency.push_back((base::TimeTicks::Now() - base::TimeTicks()).InMicroseconds() - put_time[pts]);
+    if (pts != expected)
+      ordered = false;
+    ++expected;
+  }
+  producer.join();
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  std::sort(latency.begin(), latency.end());
+  printf("%-8s %12.0f %10lld %10lld %10lld %8s\n",
+         name,
+         frames / elapsed.InSecondsF(),
+         static_cast<long long>(latency[latency.size() / 2]),
+         static_cast<long long>(latency[latency.size() * 99 / 100]),
+         static_cast<long long>(latency.back()),
+         ordered ? "yes" : "NO");
+}
+}
+
+int main(int argc, char **argv) {
+  int64_t frames = argc > 1 ? atoll(argv[1]) : 2000000;
+  int capacity = argc > 2 ? atoi(argv[2]) : 6;
+  int depth = argc > 3 ? atoi(argv[3]) : 3;
+  frames = std::max<int64_t>(frames / 4 * 4, 4);
+  if (depth < 3) depth = 3;
+  if (capacity <= depth) capacity = depth + 1;
+
+  printf("frames:%lld capacity:%d reorder depth:%d\n", static_cast<long long>(frames), capacity, depth);
+  printf("locked: %d in map, ring: %d in window + %d in ring, ring+d: %d in window + %d in ring\n",
+         capacity, depth, capacity - depth, depth, capacity);
+  printf("%-8s %12s %8s\n", "queue", "ns/frame", "ordered");
+  {
+    LockedQueue queue(capacity);
+    RunSingleThread("locked", &queue, frames);
+  }
+  {
+    RingQueue queue(capacity, depth);
+    RunSingleThread("ring", &queue, frames);
+  }
+  {
+    RingQueue queue(capacity + depth, depth);
+    RunSingleThread("ring+d", &queue, frames);
+  }
+
+  printf("%-8s %12s %10s %10s %10s %8s\n", "queue", "frames/s", "p50(us)", "p99(us)", "max(us)", "ordered");
+  {
+    LockedQueue queue(capacity);
+    Run("locked", &queue, frames);
+  }
+  {
+    RingQueue queue(capacity, depth);
+    Run("ring", &queue, frames);
+  }
+  {
+    RingQueue queue(capacity + depth, depth);
+    Run("ring+d", &queue, frames);
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+// 多个线程同时投递任务时的开销(1~8 个生产者,一个消费者)
+// 1. queue: 只比较队列本身,原来的 加锁 + std::queue 和现在的 base::IntrusiveMpscQueue,
+//    消费者一次取出所有任务,和 MessageLoop 一样
+// 2. loop: 通过 base::Thread::PostTask 投递到真正的 MessageLoop
+// 输出每秒通过的任务数,以及单次投递耗时的分位数(生产者被阻塞的时间会体现在 p99/max 中)
+//
+// 用法: incoming_queue_bench [每个生产者投递的任务数]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "base/containers/intrusive_mpsc_queue.h"
+#include "base/pending_task.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+
+namespace {
+const int kProducerCounts[] = {1, 2, 4, 8};
+
+// 原来的 IncomingTaskQueue
+class LockedQueue {
+public:
+ void Push(std::unique_ptr<base::PendingTask> task) {
+   base::AutoLock l(lock_);
+   queue_.push(std::move(task));
+ }
+
+ // 返回取出的任务数
+ int TakeAll() {
+   std::queue<std::unique_ptr<base::PendingTask>> work_queue;
+   {
+     base::AutoLock l(lock_);
+     work_queue.swap(queue_);
+   }
+   int count = static_cast<int>(work_queue.size());
+   while (!work_queue.empty()) {
+     work_queue.front()->Run();
+     work_queue.pop();
+   }
+   return count;
+ }
+
+private:
+ base::Lock lock_;
+ std::queue<std::unique_ptr<base::PendingTask>> queue_;
+};
+
+class LockFreeQueue {
+public:
+ void Push(std::unique_ptr<base::PendingTask> task) {
+   queue_.Push(task.release());
+ }
+
+ int TakeAll() {
+   base::TaskQueue work_queue;
+   work_queue.Append(queue_.TakeAll());
+   int count = 0;
+   while (!work_queue.empty()) {
+     work_queue.pop()->Run();
+     ++count;
+   }
+   return count;
+ }
+
+private:
+ base::IntrusiveMpscQueue<base::PendingTask> queue_;
+};
+
+std::unique_ptr<base::PendingTask> MakeTask() {
+  return std::unique_ptr<base::PendingTask>(
+      new base::PendingTask(base::NewClosure([]() {}), base::TimeTicks()));
+}
+
+void PrintResult(const char *name, int producers, int64_t tasks, base::TimeDelta elapsed,
+                 std::vector<int64_t> *post_ns) {
+  std::sort(post_ns->begin(), post_ns->end());
+  printf("%-8s %9d %12.0f %10lld %10lld %12lld\n",
+         name,
+         producers,
+         tasks / elapsed.InSecondsF(),
+         static_cast<long long>((*post_ns)[post_ns->size() / 2]),
+         static_cast<long long>((*post_ns)[post_ns->size() * 99 / 100]),
+         static_cast<long long>(post_ns->back()));
+}
+
+// 每个生产者记录每次投递的耗时(纳秒)
+template <typename PostFunc>
+base::TimeDelta RunProducers(int producers, int tasks, PostFunc post, std::vector<int64_t> *post_ns) {
+  std::vector<std::vector<int64_t>> samples(producers);
+  std::vector<std::thread> threads;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p]() {
+      samples[p].reserve(tasks);
+      for (int i = 0; i < tasks; ++i) {
+        timespec begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        post();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        samples[p].push_back((end.tv_sec - begin.tv_sec) * 1000000000LL + end.tv_nsec - begin.tv_nsec);
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  for (auto &s : samples)
+    post_ns->insert(post_ns->end(), s.begin(), s.end());
+  return base::TimeTicks::Now() - start;
+}
+
+template <typename Queue>
+void BenchQueue(const char *name, int producers, int tasks) {
+  Queue queue;
+  int64_t total = static_cast<int64_t>(producers) * tasks;
+  std::thread consumer([&]() {
+    int64_t consumed = 0;
+    while (consumed < total) {
+      int n = queue.TakeAll();
+      consumed += n;
+      if (n == 0)
+        std::this_thread::yield();
+    }
+  });
+  std::vector<int64_t> post_ns;
+  base::TimeTicks start = base::TimeTicks::Now();
+  RunProducers(producers, tasks, [&queue]() { queue.Push(MakeTask()); }, &post_ns);
+  consumer.join();
+  PrintResult(name, producers, total, base::TimeTicks::Now() - start, &post_ns);
+}
+
+void BenchLoop(int producers, int tasks) {
+  base::Thread thread("BenchLoop");
+  thread.Start();
+  int64_t total = static_cast<int64_t>(producers) * tasks;
+  int64_t count = 0;
+  base::WaitableEvent done(true, false);
+  std::vector<int64_t> post_ns;
+  base::TimeTicks start = base::TimeTicks::Now();
+  RunProducers(producers, tasks, [&]() {
+    thread.PostTask([&count, &done, total]() {
+      if (++count == total)
+        done.Signal();
+    });
+  }, &post_ns);
+  done.Wait();
+  PrintResult("loop", producers, total, base::TimeTicks::Now() - start, &post_ns);
+  thread.Stop();
+}
+}
+
+int main(int argc, char **argv) {
+  int tasks = argc > 1 ? atoi(argv[1]) : 200000;
+  if (tasks < 1) tasks = 1;
+  printf("tasks per producer:%d\n", tasks);
+  printf("%-8s %9s %12s %10s %10s %12s\n", "queue", "producers", "tasks/s", "p50(ns)", "p99(ns)", "max(ns)");
+  for (int producers : kProducerCounts) {
+    BenchQueue<LockedQueue>("locked", producers, tasks);
+    BenchQueue<LockFreeQueue>("mpsc", producers, tasks);
+  }
+  for (int producers : kProducerCounts) {
+    BenchLoop(producers, tasks);
+  }
+  return 0;
+}
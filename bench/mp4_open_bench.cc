@@ -0,0 +1,66 @@
+// 打开 mp4 到读出第一个包的耗时(time-to-first-packet),对比 avformat 探测和 moov 索引两种方式
+//
+// 用法: mp4_open_bench [目录] [重复次数]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/time/time.h"
+#include "bench/synthetic_mp4.h"
+#include "media/mp4_dataset.h"
+#include "media/mp4_index.h"
+
+namespace {
+const uint32_t kSampleCounts[] = {900, 9000, 54000, 216000};
+
+double OpenToFirstPacket(const std::string &file, bool use_index) {
+  bench::DropFileCache(file);
+  base::TimeTicks start = base::TimeTicks::Now();
+  media::Mp4Dataset::Options options;
+  options.use_index = use_index;
+  std::unique_ptr<media::Mp4Dataset> dataset = media::Mp4Dataset::create(file, options);
+  if (!dataset)
+    return -1;
+  std::unique_ptr<AVPacket, media::ScopedPtrAVFreePacket> packet(av_packet_alloc());
+  if (av_read_frame(dataset->getFormatContext(), packet.get()) < 0)
+    return -1;
+  return (base::TimeTicks::Now() - start).InMillisecondsF();
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+}
+
+int main(int argc, char **argv) {
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  int repeat = argc > 2 ? atoi(argv[2]) : 5;
+  if (repeat < 1) repeat = 1;
+  av_log_set_level(AV_LOG_QUIET);
+
+  printf("%10s %12s %12s %12s\n", "samples", "duration(s)", "probe(ms)", "index(ms)");
+  for (uint32_t count : kSampleCounts) {
+    bench::SyntheticMp4Options options;
+    options.video_samples = count;
+    std::string file = dir + "/mp4_open_bench_" + std::to_string(count) + ".mp4";
+    if (!bench::WriteSyntheticMp4(file, options)) {
+      fprintf(stderr, "failed to write %s\n", file.c_str());
+      return 1;
+    }
+    std::vector<double> probe, index;
+    for (int i = 0; i < repeat; ++i) {
+      probe.push_back(OpenToFirstPacket(file, false));
+      index.push_back(OpenToFirstPacket(file, true));
+    }
+    printf("%10u %12.1f %12.2f %12.2f\n",
+           count,
+           static_cast<double>(count) / options.fps,
+           Median(probe),
+           Median(index));
+    remove(file.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,431 @@
+// 不带 Qt 的播放器性能测试,用 Mp4Dataset + 解码线程 + VideoPlayer 跑完整的播放流程,
+// 视频帧送到空的 Delegate 直接释放。结果以 JSON 输出到 stdout,方便不同固件版本之间对比
+//
+// 用法: player_bench <mp4 文件> [选项]
+//   --mode=decode     不按时间戳等待,解码出来就送出,测解码吞吐量(默认)
+//   --mode=realtime   按时间戳正常播放
+//   --mode=seek       正常播放的同时每隔一段时间随机 seek
+//   --duration=秒     realtime/seek 模式的运行时长,默认 30
+//   --seek-interval=毫秒  seek 模式下两次 seek 的间隔,默认 500
+//   --seek-burst=N    seek 模式下每次连续发起 N 个 seek(间隔 kSeekBurstSpacingMs),模拟拖动进度条,默认 1
+//   --seek-mode=keyframe|accurate  seek 到关键帧,或者精确 seek 到目标时间,默认 keyframe
+//   --decoder=auto|mpp|ffmpeg
+//   --audio           realtime/seek 模式下同时播放音频
+//   --clock=system|audio  音视频同步的基准时钟,默认 system
+//   --clip-cache-mb=N realtime/seek 模式下缓存整段解码结果的内存预算,默认 0(不缓存)
+//   --fast-start      第一帧解码出来就显示,只缓冲重排深度就开始播放
+//   --rate=X          realtime/seek 模式下的播放速度(0.5~2.0),音频变速不变调
+//   --trick=N         realtime 模式下以 N 倍速快进(负数为快退,从文件末尾开始),只解码关键帧
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/logging.h"
+#include "base/metrics/sample_stats.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "media/mp4_dataset.h"
+#include "media/packet_queue.h"
+#include "media/video_player.h"
+#include <rkmedia/rkmedia_api.h>
+
+namespace {
+//--seek-burst 时同一组 seek 之间的间隔,大约是拖动进度条时 UI 的刷新间隔
+const int kSeekBurstSpacingMs = 16;
+
+enum class Mode {
+  kDecode,
+  kRealtime,
+  kSeek,
+};
+
+struct BenchOptions {
+  std::string file;
+  Mode mode = Mode::kDecode;
+  double duration = 30;
+  int seek_interval_ms = 500;
+  int seek_burst = 1;
+  media::VideoPlayer::SeekMode seek_mode = media::VideoPlayer::SeekMode::kKeyFrame;
+  media::VideoDecoderType decoder = media::VideoDecoderType::kAuto;
+  bool audio = false;
+  media::VideoPlayer::ClockMode clock = media::VideoPlayer::ClockMode::kSystemClock;
+  size_t clip_cache_mb = 0;
+  bool fast_start = false;
+  int trick = 0;
+  double rate = 1.0;
+};
+
+const char *ModeName(Mode mode) {
+  switch (mode) {
+    case Mode::kDecode:
+      return "decode";
+    case Mode::kRealtime:
+      return "realtime";
+    case Mode::kSeek:
+      return "seek";
+  }
+  return "";
+}
+
+struct ThreadCpu {
+  std::string name;
+  double cpu_ms;
+};
+
+// 从 /proc/self/task/<tid>/stat 读取每个线程的 utime + stime
+std::vector<ThreadCpu> ReadThreadCpu() {
+  std::vector<ThreadCpu> threads;
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir)
+    return threads;
+  long ticks = sysconf(_SC_CLK_TCK);
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] == '.')
+      continue;
+    std::string path = std::string("/proc/self/task/") + entry->d_name + "/stat";
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp)
+      continue;
+    char buf[512];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+    //线程名在括号里,可能包含空格,从最后一个 ')' 之后开始解析
+    char *name_begin = strchr(buf, '(');
+    char *name_end = strrchr(buf, ')');
+    if (!name_begin || !name_end)
+      continue;
+    unsigned long utime = 0, stime = 0;
+    //跳过 state 到 cutime 之前的 11 个字段
+    if (sscanf(name_end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+      continue;
+    ThreadCpu cpu;
+    cpu.name.assign(name_begin + 1, name_end);
+    cpu.cpu_ms = (utime + stime) * 1000.0 / ticks;
+    threads.push_back(cpu);
+  }
+  closedir(dir);
+  return threads;
+}
+
+// 文件名中可能有引号、反斜杠或者控制字符
+std::string JsonEscape(const std::string &str) {
+  std::string out;
+  for (unsigned char c : str) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out.append(escaped);
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+long PeakRssKb() {
+  struct rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// 收到的帧直接释放,只记录时间
+class NullSink : public media::VideoPlayer::Delegate {
+public:
+ NullSink()
+     : stopped_cond_(&lock_),
+       player_(nullptr),
+       frames_(0),
+       stopped_(false),
+       errors_(0),
+       seeks_(0) {}
+
+ void set_player(media::VideoPlayer *player) {
+   base::AutoLock l(lock_);
+   player_ = player;
+ }
+
+ void OnMediaError(int err) override {
+   base::AutoLock l(lock_);
+   ++errors_;
+   LOG(ERROR) << "media error: " << err;
+ }
+
+ void OnMediaStop() override {
+   base::AutoLock l(lock_);
+   //解码线程销毁之前 player 会更新一次统计
+   if (player_)
+     final_stats_ = player_->GetStats();
+   stopped_ = true;
+   stopped_cond_.Broadcast();
+ }
+
+ void OnMediaFrameArrival(MppFrame frame) override {
+   base::TimeTicks now = base::TimeTicks::Now();
+   if (!frame)
+     return;
+   mpp_frame_deinit(&frame);
+   base::AutoLock l(lock_);
+   if (frames_ == 0)
+     first_frame_time_ = now;
+   latest_frame_time_ = now;
+   if (!last_frame_time_.is_null())
+     frame_intervals_.Add((now - last_frame_time_).InMicroseconds());
+   last_frame_time_ = now;
+   ++frames_;
+ }
+
+ void Seeking() {
+   base::AutoLock l(lock_);
+   //seek 延迟由 player 统计(PlaybackStats::seek_p50_us),这里只计数
+   ++seeks_;
+   //seek 前后两帧之间的间隔不计入帧间隔
+   last_frame_time_ = base::TimeTicks();
+ }
+
+ // 等待播放结束,超时返回 false
+ bool WaitForStop(const base::TimeDelta &timeout) {
+   base::AutoLock l(lock_);
+   base::TimeTicks deadline = base::TimeTicks::Now() + timeout;
+   while (!stopped_) {
+     if (timeout.is_max()) {
+       stopped_cond_.Wait();
+       continue;
+     }
+     base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+     if (remaining <= base::TimeDelta())
+       return false;
+     stopped_cond_.TimedWait(remaining);
+   }
+   return true;
+ }
+
+ base::Lock lock_;
+ base::ConditionVariable stopped_cond_;
+ media::VideoPlayer *player_;
+ uint64_t frames_;
+ bool stopped_;
+ int errors_;
+ base::TimeTicks first_frame_time_;
+ base::TimeTicks latest_frame_time_;
+ // seek 之后清空,用来计算帧间隔
+ base::TimeTicks last_frame_time_;
+ base::SampleStats frame_intervals_;
+ uint64_t seeks_;
+ media::PlaybackStats final_stats_;
+};
+
+bool ParseArgs(int argc, char **argv, BenchOptions *options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      options->file = arg;
+    } else if (arg == "--mode=decode") {
+      options->mode = Mode::kDecode;
+    } else if (arg == "--mode=realtime") {
+      options->mode = Mode::kRealtime;
+    } else if (arg == "--mode=seek") {
+      options->mode = Mode::kSeek;
+    } else if (arg.compare(0, 11, "--duration=") == 0) {
+      options->duration = atof(arg.c_str() + 11);
+    } else if (arg.compare(0, 16, "--seek-interval=") == 0) {
+      options->seek_interval_ms = atoi(arg.c_str() + 16);
+    } else if (arg.compare(0, 13, "--seek-burst=") == 0) {
+      options->seek_burst = atoi(arg.c_str() + 13);
+    } else if (arg == "--seek-mode=keyframe") {
+      options->seek_mode = media::VideoPlayer::SeekMode::kKeyFrame;
+    } else if (arg == "--seek-mode=accurate") {
+      options->seek_mode = media::VideoPlayer::SeekMode::kAccurate;
+    } else if (arg == "--decoder=auto") {
+      options->decoder = media::VideoDecoderType::kAuto;
+    } else if (arg == "--decoder=mpp") {
+      options->decoder = media::VideoDecoderType::kMpp;
+    } else if (arg == "--decoder=ffmpeg") {
+      options->decoder = media::VideoDecoderType::kFFmpeg;
+    } else if (arg == "--audio") {
+      options->audio = true;
+    } else if (arg == "--clock=system") {
+      options->clock = media::VideoPlayer::ClockMode::kSystemClock;
+    } else if (arg == "--clock=audio") {
+      options->clock = media::VideoPlayer::ClockMode::kAudioMaster;
+    } else if (arg == "--fast-start") {
+      options->fast_start = true;
+    } else if (arg.compare(0, 7, "--rate=") == 0) {
+      options->rate = atof(arg.c_str() + 7);
+    } else if (arg.compare(0, 8, "--trick=") == 0) {
+      options->trick = atoi(arg.c_str() + 8);
+    } else if (arg.compare(0, 16, "--clip-cache-mb=") == 0) {
+      options->clip_cache_mb = static_cast<size_t>(atoi(arg.c_str() + 16));
+    } else {
+      return false;
+    }
+  }
+  if (options->seek_interval_ms < 1) options->seek_interval_ms = 1;
+  if (options->seek_burst < 1) options->seek_burst = 1;
+  return !options->file.empty() && options->duration > 0;
+}
+
+void PrintJson(const BenchOptions &options, NullSink *sink, double seconds,
+               const std::vector<ThreadCpu> &threads) {
+  base::AutoLock l(sink->lock_);
+  const media::PlaybackStats &stats = sink->final_stats_;
+  double fps = 0;
+  if (sink->frames_ > 1) {
+    //从第一帧开始算,不包含打开文件和预缓冲的时间
+    double render_seconds = (sink->latest_frame_time_ - sink->first_frame_time_).InSecondsF();
+    if (render_seconds > 0)
+      fps = (sink->frames_ - 1) / render_seconds;
+  }
+  printf("{\n");
+  printf("  \"file\": \"%s\",\n", JsonEscape(options.file).c_str());
+  printf("  \"mode\": \"%s\",\n", ModeName(options.mode));
+  printf("  \"seconds\": %.3f,\n", seconds);
+  printf("  \"frames\": %llu,\n", static_cast<unsigned long long>(sink->frames_));
+  printf("  \"frames_dropped\": %llu,\n", static_cast<unsigned long long>(stats.frames_dropped));
+  printf("  \"frames_skipped\": %llu,\n", static_cast<unsigned long long>(stats.frames_skipped));
+  printf("  \"fps\": %.2f,\n", fps);
+  printf("  \"errors\": %d,\n", sink->errors_);
+  printf("  \"ttff_us\": %lld,\n", static_cast<long long>(stats.ttff_us));
+  printf("  \"trick\": %d,\n", options.trick);
+  printf("  \"playback_rate\": %.2f,\n", stats.playback_rate);
+  printf("  \"audio_stretch_ms\": %.1f,\n", stats.audio_stretch_us / 1000.0);
+  printf("  \"latency_us\": {\n");
+  printf("    \"decode\": {\"p50\": %lld, \"p99\": %lld},\n",
+         static_cast<long long>(stats.decode_p50_us),
+         static_cast<long long>(stats.decode_p99_us));
+  printf("    \"frame_interval\": {\"p50\": %lld, \"p99\": %lld, \"max\": %lld},\n",
+         static_cast<long long>(sink->frame_intervals_.Percentile(50)),
+         static_cast<long long>(sink->frame_intervals_.Percentile(99)),
+         static_cast<long long>(sink->frame_intervals_.Max()));
+  //整个运行过程的统计,不是最后一个统计周期
+  printf("    \"present_jitter\": {\"p50\": %lld, \"p99\": %lld, \"max\": %lld},\n",
+         static_cast<long long>(stats.run_jitter_p50_us),
+         static_cast<long long>(stats.run_jitter_p99_us),
+         static_cast<long long>(stats.run_jitter_max_us));
+  printf("    \"av_drift\": {\"p50\": %lld, \"p99\": %lld, \"max\": %lld},\n",
+         static_cast<long long>(stats.run_av_drift_p50_us),
+         static_cast<long long>(stats.run_av_drift_p99_us),
+         static_cast<long long>(stats.run_av_drift_max_us));
+  bool accurate = options.seek_mode == media::VideoPlayer::SeekMode::kAccurate;
+  printf("    \"seek\": {\"mode\": \"%s\", \"requested\": %llu, \"completed\": %llu, \"coalesced\": %llu, "
+         "\"discarded_frames\": %llu, \"p50\": %lld, \"p99\": %lld}\n",
+         accurate ? "accurate" : "keyframe",
+         static_cast<unsigned long long>(sink->seeks_),
+         static_cast<unsigned long long>(stats.seeks),
+         static_cast<unsigned long long>(stats.seeks_coalesced),
+         static_cast<unsigned long long>(stats.seek_discarded_frames),
+         static_cast<long long>(accurate ? stats.accurate_seek_p50_us : stats.seek_p50_us),
+         static_cast<long long>(accurate ? stats.accurate_seek_p99_us : stats.seek_p99_us));
+  printf("  },\n");
+  printf("  \"audio_clock_correction_us\": %lld,\n", static_cast<long long>(stats.audio_clock_correction_us));
+  printf("  \"audio_resyncs\": %llu,\n", static_cast<unsigned long long>(stats.audio_resyncs));
+  printf("  \"loops\": %llu,\n", static_cast<unsigned long long>(stats.loops));
+  printf("  \"clip_cache_bytes\": %zu,\n", stats.clip_cache_bytes);
+  printf("  \"clip_cache_hits\": %llu,\n", static_cast<unsigned long long>(stats.clip_cache_hits));
+  printf("  \"peak_packet_bytes\": %zu,\n", stats.peak_packet_bytes);
+  printf("  \"peak_frame_bytes\": %zu,\n", stats.peak_frame_bytes);
+  printf("  \"thread_cpu_ms\": {");
+  for (size_t i = 0; i < threads.size(); ++i) {
+    printf("%s\n    \"%s\": %.1f", i ? "," : "", threads[i].name.c_str(), threads[i].cpu_ms);
+  }
+  printf("\n  },\n");
+  printf("  \"peak_rss_kb\": %ld\n", PeakRssKb());
+  printf("}\n");
+}
+}
+
+int main(int argc, char **argv) {
+  BenchOptions options;
+  if (!ParseArgs(argc, argv, &options)) {
+    fprintf(stderr,
+            "usage: %s <file.mp4> [--mode=decode|realtime|seek] [--duration=s] "
+            "[--seek-interval=ms] [--seek-burst=N] [--seek-mode=keyframe|accurate]\n"
+            "       [--decoder=auto|mpp|ffmpeg] [--audio] [--clock=system|audio]\n"
+            "       [--clip-cache-mb=N] [--fast-start] [--trick=N] [--rate=X]\n",
+            argv[0]);
+    return 1;
+  }
+  RK_MPI_SYS_Init();
+  media::PacketQueue::Init();
+
+  media::Mp4Dataset::Options dataset_options;
+  dataset_options.use_mmap = true;
+  std::unique_ptr<media::Mp4Dataset> dataset = media::Mp4Dataset::create(options.file, dataset_options);
+  if (!dataset) {
+    fprintf(stderr, "failed to open %s\n", options.file.c_str());
+    return 1;
+  }
+
+  media::VideoPlayer::Options player_options;
+  player_options.video_decoder = options.decoder;
+  player_options.clock_mode = options.clock;
+  player_options.fast_start = options.fast_start;
+  player_options.seek_mode = options.seek_mode;
+  player_options.buffer_mode = media::VideoPlayer::BufferMode::kCompressedPackets;
+  if (options.mode == Mode::kDecode) {
+    player_options.render_mode = media::VideoPlayer::RenderMode::kFreeRun;
+    player_options.enable_audio = false;
+  } else {
+    player_options.render_mode = media::VideoPlayer::RenderMode::kNextFrame;
+    player_options.enable_audio = options.audio;
+    //realtime/seek 模式按时长运行,文件短的话循环播放
+    player_options.loop = true;
+    player_options.clip_cache_bytes = options.clip_cache_mb * 1024 * 1024;
+  }
+
+  NullSink sink;
+  base::TimeTicks start = base::TimeTicks::Now();
+  std::unique_ptr<media::VideoPlayer> player(new media::VideoPlayer(&sink, dataset.get(), player_options));
+  sink.set_player(player.get());
+
+  if (options.mode == Mode::kDecode) {
+    //解码模式跑到文件结束
+    sink.WaitForStop(base::TimeDelta::Max());
+  } else {
+    base::TimeTicks end_time = start + base::TimeDelta::FromSecondsD(options.duration);
+    base::TimeDelta interval = options.mode == Mode::kSeek
+                               ? base::TimeDelta::FromMilliseconds(options.seek_interval_ms)
+                               : base::TimeDelta::FromSecondsD(options.duration);
+    AVFormatContext *format_ctx = dataset->getFormatContext();
+    double duration = format_ctx->duration > 0 ? format_ctx->duration / 1000000.0 : 1.0;
+    if (options.mode != Mode::kDecode && options.rate != 1.0)
+      player->SetPlaybackRate(options.rate);
+    if (options.mode == Mode::kRealtime && options.trick != 0) {
+      //快退从文件末尾开始
+      if (options.trick < 0)
+        player->Seek(duration);
+      player->SetTrickPlay(options.trick);
+    }
+    srand(1);
+    while (true) {
+      base::TimeDelta remaining = end_time - base::TimeTicks::Now();
+      if (remaining <= base::TimeDelta() || sink.WaitForStop(std::min(remaining, interval)))
+        break;
+      if (options.mode == Mode::kSeek && base::TimeTicks::Now() < end_time) {
+        for (int i = 0; i < options.seek_burst; ++i) {
+          if (i > 0)
+            usleep(kSeekBurstSpacingMs * 1000);
+          sink.Seeking();
+          player->Seek(duration * rand() / RAND_MAX);
+        }
+      }
+    }
+  }
+  double seconds = (base::TimeTicks::Now() - start).InSecondsF();
+  //析构时 render/解封装/解码线程都会退出,从 /proc/self/task 中消失,所以要在这之前读取每个线程的 CPU 时间
+  std::vector<ThreadCpu> threads = ReadThreadCpu();
+  //析构时 OnStop 会刷新统计并回调 OnMediaStop
+  player.reset();
+  PrintJson(options, &sink, seconds, threads);
+  return 0;
+}
@@ -0,0 +1,470 @@
+#include "bench/synthetic_mp4.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+namespace bench {
+namespace {
+const uint32_t kVideoTimescale = 15360;
+const uint32_t kAudioTimescale = 44100;
+const uint32_t kAudioFrameSize = 1024;
+const uint32_t kMovieTimescale = 1000;
+const uint16_t kWidth = 320;
+const uint16_t kHeight = 240;
+const uint32_t kAudioSampleSize = 16;
+
+class ByteWriter {
+public:
+ void U8(uint32_t v) { data_.push_back(static_cast<uint8_t>(v)); }
+ void U16(uint32_t v) {
+   U8(v >> 8);
+   U8(v);
+ }
+ void U24(uint32_t v) {
+   U8(v >> 16);
+   U16(v);
+ }
+ void U32(uint32_t v) {
+   U16(v >> 16);
+   U16(v);
+ }
+ void U64(uint64_t v) {
+   U32(static_cast<uint32_t>(v >> 32));
+   U32(static_cast<uint32_t>(v));
+ }
+ void Bytes(const void *p, size_t size) {
+   auto b = static_cast<const uint8_t *>(p);
+   data_.insert(data_.end(), b, b + size);
+ }
+ void Zeros(size_t size) { data_.insert(data_.end(), size, 0); }
+ void FullBox(const char *type, uint8_t version, uint32_t flags) {
+   Begin(type);
+   U8(version);
+   U24(flags);
+ }
+ void Begin(const char *type) {
+   stack_.push_back(data_.size());
+   U32(0);
+   Bytes(type, 4);
+ }
+ void End() {
+   size_t start = stack_.back();
+   stack_.pop_back();
+   auto size = static_cast<uint32_t>(data_.size() - start);
+   data_[start] = static_cast<uint8_t>(size >> 24);
+   data_[start + 1] = static_cast<uint8_t>(size >> 16);
+   data_[start + 2] = static_cast<uint8_t>(size >> 8);
+   data_[start + 3] = static_cast<uint8_t>(size);
+ }
+ void Matrix() {
+   const uint32_t matrix[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+   for (uint32_t v : matrix) U32(v);
+ }
+ size_t size() const { return data_.size(); }
+ const std::vector<uint8_t> &data() const { return data_; }
+
+private:
+ std::vector<uint8_t> data_;
+ std::vector<size_t> stack_;
+};
+
+//RBSP 比特写入,结束时加上 trailing bits 和防竞争字节
+class BitWriter {
+public:
+ BitWriter() : bits_(0), count_(0) {}
+ void Bits(uint32_t value, int n) {
+   for (int i = n - 1; i >= 0; --i) {
+     bits_ = (bits_ << 1) | ((value >> i) & 1);
+     if (++count_ == 8) {
+       rbsp_.push_back(bits_);
+       bits_ = 0;
+       count_ = 0;
+     }
+   }
+ }
+ void Ue(uint32_t value) {
+   uint32_t v = value + 1;
+   int len = 0;
+   for (uint32_t t = v; t > 1; t >>= 1) ++len;
+   Bits(0, len);
+   Bits(v, len + 1);
+ }
+ void Se(int32_t value) {
+   Ue(value > 0 ? 2 * value - 1 : -2 * value);
+ }
+ std::vector<uint8_t> Finish(uint8_t nal_header) {
+   Bits(1, 1);
+   while (count_) Bits(0, 1);
+   std::vector<uint8_t> nal(1, nal_header);
+   int zeros = 0;
+   for (uint8_t b : rbsp_) {
+     if (zeros >= 2 && b <= 3) {
+       nal.push_back(3);
+       zeros = 0;
+     }
+     nal.push_back(b);
+     zeros = b == 0 ? zeros + 1 : 0;
+   }
+   return nal;
+ }
+
+private:
+ std::vector<uint8_t> rbsp_;
+ uint8_t bits_;
+ int count_;
+};
+
+std::vector<uint8_t> MakeSps() {
+  BitWriter w;
+  w.Bits(66, 8);   // profile_idc: baseline
+  w.Bits(0xc0, 8); // constraint_set0/1
+  w.Bits(30, 8);   // level_idc
+  w.Ue(0);         // seq_parameter_set_id
+  w.Ue(0);         // log2_max_frame_num_minus4
+  w.Ue(2);         // pic_order_cnt_type
+  w.Ue(1);         // max_num_ref_frames
+  w.Bits(0, 1);    // gaps_in_frame_num_value_allowed_flag
+  w.Ue(kWidth / 16 - 1);
+  w.Ue(kHeight / 16 - 1);
+  w.Bits(1, 1);    // frame_mbs_only_flag
+  w.Bits(1, 1);    // direct_8x8_inference_flag
+  w.Bits(0, 1);    // frame_cropping_flag
+  w.Bits(0, 1);    // vui_parameters_present_flag
+  return w.Finish(0x67);
+}
+
+std::vector<uint8_t> MakePps() {
+  BitWriter w;
+  w.Ue(0);      // pic_parameter_set_id
+  w.Ue(0);      // seq_parameter_set_id
+  w.Bits(0, 1); // entropy_coding_mode_flag
+  w.Bits(0, 1); // bottom_field_pic_order_in_frame_present_flag
+  w.Ue(0);      // num_slice_groups_minus1
+  w.Ue(0);      // num_ref_idx_l0_default_active_minus1
+  w.Ue(0);      // num_ref_idx_l1_default_active_minus1
+  w.Bits(0, 1); // weighted_pred_flag
+  w.Bits(0, 2); // weighted_bipred_idc
+  w.Se(0);      // pic_init_qp_minus26
+  w.Se(0);      // pic_init_qs_minus26
+  w.Se(0);      // chroma_qp_index_offset
+  w.Bits(1, 1); // deblocking_filter_control_present_flag
+  w.Bits(0, 1); // constrained_intra_pred_flag
+  w.Bits(0, 1); // redundant_pic_cnt_present_flag
+  return w.Finish(0x68);
+}
+
+struct TrackTable {
+  std::vector<uint32_t> sizes;
+  std::vector<uint32_t> chunk_offsets;
+  std::vector<uint32_t> chunk_samples;
+};
+
+void WriteStsc(ByteWriter *w, const TrackTable &table) {
+  std::vector<std::pair<uint32_t, uint32_t>> entries;
+  for (size_t i = 0; i < table.chunk_samples.size(); ++i) {
+    if (entries.empty() || entries.back().second != table.chunk_samples[i]) {
+      entries.emplace_back(static_cast<uint32_t>(i + 1), table.chunk_samples[i]);
+    }
+  }
+  w->FullBox("stsc", 0, 0);
+  w->U32(entries.size());
+  for (auto &entry : entries) {
+    w->U32(entry.first);
+    w->U32(entry.second);
+    w->U32(1);
+  }
+  w->End();
+}
+
+void WriteSampleTables(ByteWriter *w, const TrackTable &table) {
+  WriteStsc(w, table);
+  w->FullBox("stsz", 0, 0);
+  w->U32(0);
+  w->U32(table.sizes.size());
+  for (uint32_t size : table.sizes) w->U32(size);
+  w->End();
+  w->FullBox("stco", 0, 0);
+  w->U32(table.chunk_offsets.size());
+  for (uint32_t offset : table.chunk_offsets) w->U32(offset);
+  w->End();
+}
+
+void WriteTrackHeader(ByteWriter *w, uint32_t track_id, uint64_t duration, bool video) {
+  w->FullBox("tkhd", 0, 3);
+  w->U32(0);
+  w->U32(0);
+  w->U32(track_id);
+  w->U32(0);
+  w->U32(static_cast<uint32_t>(duration));
+  w->Zeros(8);
+  w->U16(0);
+  w->U16(video ? 0 : 1);
+  w->U16(video ? 0 : 0x0100);
+  w->U16(0);
+  w->Matrix();
+  w->U32(video ? kWidth << 16 : 0);
+  w->U32(video ? kHeight << 16 : 0);
+  w->End();
+}
+
+void WriteMediaHeader(ByteWriter *w, uint32_t timescale, uint64_t duration, const char *handler) {
+  w->FullBox("mdhd", 0, 0);
+  w->U32(0);
+  w->U32(0);
+  w->U32(timescale);
+  w->U32(static_cast<uint32_t>(duration));
+  w->U16(0x55c4);
+  w->U16(0);
+  w->End();
+  w->FullBox("hdlr", 0, 0);
+  w->U32(0);
+  w->Bytes(handler, 4);
+  w->Zeros(12);
+  w->U8(0);
+  w->End();
+}
+
+void WriteDataInformation(ByteWriter *w) {
+  w->Begin("dinf");
+  w->FullBox("dref", 0, 0);
+  w->U32(1);
+  w->FullBox("url ", 0, 1);
+  w->End();
+  w->End();
+  w->End();
+}
+
+void WriteVideoTrack(ByteWriter *w, const SyntheticMp4Options &options, const TrackTable &table) {
+  const uint32_t delta = kVideoTimescale / options.fps;
+  //固定两帧的显示延迟,由 edit list 抵消掉
+  const uint32_t cts_offset = 2 * delta;
+  const uint64_t media_duration = static_cast<uint64_t>(delta) * table.sizes.size();
+  const uint64_t movie_duration = media_duration * kMovieTimescale / kVideoTimescale;
+  std::vector<uint8_t> sps = MakeSps();
+  std::vector<uint8_t> pps = MakePps();
+
+  w->Begin("trak");
+  WriteTrackHeader(w, 1, movie_duration, true);
+  w->Begin("edts");
+  w->FullBox("elst", 0, 0);
+  w->U32(1);
+  w->U32(static_cast<uint32_t>(movie_duration));
+  w->U32(cts_offset);
+  w->U32(0x00010000);
+  w->End();
+  w->End();
+  w->Begin("mdia");
+  WriteMediaHeader(w, kVideoTimescale, media_duration, "vide");
+  w->Begin("minf");
+  w->FullBox("vmhd", 0, 1);
+  w->Zeros(8);
+  w->End();
+  WriteDataInformation(w);
+  w->Begin("stbl");
+  w->FullBox("stsd", 0, 0);
+  w->U32(1);
+  w->Begin("avc1");
+  w->Zeros(6);
+  w->U16(1);
+  w->Zeros(16);
+  w->U16(kWidth);
+  w->U16(kHeight);
+  w->U32(0x00480000);
+  w->U32(0x00480000);
+  w->U32(0);
+  w->U16(1);
+  w->Zeros(32);
+  w->U16(0x0018);
+  w->U16(0xffff);
+  w->Begin("avcC");
+  w->U8(1);
+  w->U8(sps[1]);
+  w->U8(sps[2]);
+  w->U8(sps[3]);
+  w->U8(0xff);
+  w->U8(0xe1);
+  w->U16(sps.size());
+  w->Bytes(sps.data(), sps.size());
+  w->U8(1);
+  w->U16(pps.size());
+  w->Bytes(pps.data(), pps.size());
+  w->End();
+  w->End();
+  w->End();
+  w->FullBox("stts", 0, 0);
+  w->U32(1);
+  w->U32(table.sizes.size());
+  w->U32(delta);
+  w->End();
+  w->FullBox("ctts", 0, 0);
+  w->U32(1);
+  w->U32(table.sizes.size());
+  w->U32(cts_offset);
+  w->End();
+  w->FullBox("stss", 0, 0);
+  w->U32((table.sizes.size() + options.gop - 1) / options.gop);
+  for (size_t i = 0; i < table.sizes.size(); i += options.gop) {
+    w->U32(i + 1);
+  }
+  w->End();
+  WriteSampleTables(w, table);
+  w->End();
+  w->End();
+  w->End();
+  w->End();
+}
+
+void WriteAudioTrack(ByteWriter *w, const TrackTable &table) {
+  const uint64_t media_duration = static_cast<uint64_t>(kAudioFrameSize) * table.sizes.size();
+  const uint64_t movie_duration = media_duration * kMovieTimescale / kAudioTimescale;
+
+  w->Begin("trak");
+  WriteTrackHeader(w, 2, movie_duration, false);
+  w->Begin("mdia");
+  WriteMediaHeader(w, kAudioTimescale, media_duration, "soun");
+  w->Begin("minf");
+  w->FullBox("smhd", 0, 0);
+  w->U32(0);
+  w->End();
+  WriteDataInformation(w);
+  w->Begin("stbl");
+  w->FullBox("stsd", 0, 0);
+  w->U32(1);
+  w->Begin("mp4a");
+  w->Zeros(6);
+  w->U16(1);
+  w->Zeros(8);
+  w->U16(2);
+  w->U16(16);
+  w->U32(0);
+  w->U32(kAudioTimescale << 16);
+  w->FullBox("esds", 0, 0);
+  w->U8(0x03);       // ES_Descriptor
+  w->U8(25);
+  w->U16(2);
+  w->U8(0);
+  w->U8(0x04);       // DecoderConfigDescriptor
+  w->U8(17);
+  w->U8(0x40);       // AAC
+  w->U8(0x15);       // audio stream
+  w->U24(0);
+  w->U32(128000);
+  w->U32(128000);
+  w->U8(0x05);       // AudioSpecificConfig: AAC-LC 44100Hz stereo
+  w->U8(2);
+  w->U8(0x12);
+  w->U8(0x10);
+  w->U8(0x06);       // SLConfigDescriptor
+  w->U8(1);
+  w->U8(0x02);
+  w->End();
+  w->End();
+  w->End();
+  w->FullBox("stts", 0, 0);
+  w->U32(1);
+  w->U32(table.sizes.size());
+  w->U32(kAudioFrameSize);
+  w->End();
+  WriteSampleTables(w, table);
+  w->End();
+  w->End();
+  w->End();
+  w->End();
+}
+
+//第 chunk 个视频 chunk 开始时间对应的音频帧序号
+uint32_t AudioSampleAt(const SyntheticMp4Options &options, uint64_t chunk) {
+  return static_cast<uint32_t>(chunk * options.samples_per_chunk * kAudioTimescale
+                                   / (static_cast<uint64_t>(options.fps) * kAudioFrameSize));
+}
+}
+
+bool WriteSyntheticMp4(const std::string &path, const SyntheticMp4Options &options) {
+  if (!options.video_samples || options.fps <= 0 || options.gop <= 0 || options.samples_per_chunk <= 0)
+    return false;
+
+  ByteWriter head;
+  head.Begin("ftyp");
+  head.Bytes("isom", 4);
+  head.U32(0x200);
+  head.Bytes("isomiso2avc1mp41", 16);
+  head.End();
+  const size_t mdat_start = head.size();
+
+  ByteWriter mdat;
+  mdat.Begin("mdat");
+  TrackTable video;
+  TrackTable audio;
+  const uint64_t chunks = (options.video_samples + options.samples_per_chunk - 1) / options.samples_per_chunk;
+  uint32_t sample = 0;
+  for (uint64_t chunk = 0; chunk < chunks; ++chunk) {
+    video.chunk_offsets.push_back(static_cast<uint32_t>(mdat_start + mdat.size()));
+    uint32_t count = 0;
+    for (; count < static_cast<uint32_t>(options.samples_per_chunk) && sample < options.video_samples; ++count) {
+      bool keyframe = sample % options.gop == 0;
+      uint32_t size = keyframe ? options.keyframe_size : options.frame_size;
+      //AVCC 格式: 4 字节长度 + NAL
+      mdat.U32(size - 4);
+      mdat.U8(keyframe ? 0x65 : 0x41);
+      mdat.Zeros(size - 5);
+      video.sizes.push_back(size);
+      ++sample;
+    }
+    video.chunk_samples.push_back(count);
+
+    if (options.with_audio) {
+      uint32_t begin = AudioSampleAt(options, chunk);
+      uint32_t end = AudioSampleAt(options, chunk + 1);
+      if (end > begin) {
+        audio.chunk_offsets.push_back(static_cast<uint32_t>(mdat_start + mdat.size()));
+        audio.chunk_samples.push_back(end - begin);
+        for (uint32_t i = begin; i < end; ++i) {
+          mdat.Zeros(kAudioSampleSize);
+          audio.sizes.push_back(kAudioSampleSize);
+        }
+      }
+    }
+  }
+  mdat.End();
+
+  ByteWriter moov;
+  const uint64_t duration = static_cast<uint64_t>(options.video_samples) * kMovieTimescale / options.fps;
+  moov.Begin("moov");
+  moov.FullBox("mvhd", 0, 0);
+  moov.U32(0);
+  moov.U32(0);
+  moov.U32(kMovieTimescale);
+  moov.U32(static_cast<uint32_t>(duration));
+  moov.U32(0x00010000);
+  moov.U16(0x0100);
+  moov.Zeros(10);
+  moov.Matrix();
+  moov.Zeros(24);
+  moov.U32(options.with_audio ? 3 : 2);
+  moov.End();
+  WriteVideoTrack(&moov, options, video);
+  if (options.with_audio && !audio.sizes.empty()) {
+    WriteAudioTrack(&moov, audio);
+  }
+  moov.End();
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp)
+    return false;
+  bool ok = fwrite(head.data().data(), 1, head.size(), fp) == head.size()
+      && fwrite(mdat.data().data(), 1, mdat.size(), fp) == mdat.size()
+      && fwrite(moov.data().data(), 1, moov.size(), fp) == moov.size();
+  return fclose(fp) == 0 && ok;
+}
+
+void DropFileCache(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+}
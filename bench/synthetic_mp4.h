@@ -0,0 +1,39 @@
+#ifndef BENCH_SYNTHETIC_MP4_H_
+#define BENCH_SYNTHETIC_MP4_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace bench {
+
+/*
+ * 生成用于 benchmark 的 mp4 文件: 一路 H.264(avc1) 视频 + 可选一路 AAC 音频,
+ * 音视频按 chunk 交织, moov 放在文件末尾(和摄像头录制的文件一致)
+ * sample 的内容不是合法的码流,只用来测试解封装
+ */
+struct SyntheticMp4Options {
+  uint32_t video_samples;
+  int fps;
+  int gop;
+  int samples_per_chunk;
+  uint32_t keyframe_size;
+  uint32_t frame_size;
+  bool with_audio;
+
+  SyntheticMp4Options()
+      : video_samples(900),
+        fps(30),
+        gop(30),
+        samples_per_chunk(10),
+        keyframe_size(256),
+        frame_size(32),
+        with_audio(true) {}
+};
+
+bool WriteSyntheticMp4(const std::string &path, const SyntheticMp4Options &options);
+
+// 把文件从 page cache 中丢掉,模拟冷启动
+void DropFileCache(const std::string &path);
+}
+
+#endif //BENCH_SYNTHETIC_MP4_H_
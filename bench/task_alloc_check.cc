@@ -0,0 +1,190 @@
+// 检查 MessageLoop 稳定运行时不再分配内存
+// 替换 malloc/calloc/realloc(glibc 的 operator new 也走 malloc),统计分配次数
+// 先预热,让任务池、libevent 的定时器堆等达到稳定大小(池最多增长到同时在队列中的任务数),然后统计:
+// 1. render: 和 VideoPlayer::ManageTimer 一样,单次 Timer 在任务中重新设置自己
+// 2. self-post: loop 线程中给自己投递 std::bind 任务
+// 3. cross-thread: 另一个线程每次投递 kBatch 个 lambda,等 loop 执行完再投递下一批,
+//    队列深度有上限,和解码线程给 player 线程投递一样,投递方和 loop 线程的分配都统计在内
+//    (不等待的话队列会一直变长,池也要跟着变大)
+//    drained 被 Signal 时 loop 线程还没有释放这个任务的节点,下一批可能比上一批多用一个节点,
+//    所以预热时每批投递两倍的任务,池中留出余量
+// 每一项的分配次数都应为 0,否则返回非 0
+//
+// 用法: task_alloc_check [每项的任务数]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <functional>
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/timer/timer.h"
+#include "base/time/time.h"
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+std::atomic<int64_t> g_allocations(0);
+}
+
+extern "C" {
+void *malloc(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+}
+
+namespace {
+const int kWarmupTasks = 10000;
+const int kBatch = 64;
+
+// 模拟 render 线程: 每次 OnRender 之后重新设置单次定时器,并投递一个小任务
+class Render {
+public:
+ Render(int ticks, base::WaitableEvent *done)
+     : ticks_(ticks), done_(done), timer_(false) {}
+
+ void Start() {
+   ManageTimer();
+ }
+
+ int64_t allocations() const { return allocations_; }
+
+private:
+ void OnRender() {
+   if (++count_ == kWarmupTasks)
+     start_ = g_allocations.load();
+   if (count_ == kWarmupTasks + ticks_) {
+     allocations_ = g_allocations.load() - start_;
+     done_->Signal();
+     return;
+   }
+   base::MessageLoop::current()->PostDelayedTask(
+       base::SmallClosure(std::bind(&Render::OnPosted, this, count_)), base::TimeDelta());
+   ManageTimer();
+ }
+
+ void OnPosted(int tick) {
+   last_posted_ = tick;
+ }
+
+ void ManageTimer() {
+   timer_.Start(std::bind(&Render::OnRender, this), base::TimeDelta());
+ }
+
+ int ticks_;
+ base::WaitableEvent *done_;
+ base::Timer timer_;
+ int count_ = 0;
+ int last_posted_ = 0;
+ int64_t start_ = 0;
+ int64_t allocations_ = 0;
+};
+
+int64_t CheckRender(int ticks) {
+  base::Thread thread("RenderLoop");
+  thread.Start();
+  base::WaitableEvent done(true, false);
+  Render *render = nullptr;
+  thread.PostTask([&]() {
+    render = new Render(ticks, &done);
+    render->Start();
+  });
+  done.Wait();
+  int64_t allocations = render->allocations();
+  thread.PostTask([render]() { delete render; });
+  thread.Stop();
+  return allocations;
+}
+
+struct SelfPost {
+  int remaining;
+  int64_t start;
+  int64_t allocations;
+  base::WaitableEvent *done;
+
+  void Run() {
+    if (remaining == 0) {
+      allocations = g_allocations.load() - start;
+      done->Signal();
+      return;
+    }
+    if (--remaining == 0)
+      start = g_allocations.load();
+    base::MessageLoop::current()->PostDelayedTask(
+        base::SmallClosure(std::bind(&SelfPost::Run, this)), base::TimeDelta());
+  }
+};
+
+int64_t CheckSelfPost(int tasks) {
+  base::Thread thread("SelfPostLoop");
+  thread.Start();
+  base::WaitableEvent done(true, false);
+  //预热一轮,再统计一轮
+  SelfPost warmup = {kWarmupTasks, 0, 0, &done};
+  thread.PostTask(std::bind(&SelfPost::Run, &warmup));
+  done.Wait();
+  done.Reset();
+  SelfPost post = {1, 0, 0, &done};
+  thread.PostTask([&post, tasks]() {
+    post.remaining = tasks + 1;
+    post.Run();
+  });
+  done.Wait();
+  thread.Stop();
+  return post.allocations;
+}
+
+int64_t CheckCrossThread(int tasks) {
+  base::Thread thread("CrossLoop");
+  thread.Start();
+  base::WaitableEvent drained(false, false);
+  int count = 0;
+  int64_t start = 0;
+  for (int i = 0; i < kWarmupTasks + tasks; i += kBatch) {
+    if (i >= kWarmupTasks && start == 0)
+      start = g_allocations.load();
+    int batch = i < kWarmupTasks ? kBatch * 2 : kBatch;
+    for (int j = 0; j < batch; ++j) {
+      thread.PostTask([&count]() { ++count; });
+    }
+    //最后一个任务执行完,这一批的节点都已经回到池中
+    thread.PostTask([&drained]() { drained.Signal(); });
+    drained.Wait();
+  }
+  int64_t allocations = g_allocations.load() - start;
+  thread.Stop();
+  return allocations;
+}
+
+bool Report(const char *name, int tasks, int64_t allocations) {
+  printf("%-14s %10d %12lld %6s\n", name, tasks, static_cast<long long>(allocations),
+         allocations == 0 ? "ok" : "FAIL");
+  return allocations == 0;
+}
+}
+
+int main(int argc, char **argv) {
+  int tasks = argc > 1 ? atoi(argv[1]) : 100000;
+  if (tasks < 1) tasks = 1;
+  printf("%-14s %10s %12s %6s\n", "check", "tasks", "allocations", "");
+  bool ok = true;
+  ok &= Report("render", tasks, CheckRender(tasks));
+  ok &= Report("self-post", tasks, CheckSelfPost(tasks));
+  ok &= Report("cross-thread", tasks, CheckCrossThread(tasks));
+  return ok ? 0 : 1;
+}
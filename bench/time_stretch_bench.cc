@@ -0,0 +1,73 @@
+// 音频变速不变调(media/audio_time_stretcher)的开销: 每处理 1 秒输入音频占用的 CPU 时间
+// 输入是合成的立体声(几个谐波加上少量噪声),按 AAC 的帧长 1024 分块送入,和播放时一样
+//
+// 用法: time_stretch_bench [输入秒数] [采样率]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include "base/time/time.h"
+#include "media/audio_time_stretcher.h"
+
+namespace {
+const double kRates[] = {0.5, 0.75, 1.0, 1.25, 1.5, 2.0};
+
+const int kChannels = 2;
+
+const int kChunkFrames = 1024;
+
+std::vector<int16_t> MakeSignal(int sample_rate, int seconds) {
+  std::vector<int16_t> pcm(static_cast<size_t>(sample_rate) * seconds * kChannels);
+  srand(1);
+  for (size_t i = 0; i < pcm.size() / kChannels; ++i) {
+    double t = static_cast<double>(i) / sample_rate;
+    //基频每秒缓慢变化,避免周期信号让搜索总是落在同一个位置
+    double f = 220 + 40 * sin(2 * M_PI * 0.25 * t);
+    double v = 0.5 * sin(2 * M_PI * f * t) + 0.25 * sin(2 * M_PI * 2 * f * t) + 0.12 * sin(2 * M_PI * 3 * f * t);
+    v += 0.05 * (rand() / static_cast<double>(RAND_MAX) - 0.5);
+    pcm[i * kChannels] = static_cast<int16_t>(v * 20000);
+    pcm[i * kChannels + 1] = static_cast<int16_t>(v * 18000);
+  }
+  return pcm;
+}
+}
+
+int main(int argc, char **argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 60;
+  int sample_rate = argc > 2 ? atoi(argv[2]) : 44100;
+  if (seconds < 1) seconds = 1;
+  if (sample_rate < 8000) sample_rate = 8000;
+  std::vector<int16_t> pcm = MakeSignal(sample_rate, seconds);
+  size_t total_frames = pcm.size() / kChannels;
+  std::vector<int16_t> output(static_cast<size_t>(kChunkFrames) * 4 * kChannels);
+
+  printf("%8s %10s %10s %12s %10s\n", "rate", "input(s)", "output(s)", "ms/audio-s", "cpu(%)");
+  for (double rate : kRates) {
+    media::AudioTimeStretcher stretcher;
+    if (!stretcher.Init(sample_rate, kChannels))
+      return 1;
+    stretcher.SetRate(rate);
+    uint64_t output_frames = 0;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t pos = 0; pos + kChunkFrames <= total_frames; pos += kChunkFrames) {
+      stretcher.Push(&pcm[pos * kChannels], kChunkFrames,
+                     static_cast<int64_t>(pos) * base::Time::kMicrosecondsPerSecond / sample_rate);
+      int frames;
+      while ((frames = stretcher.Pull(&output[0], static_cast<int>(output.size() / kChannels), nullptr)) > 0) {
+        output_frames += frames;
+      }
+    }
+    double elapsed_ms = (base::TimeTicks::Now() - start).InMillisecondsF();
+    //播放时 1 秒输入要在 1/rate 秒内处理完
+    double cost = elapsed_ms / seconds;
+    printf("%8.2f %10d %10.2f %12.3f %10.2f\n",
+           rate,
+           seconds,
+           static_cast<double>(output_frames) / sample_rate,
+           cost,
+           cost * rate / 10.0);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+// render 定时器的唤醒延迟: 原来的 libevent 定时器(base::Timer) 和 timerfd 绝对时间定时器(base::HighResTimer)
+// 理想的唤醒时间是 start + k * interval,每次唤醒记录晚到的时间
+// 1. event: base::Timer 每次用相对时间 interval 重新设置,误差会累积
+// 2. event+fix: base::Timer 每次用 deadline - now 重新设置,和原来的 VideoPlayer 用 base_time 修正一样
+// 3. timerfd: base::HighResTimer::StartAt 每次设置下一个绝对时间
+// 4. periodic: base::HighResTimer::StartPeriodic,由内核按周期触发
+// 输出晚到时间的分位数,以及最后一次唤醒相对理想时间的偏移(drift)
+// 每种定时器分别在默认 timer slack 和 kSlackUs 下各跑一次
+//
+// 用法: timer_lateness_bench [唤醒次数] [间隔(微秒)]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread.h"
+#include "base/timer/high_res_timer.h"
+#include "base/timer/timer.h"
+#include "base/time/time.h"
+
+namespace {
+const int64_t kDefaultSlackUs = 50;
+const int64_t kSlackUs = 1;
+
+enum class Mode {
+  kEvent,
+  kEventFixed,
+  kTimerFd,
+  kPeriodic,
+};
+
+const char *ModeName(Mode mode) {
+  switch (mode) {
+    case Mode::kEvent:
+      return "event";
+    case Mode::kEventFixed:
+      return "event+fix";
+    case Mode::kTimerFd:
+      return "timerfd";
+    case Mode::kPeriodic:
+      return "periodic";
+  }
+  return "";
+}
+
+// 在 loop 线程中创建和运行
+class LatenessProbe {
+public:
+ LatenessProbe(Mode mode, int ticks, base::TimeDelta interval, base::WaitableEvent *done)
+     : mode_(mode), ticks_(ticks), interval_(interval), done_(done), timer_(false) {
+   late_us_.reserve(ticks);
+ }
+
+ void Start() {
+   start_ = base::TimeTicks::Now();
+   switch (mode_) {
+     case Mode::kEvent:
+     case Mode::kEventFixed:
+       timer_.Start(std::bind(&LatenessProbe::OnTick, this), interval_);
+       break;
+     case Mode::kTimerFd:
+       high_res_timer_.StartAt(std::bind(&LatenessProbe::OnTick, this), Deadline(1));
+       break;
+     case Mode::kPeriodic:
+       high_res_timer_.StartPeriodic(std::bind(&LatenessProbe::OnTick, this), Deadline(1), interval_);
+       break;
+   }
+ }
+
+ const std::vector<int64_t> &late_us() const { return late_us_; }
+
+ uint64_t missed_periods() const { return high_res_timer_.missed_periods(); }
+
+private:
+ base::TimeTicks Deadline(int tick) const {
+   return start_ + interval_ * tick;
+ }
+
+ void OnTick() {
+   base::TimeTicks now = base::TimeTicks::Now();
+   int tick = static_cast<int>(late_us_.size()) + 1;
+   //periodic 模式下错过的周期合并成一次回调,按实际的周期数计算理想时间
+   if (mode_ == Mode::kPeriodic)
+     tick += static_cast<int>(high_res_timer_.missed_periods());
+   late_us_.push_back((now - Deadline(tick)).InMicroseconds());
+   if (static_cast<int>(late_us_.size()) == ticks_) {
+     timer_.Stop();
+     high_res_timer_.Stop();
+     done_->Signal();
+     return;
+   }
+   switch (mode_) {
+     case Mode::kEvent:
+       timer_.Start(std::bind(&LatenessProbe::OnTick, this), interval_);
+       break;
+     case Mode::kEventFixed: {
+       base::TimeDelta delay = Deadline(tick + 1) - base::TimeTicks::Now();
+       timer_.Start(std::bind(&LatenessProbe::OnTick, this), std::max(delay, base::TimeDelta()));
+       break;
+     }
+     case Mode::kTimerFd:
+       high_res_timer_.StartAt(std::bind(&LatenessProbe::OnTick, this), Deadline(tick + 1));
+       break;
+     case Mode::kPeriodic:
+       break;
+   }
+ }
+
+ Mode mode_;
+ int ticks_;
+ base::TimeDelta interval_;
+ base::WaitableEvent *done_;
+ base::Timer timer_;
+ base::HighResTimer high_res_timer_;
+ base::TimeTicks start_;
+ std::vector<int64_t> late_us_;
+};
+
+void Run(Mode mode, int64_t slack_us, int ticks, base::TimeDelta interval) {
+  base::Thread thread("TimerLoop");
+  thread.Start();
+  base::WaitableEvent done(true, false);
+  LatenessProbe *probe = nullptr;
+  thread.PostTask([&]() {
+    base::PlatformThread::SetCurrentThreadTimerSlack(base::TimeDelta::FromMicroseconds(slack_us));
+    probe = new LatenessProbe(mode, ticks, interval, &done);
+    probe->Start();
+  });
+  done.Wait();
+
+  std::vector<int64_t> late = probe->late_us();
+  int64_t drift = late.back();
+  std::sort(late.begin(), late.end());
+  printf("%-10s %8lld %8lld %8lld %8lld %8lld %10lld %8llu\n",
+         ModeName(mode),
+         static_cast<long long>(slack_us),
+         static_cast<long long>(late[late.size() / 2]),
+         static_cast<long long>(late[late.size() * 99 / 100]),
+         static_cast<long long>(late[late.size() * 999 / 1000]),
+         static_cast<long long>(late.back()),
+         static_cast<long long>(drift),
+         static_cast<unsigned long long>(probe->missed_periods()));
+  thread.PostTask([probe]() { delete probe; });
+  thread.Stop();
+}
+}
+
+int main(int argc, char **argv) {
+  int ticks = argc > 1 ? atoi(argv[1]) : 2000;
+  int64_t interval_us = argc > 2 ? atoll(argv[2]) : 2000;
+  if (ticks < 1) ticks = 1;
+  if (interval_us < 1) interval_us = 1;
+  base::TimeDelta interval = base::TimeDelta::FromMicroseconds(interval_us);
+
+  printf("ticks:%d interval:%lld us\n", ticks, static_cast<long long>(interval_us));
+  printf("%-10s %8s %8s %8s %8s %8s %10s %8s\n",
+         "timer", "slack", "p50(us)", "p99(us)", "p999(us)", "max(us)", "drift(us)", "missed");
+  const Mode modes[] = {Mode::kEvent, Mode::kEventFixed, Mode::kTimerFd, Mode::kPeriodic};
+  for (int64_t slack_us : {kDefaultSlackUs, kSlackUs}) {
+    for (Mode mode : modes) {
+      Run(mode, slack_us, ticks, interval);
+    }
+  }
+  return 0;
+}
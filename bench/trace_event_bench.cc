@@ -0,0 +1,95 @@
+// trace 宏的开销: 关闭时(只有一次判断)和打开时,每个事件的耗时
+// 然后几个线程同时记录带 flow 的事件,模拟 demux -> decode -> render 的流水线,
+// 记录过程中写出一次 JSON,最后再写出一次,可以用 chrome://tracing 或 ui.perfetto.dev 打开
+//
+// 用法: trace_event_bench [事件数] [输出文件]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "base/time/time.h"
+#include "base/trace_event/trace_event.h"
+
+namespace {
+const int kPipelineStages = 3;
+const char *const kStageNames[kPipelineStages] = {"demux", "decode", "render"};
+
+// 已经开始记录的线程数,它们的 ring 都已经创建,之后写出时确实在并发记录
+std::atomic<int> g_started_stages(0);
+
+// 不内联,让编译器不能把循环整个优化掉
+__attribute__((noinline)) int64_t Work(int64_t i) {
+  return i * 7 + 3;
+}
+
+__attribute__((noinline)) int64_t TracedWork(int64_t i) {
+  TRACE_EVENT1("bench", "TracedWork", "i", i);
+  return i * 7 + 3;
+}
+
+__attribute__((noinline)) int64_t FlowWork(int64_t i) {
+  TRACE_EVENT_FLOW_STEP0("bench", "Flow", i);
+  return i * 7 + 3;
+}
+
+template <typename Func>
+double NsPerCall(int64_t iterations, Func func) {
+  int64_t sum = 0;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int64_t i = 0; i < iterations; ++i)
+    sum += func(i);
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  if (sum == 42)
+    printf(" ");
+  return elapsed.InMicroseconds() * 1000.0 / iterations;
+}
+
+void Stage(int stage, int64_t frames) {
+  for (int64_t pts = 0; pts < frames; ++pts) {
+    TRACE_EVENT1("bench", kStageNames[stage], "pts", pts);
+    if (stage == 0)
+      TRACE_EVENT_FLOW_BEGIN0("bench", "Frame", pts);
+    else if (stage == kPipelineStages - 1)
+      TRACE_EVENT_FLOW_END0("bench", "Frame", pts);
+    else
+      TRACE_EVENT_FLOW_STEP0("bench", "Frame", pts);
+    if (pts == 0)
+      g_started_stages.fetch_add(1);
+  }
+}
+}
+
+int main(int argc, char **argv) {
+  int64_t iterations = argc > 1 ? atoll(argv[1]) : 10000000;
+  std::string path = argc > 2 ? argv[2] : "/tmp/trace_event_bench.json";
+  if (iterations < 1) iterations = 1;
+  using base::trace_event::TraceLog;
+
+  printf("%-22s %10s\n", "case", "ns/call");
+  printf("%-22s %10.2f\n", "no trace", NsPerCall(iterations, Work));
+  TraceLog::SetEnabled(false);
+  printf("%-22s %10.2f\n", "TRACE_EVENT1 off", NsPerCall(iterations, TracedWork));
+  printf("%-22s %10.2f\n", "FLOW_STEP off", NsPerCall(iterations, FlowWork));
+  TraceLog::SetEnabled(true);
+  printf("%-22s %10.2f\n", "TRACE_EVENT1 on", NsPerCall(iterations, TracedWork));
+  printf("%-22s %10.2f\n", "FLOW_STEP on", NsPerCall(iterations, FlowWork));
+
+  //记录的同时写出,检查不会卡住记录的线程
+  std::vector<std::thread> threads;
+  for (int stage = 0; stage < kPipelineStages; ++stage)
+    threads.emplace_back(Stage, stage, iterations / 10);
+  while (g_started_stages.load() < kPipelineStages)
+    std::this_thread::yield();
+  base::TimeTicks start = base::TimeTicks::Now();
+  std::string json = TraceLog::GetInstance()->ToJson();
+  base::TimeDelta dump_time = base::TimeTicks::Now() - start;
+  for (auto &t : threads)
+    t.join();
+  TraceLog::SetEnabled(false);
+  printf("dump while recording: %zu bytes in %lld us\n", json.size(),
+         static_cast<long long>(dump_time.InMicroseconds()));
+  return TraceLog::GetInstance()->WriteJsonFile(path) ? 0 : 1;
+}
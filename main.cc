@@ -3,9 +3,40 @@
 #include "main_app.h"
 #include <rga/RgaApi.h>
 #include <csignal>
+#include <cstdlib>
+#include <memory>
+#include "base/message_loop/message_loop.h"
+#include "base/threading/thread.h"
+#include "base/trace_event/trace_event.h"
+#include <event2/event.h>
+
+namespace {
+void OnDumpTrace(evutil_socket_t, short, void *arg) {
+  base::trace_event::TraceLog::GetInstance()->WriteJsonFile(static_cast<const char *>(arg));
+}
+
+//MP4PLAYER_TRACE_FILE=文件名 时开启 trace,kill -USR1 <pid> 或者退出时把最近的事件写到这个文件,
+//用 chrome://tracing 或 ui.perfetto.dev 打开
+std::unique_ptr<base::Thread> StartTracing(const char *trace_file) {
+  base::trace_event::TraceLog::SetEnabled(true);
+  std::unique_ptr<base::Thread> thread(new base::Thread("TraceDump"));
+  thread->Start();
+  thread->PostTask([trace_file]() {
+    //一直用到程序退出,不释放
+    struct event *ev = evsignal_new(base::MessageLoop::current()->base(), SIGUSR1,
+                                    &OnDumpTrace, const_cast<char *>(trace_file));
+    event_add(ev, nullptr);
+  });
+  return thread;
+}
+}
 
 int main(int argc, char *argv[]) {
   signal(SIGPIPE, SIG_IGN);
+  const char *trace_file = getenv("MP4PLAYER_TRACE_FILE");
+  std::unique_ptr<base::Thread> trace_thread;
+  if (trace_file)
+    trace_thread = StartTracing(trace_file);
   RK_MPI_SYS_Init();
   media::PacketQueue::Init();
   app::MainApp app(argc, argv);
@@ -13,5 +44,7 @@ int main(int argc, char *argv[]) {
   app::MainApp::exec();
 
   c_RkRgaDeInit();
+  if (trace_file)
+    base::trace_event::TraceLog::GetInstance()->WriteJsonFile(trace_file);
   return 0;
 }
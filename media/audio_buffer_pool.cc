@@ -0,0 +1,60 @@
+#include "media/audio_buffer_pool.h"
+#include <string.h>
+#include "base/logging.h"
+
+namespace media {
+
+RKAudioBufferPool::RKAudioBufferPool()
+    : pool_(nullptr),
+      buffer_size_(0),
+      fallback_count_(0) {}
+
+RKAudioBufferPool::~RKAudioBufferPool() {
+  UnInit();
+}
+
+bool RKAudioBufferPool::Init(size_t buffer_size, size_t buffer_count) {
+  if (pool_)
+    return true;
+  MB_POOL_PARAM_S param;
+  memset(&param, 0, sizeof(param));
+  param.u32Cnt = static_cast<RK_U32>(buffer_count);
+  param.u32Size = static_cast<RK_U32>(buffer_size);
+  param.enMediaType = MB_TYPE_COMMON;
+  param.bHardWare = RK_FALSE;
+  pool_ = RK_MPI_MB_POOL_Create(&param);
+  if (!pool_) {
+    LOG(ERROR) << "RK_MPI_MB_POOL_Create failed, size: " << buffer_size << ", count: " << buffer_count;
+    return false;
+  }
+  buffer_size_ = buffer_size;
+  fallback_count_ = 0;
+  return true;
+}
+
+void RKAudioBufferPool::UnInit() {
+  if (pool_) {
+    //还在 AO 或者队列中的 buffer 由 rkmedia 保证在释放之后才真正销毁
+    RK_MPI_MB_POOL_Destroy(pool_);
+    pool_ = nullptr;
+    LOG(INFO) << "audio buffer pool fallback count: " << fallback_count_;
+  }
+  buffer_size_ = 0;
+}
+
+MEDIA_BUFFER RKAudioBufferPool::Get(size_t size) {
+  if (pool_ && size <= buffer_size_) {
+    //不阻塞,池被 AO 占满时宁可临时申请,也不能让解码线程卡在这里无法退出
+    MEDIA_BUFFER mb = RK_MPI_MB_POOL_GetBuffer(pool_, RK_FALSE);
+    if (mb) {
+      //原地转换为音频类型,AO 只接受音频 buffer
+      MEDIA_BUFFER audio_mb = RK_MPI_MB_ConvertToAudioBuffer(mb);
+      if (audio_mb)
+        return audio_mb;
+      RK_MPI_MB_ReleaseBuffer(mb);
+    }
+  }
+  ++fallback_count_;
+  return RK_MPI_MB_CreateAudioBuffer(static_cast<RK_U32>(size), RK_FALSE);
+}
+}
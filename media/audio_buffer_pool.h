@@ -0,0 +1,43 @@
+#ifndef MEDIA_AUDIO_BUFFER_POOL_H_
+#define MEDIA_AUDIO_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "base/macros.h"
+#include <rkmedia/rkmedia_api.h>
+
+namespace media {
+
+/*
+ * 固定大小的 PCM 输出 buffer 池,基于 rkmedia 的 MB pool
+ * buffer 被 AO 和队列释放之后自动回到池中,不用每帧都申请一次
+ * 池中暂时没有空闲 buffer,或者请求的长度超过池的 buffer 大小时,退回到 RK_MPI_MB_CreateAudioBuffer
+ * 不是线程安全的,每个池只能在一个线程中使用(音频解码线程或者 render 线程)
+ */
+class RKAudioBufferPool {
+public:
+ RKAudioBufferPool();
+
+ ~RKAudioBufferPool();
+
+ bool Init(size_t buffer_size, size_t buffer_count);
+
+ void UnInit();
+
+ // 返回的 buffer 至少有 size 字节,用 RK_MPI_MB_ReleaseBuffer 释放
+ MEDIA_BUFFER Get(size_t size);
+
+ size_t buffer_size() const { return buffer_size_; }
+
+ // 没能从池中取到,临时申请的 buffer 数
+ uint64_t fallback_count() const { return fallback_count_; }
+
+private:
+ MEDIA_BUFFER_POOL pool_;
+ size_t buffer_size_;
+ uint64_t fallback_count_;
+ DISALLOW_COPY_AND_ASSIGN(RKAudioBufferPool);
+};
+}
+
+#endif //MEDIA_AUDIO_BUFFER_POOL_H_
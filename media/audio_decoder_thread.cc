@@ -6,7 +6,9 @@
 #include "media/audio_frame_queue.h"
 #include "media/packet_queue.h"
 #include "media/audio_resampler.h"
+#include "media/audio_buffer_pool.h"
 #include "media/video_player.h"
+#include "media/decoded_clip_cache.h"
 #include "media/media_constants.h"
 
 namespace media {
@@ -14,12 +16,16 @@ namespace media {
 AudioDecoderThread::AudioDecoderThread(VideoPlayer *player,
                                        Mp4Dataset *dataset,
                                        PacketQueue *input_queue,
-                                       AudioFrameQueue *output_queue)
+                                       AudioFrameQueue *output_queue,
+                                       DecodedClipCache *clip_cache)
     : player_(player),
       dataset_(dataset),
       input_queue_(input_queue),
       output_queue_(output_queue),
+      clip_cache_(clip_cache),
+      pending_packet_(nullptr),
       next_pts_(0),
+      discard_before_(AV_NOPTS_VALUE),
       keep_running_(true),
       thread_(new base::DelegateSimpleThread(this, "ADThread")) {
   thread_->Start();
@@ -27,10 +33,17 @@ AudioDecoderThread::AudioDecoderThread(VideoPlayer *player,
 
 AudioDecoderThread::~AudioDecoderThread() {
   keep_running_ = false;
+  //唤醒阻塞在队列上的解码线程
+  input_queue_->shutdown();
+  output_queue_->shutdown();
   if (thread_) {
     thread_->Join();
     thread_.reset();
   }
+  if (pending_packet_ && pending_packet_ != &PacketQueue::kFlushPkt) {
+    av_packet_unref(pending_packet_);
+    av_packet_free(&pending_packet_);
+  }
 }
 
 void AudioDecoderThread::Run() {
@@ -64,11 +77,25 @@ bool AudioDecoderThread::InitDecoder() {
     resampler_.reset();
     player_->OnMediaError(Error_AudioResamplerCreateFailed);
   }
+
+  //输出队列加上 AO 内部缓冲的帧数,池满时会临时申请
+  int frame_size = decoder_->codec_context()->frame_size;
+  if (frame_size <= 0) frame_size = kDefaultAudioFrameSize;
+  int buffer_size = av_samples_get_buffer_size(nullptr,
+                                               kAudioChannels,
+                                               frame_size + kAudioPoolSampleMargin,
+                                               AV_SAMPLE_FMT_S16,
+                                               1);
+  buffer_pool_ = base::WrapUnique(new RKAudioBufferPool());
+  if (buffer_size > 0) {
+    buffer_pool_->Init(buffer_size, output_queue_->max_size() + kAudioPoolExtraBuffers);
+  }
   return true;
 }
 
 void AudioDecoderThread::UnInitDecoder() {
   output_queue_->flush();
+  buffer_pool_.reset();
   resampler_.reset();
   bitstream_converter_.reset();
   decoder_.reset();
@@ -85,9 +112,10 @@ void AudioDecoderThread::DecodeLoop() {
         if (decoder_) {
           decoder_->Flush();
         }
-        output_queue_->flush();
+        output_queue_->invalidate();
         next_pts_ = 0;
-        player_->OnFlushCompleted(dataset_->getAudioStreamIndex());
+        discard_before_ = input_queue_->flush_target();
+        player_->OnFlushCompleted(dataset_->getAudioStreamIndex(), input_queue_->flush_serial());
         continue;
       }
 
@@ -105,13 +133,18 @@ void AudioDecoderThread::DecodeLoop() {
       } else {
         DLOG(INFO) << "Got audio EOS packet";
         // AAC has no dependent frames so we needn't flush the decoder.
+        av_packet_unref(pkt);
+        av_packet_free(&pkt);
+        OnEndOfStream();
+        continue;
       }
       av_packet_unref(pkt);
       av_packet_free(&pkt);
     } else {
       //应该到文件末尾了,没有数据需要解码,我们要把解码器中的剩余数据读完
       if (!ProcessOutputFrame()) {
-        usleep(5000);
+        //解码器已经没有输出了,阻塞等待新的数据包
+        input_queue_->wait_for_readable(base::TimeDelta::Max());
       }
     }
   }
@@ -174,21 +207,29 @@ void AudioDecoderThread::OnNewFrame(AVFrame *frame) {
   if (!resampler_)
     return;
 
-  uint8_t **output_samples = nullptr;
+  const int max_nb_samples = resampler_->GetOutSamples(frame->nb_samples);
+  int max_buffer_size = av_samples_get_buffer_size(nullptr,
+                                                   kAudioChannels,
+                                                   max_nb_samples,
+                                                   AV_SAMPLE_FMT_S16,
+                                                   1);
+  if (max_nb_samples <= 0 || max_buffer_size <= 0)
+    return;
+
+  //重采样直接写到输出 buffer 中,不再经过中间 buffer 拷贝
+  MEDIA_BUFFER mb = buffer_pool_->Get(max_buffer_size);
+  if (!mb)
+    return;
   const int out_nb_samples = resampler_->Resample((const uint8_t **) frame->extended_data,
                                                   frame->nb_samples,
-                                                  &output_samples);
+                                                  static_cast<uint8_t *>(RK_MPI_MB_GetPtr(mb)),
+                                                  max_nb_samples);
   if (out_nb_samples > 0) {
     int buffer_size = av_samples_get_buffer_size(nullptr,
                                                  kAudioChannels,
                                                  out_nb_samples,
                                                  AV_SAMPLE_FMT_S16,
                                                  1);
-    if (buffer_size <= 0)
-      return;
-
-    MEDIA_BUFFER mb = RK_MPI_MB_CreateAudioBuffer(buffer_size, RK_FALSE);
-    memcpy(RK_MPI_MB_GetPtr(mb), (const uint8_t *) output_samples[0], buffer_size);
     RK_MPI_MB_SetSize(mb, buffer_size);
     //尝试修复 pts 问题
     if (frame->pts == static_cast<int64_t>(AV_NOPTS_VALUE)) {
@@ -200,37 +241,119 @@ void AudioDecoderThread::OnNewFrame(AVFrame *frame) {
                                             dataset_->getAudioStream()->time_base);
     }
     RK_MPI_MB_SetTimestamp(mb, frame->pts);
-    if (!SendFrame(mb)) {
+    if (!TrimBeforeSeekTarget(mb) || !SendFrame(mb)) {
       RK_MPI_MB_ReleaseBuffer(mb);
     }
+  } else {
+    RK_MPI_MB_ReleaseBuffer(mb);
+  }
+}
+
+bool AudioDecoderThread::TrimBeforeSeekTarget(MEDIA_BUFFER mb) {
+  if (discard_before_ == static_cast<int64_t>(AV_NOPTS_VALUE))
+    return true;
+  AVRational time_base = dataset_->getAudioStream()->time_base;
+  int sample_rate = dataset_->getAudioStream()->codecpar->sample_rate;
+  const int bytes_per_sample = kAudioChannels * sizeof(int16_t);
+  if (sample_rate <= 0) {
+    discard_before_ = AV_NOPTS_VALUE;
+    return true;
+  }
+  int64_t pts = static_cast<int64_t>(RK_MPI_MB_GetTimestamp(mb));
+  int64_t start = media::ConvertFromTimeBase(time_base, pts).InMicroseconds();
+  int64_t samples = RK_MPI_MB_GetSize(mb) / bytes_per_sample;
+  int64_t end = start + samples * base::Time::kMicrosecondsPerSecond / sample_rate;
+  if (end <= discard_before_)
+    return false;
+  if (start < discard_before_) {
+    //跨越目标时间的 buffer 去掉前面的样本,时间戳对齐到目标
+    int64_t skip = (discard_before_ - start) * sample_rate / base::Time::kMicrosecondsPerSecond;
+    if (skip > 0 && skip < samples) {
+      uint8_t *data = static_cast<uint8_t *>(RK_MPI_MB_GetPtr(mb));
+      memmove(data, data + skip * bytes_per_sample, (samples - skip) * bytes_per_sample);
+      RK_MPI_MB_SetSize(mb, static_cast<RK_U32>((samples - skip) * bytes_per_sample));
+      pts += media::ConvertToTimeBase(time_base,
+                                      base::TimeDelta::FromMicroseconds(
+                                          skip * base::Time::kMicrosecondsPerSecond / sample_rate));
+      RK_MPI_MB_SetTimestamp(mb, static_cast<RK_U64>(pts));
+    }
   }
+  discard_before_ = AV_NOPTS_VALUE;
+  return true;
 }
 
 /*
  * 这里需要注意,此处可能是阻塞的,如果 render线程没有及时取走解码后的数据
- * 我们需要休眠一会
+ * 我们需要等待队列可写, render 取走数据或者 flush 都会唤醒
  */
 bool AudioDecoderThread::SendFrame(MEDIA_BUFFER mb) {
-  while (keep_running_) {
-    if (!output_queue_->is_writable()) {
-      usleep(5000);
-      continue;
+  if (clip_cache_ && !clip_cache_->AddAudioFrame(mb)) {
+    player_->OnClipCacheDisabled();
+  }
+  if (!keep_running_ || !output_queue_->wait_for_writable(base::TimeDelta::Max()))
+    return false;
+  output_queue_->put(mb);
+  return true;
+}
+
+void AudioDecoderThread::OnEndOfStream() {
+  if (!clip_cache_)
+    return;
+  //最后几帧可能还在解码器中,缓存要完整
+  while (keep_running_ && ProcessOutputFrame()) {
+  }
+  clip_cache_->MarkComplete(DecodedClipCache::kAudio);
+  if (clip_cache_->WaitSealed() && clip_cache_->audio_frame_count() > 0 && buffer_pool_) {
+    ReplayFromCache();
+  }
+}
+
+void AudioDecoderThread::ReplayFromCache() {
+  DLOG(INFO) << "Replay audio from clip cache";
+  //输出队列满时一直阻塞,输入队列有新的包才唤醒,暂停时没有定时唤醒
+  input_queue_->set_observer(this);
+  int64_t offset = 0;
+  bool replaying = true;
+  while (replaying && keep_running_) {
+    offset += clip_cache_->clip_length();
+    for (size_t i = 0; i < clip_cache_->audio_frame_count(); ++i) {
+      //seek 时会收到 flush 包,交给 DecodeLoop 处理
+      if (!WaitForReplayWritable()) {
+        replaying = false;
+        break;
+      }
+      MEDIA_BUFFER mb = clip_cache_->MakeAudioFrame(i, offset, buffer_pool_.get());
+      if (mb) {
+        output_queue_->put(mb);
+      }
     }
-    output_queue_->put(mb);
-    return true;
+  }
+  input_queue_->set_observer(nullptr);
+}
+
+bool AudioDecoderThread::WaitForReplayWritable() {
+  while (keep_running_) {
+    pending_packet_ = input_queue_->get();
+    if (pending_packet_)
+      return false;
+    if (output_queue_->wait_for_writable_or_interrupted())
+      return true;
   }
   return false;
 }
 
+void AudioDecoderThread::OnPacketQueueChanged() {
+  output_queue_->interrupt_writer();
+}
+
 //从文件读取一帧用于解码
 AVPacket *AudioDecoderThread::FetchPacket() {
-  AVPacket *pkt = input_queue_->get();
-  while (!pkt) {
-    DemuxResult result = dataset_->demuxNextPacket();
-    if (result != DemuxResult::OK)
-      break; //AV_EOF or UNKNOWN
-    pkt = input_queue_->get();
-  }
-  return pkt;
+  if (pending_packet_) {
+    AVPacket *pkt = pending_packet_;
+    pending_packet_ = nullptr;
+    return pkt;
+  }
+  //数据由 DemuxThread 写入,这里只负责取
+  return input_queue_->get();
 }
 }
\ No newline at end of file
@@ -6,30 +6,37 @@
 #include "base/threading/simple_thread.h"
 #include "base/synchronization/lock.h"
 #include "media/ffmpeg_common.h"
+#include "media/packet_queue.h"
 #include <rkmedia/rkmedia_api.h>
 
 namespace media {
 class Mp4Dataset;
-class PacketQueue;
+class DecodedClipCache;
 class AudioFrameQueue;
 class FFmpegAudioDecoder;
 class FFmpegAudioResampler;
 class FFmpegAACBitstreamConverter;
+class RKAudioBufferPool;
 class VideoPlayer;
 
 class AudioDecoderThread
-    : public base::DelegateSimpleThread::Delegate {
+    : public base::DelegateSimpleThread::Delegate,
+      public PacketQueue::Observer {
 public:
  explicit AudioDecoderThread(VideoPlayer *player,
                              Mp4Dataset *dataset,
                              PacketQueue *input_queue,
-                             AudioFrameQueue *output_queue);
+                             AudioFrameQueue *output_queue,
+                             DecodedClipCache *clip_cache);
 
  virtual ~AudioDecoderThread() override;
 
 private:
  void Run() override;
 
+ // 重放时由操作输入队列的线程调用,唤醒阻塞在输出队列上的解码线程
+ void OnPacketQueueChanged() override;
+
  void DecodeLoop();
 
  bool InitDecoder();
@@ -42,6 +49,18 @@ private:
 
  bool SendFrame(MEDIA_BUFFER mb);
 
+ // 精确 seek 时去掉目标之前的样本,整个 buffer 都在目标之前时返回 false
+ bool TrimBeforeSeekTarget(MEDIA_BUFFER mb);
+
+ // 读到了 EOS 包,取完解码器中剩余的帧,缓存封存之后从缓存循环重放
+ void OnEndOfStream();
+
+ // 从缓存循环重放,直到收到新的包(flush)或者退出
+ void ReplayFromCache();
+
+ // 输出队列满时等待,期间收到新的包时返回 false
+ bool WaitForReplayWritable();
+
  AVPacket *FetchPacket();
 
  bool ProcessOutputFrame();
@@ -50,11 +69,17 @@ private:
  Mp4Dataset *dataset_;
  PacketQueue *input_queue_;
  AudioFrameQueue *output_queue_;
+ DecodedClipCache *clip_cache_;
+ // 重放时取到的包,下一次 FetchPacket 返回
+ AVPacket *pending_packet_;
  int64_t next_pts_;
+ // 精确 seek 的目标时间(微秒),AV_NOPTS_VALUE 表示不丢
+ int64_t discard_before_;
  bool keep_running_;
  std::unique_ptr<FFmpegAudioDecoder> decoder_;
  std::unique_ptr<FFmpegAudioResampler> resampler_;
  std::unique_ptr<FFmpegAACBitstreamConverter> bitstream_converter_;
+ std::unique_ptr<RKAudioBufferPool> buffer_pool_;
  std::unique_ptr<base::DelegateSimpleThread> thread_;
  DISALLOW_COPY_AND_ASSIGN(AudioDecoderThread);
 };
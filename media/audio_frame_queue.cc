@@ -3,64 +3,99 @@
 #include "base/logging.h"
 
 namespace media {
+namespace {
+void ReleaseBuffer(MEDIA_BUFFER mb) {
+  RK_MPI_MB_ReleaseBuffer(mb);
+}
+
+size_t BufferBytes(MEDIA_BUFFER mb) {
+  return RK_MPI_MB_GetSize(mb);
+}
+}
 
 AudioFrameQueue::AudioFrameQueue(AVStream *stream, size_t max_size)
     : stream_(stream),
-      max_size_(max_size) {}
+      max_size_(max_size),
+      ring_(max_size > 0 ? max_size : 1, ReleaseBuffer, BufferBytes) {}
+
+AudioFrameQueue::~AudioFrameQueue() {}
+
+bool AudioFrameQueue::wait_for_writable(const base::TimeDelta &timeout) {
+  return ring_.wait_for_writable(timeout);
+}
 
-AudioFrameQueue::~AudioFrameQueue() {
-  flush();
+bool AudioFrameQueue::wait_for_writable_or_interrupted() {
+  return ring_.wait_for_writable_or_interrupted();
+}
+
+void AudioFrameQueue::put(MEDIA_BUFFER mb) {
+  ring_.Push(mb, false);
+}
+
+void AudioFrameQueue::invalidate() {
+  ring_.Invalidate();
 }
 
 bool AudioFrameQueue::is_writable() {
-  base::AutoLock l(lock_);
-  return frame_list_.size() < max_size_;
+  ring_.Front(nullptr);
+  return ring_.size() < ring_.capacity();
 }
 
-int64_t AudioFrameQueue::startTimestamp() {
-  base::AutoLock l(lock_);
-  if (frame_list_.empty())
-    return AV_NOPTS_VALUE;
-  MEDIA_BUFFER mb = frame_list_.front();
-  return static_cast<int64_t>(RK_MPI_MB_GetTimestamp(mb));
+bool AudioFrameQueue::wait_for_readable(const base::TimeDelta &timeout) {
+  return ring_.wait_for_readable(timeout);
 }
 
-void AudioFrameQueue::put(MEDIA_BUFFER mb) {
-  base::AutoLock l(lock_);
-  frame_list_.push(mb);
+int64_t AudioFrameQueue::startTimestamp() {
+  MEDIA_BUFFER *mb = ring_.Front(nullptr);
+  if (!mb)
+    return AV_NOPTS_VALUE;
+  return static_cast<int64_t>(RK_MPI_MB_GetTimestamp(*mb));
 }
 
 MEDIA_BUFFER AudioFrameQueue::get(int64_t render_time) {
-  base::AutoLock l(lock_);
-  if (frame_list_.empty())
+  MEDIA_BUFFER *mb = ring_.Front(nullptr);
+  if (!mb)
     return nullptr;
 
-  MEDIA_BUFFER mb = frame_list_.front();
-  auto pts = static_cast<int64_t>(RK_MPI_MB_GetTimestamp(mb));
+  auto pts = static_cast<int64_t>(RK_MPI_MB_GetTimestamp(*mb));
   base::TimeDelta timestamp = media::ConvertFromTimeBase(stream_->time_base, pts);
   if (timestamp.InMicroseconds() <= render_time) {
-    frame_list_.pop();
-    DLOG(INFO) << "AudioFrameQueue size: " << frame_list_.size();
-    return mb;
+    DLOG(INFO) << "AudioFrameQueue size: " << ring_.size() - 1;
+    return ring_.Pop();
   }
   return nullptr;
 }
 
 void AudioFrameQueue::flush() {
-  base::AutoLock l(lock_);
-  while (!frame_list_.empty()) {
-    MEDIA_BUFFER mb = frame_list_.front();
-    frame_list_.pop();
-    RK_MPI_MB_ReleaseBuffer(mb);
-  }
+  ring_.Clear();
 }
 
 size_t AudioFrameQueue::size() {
-  base::AutoLock l(lock_);
-  return frame_list_.size();
+  ring_.Front(nullptr);
+  return ring_.size();
+}
+
+void AudioFrameQueue::shutdown() {
+  ring_.shutdown();
+}
+
+void AudioFrameQueue::interrupt_writer() {
+  ring_.InterruptWriter();
+}
+
+uint64_t AudioFrameQueue::wakeups() {
+  return ring_.wakeups();
 }
 
 size_t AudioFrameQueue::max_size() const {
   return max_size_;
 }
+
+size_t AudioFrameQueue::bytes() {
+  return ring_.bytes();
+}
+
+size_t AudioFrameQueue::peak_bytes() {
+  return ring_.peak_bytes();
+}
 }
@@ -1,40 +1,76 @@
 #ifndef MEDIA_AUDIO_FRAME_QUEUE_H_
 #define MEDIA_AUDIO_FRAME_QUEUE_H_
 
-#include <queue>
 #include "base/macros.h"
-#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "media/frame_ring.h"
 #include <rkmedia/rkmedia_api.h>
 
 struct AVStream;
 
 namespace media {
 
+/*
+ * 音频帧已经是播放顺序,直接放入无锁的 FrameRing
+ * 解码线程写,render 线程读
+ */
 class AudioFrameQueue {
 public:
  explicit AudioFrameQueue(AVStream *stream, size_t max_size);
 
  virtual ~AudioFrameQueue();
 
- bool is_writable();
+ // 以下只能在解码线程调用
+ // 解码线程等待队列可写,get/flush 会唤醒它
+ // 返回 false 表示超时或者已经 shutdown,timeout 为 base::TimeDelta::Max() 时一直等待
+ bool wait_for_writable(const base::TimeDelta &timeout);
 
- int64_t startTimestamp();
+ // 和 wait_for_writable 一样一直等待,interrupt_writer 也会让它返回 false
+ bool wait_for_writable_or_interrupted();
 
+ // 调用之前 wait_for_writable 返回 true
  void put(MEDIA_BUFFER mb);
 
+ // 解码线程收到 flush 包: 队列中已有的帧作废,由 render 线程取到时释放
+ void invalidate();
+
+ // 以下只能在 render 线程调用
+ bool is_writable();
+
+ // 等待队列中有数据
+ bool wait_for_readable(const base::TimeDelta &timeout);
+
+ int64_t startTimestamp();
+
  MEDIA_BUFFER get(int64_t render_time);
 
+ // 释放所有的帧
+ // 解码线程退出时也会调用,这时 render 线程阻塞在等待解码线程结束上
  void flush();
 
  size_t size();
 
+ // 以下可以在任意线程调用
+ // 唤醒所有等待的线程,之后的等待都立即返回 false
+ void shutdown();
+
+ // 唤醒阻塞在 wait_for_writable_or_interrupted 上的解码线程,没有在等待时下一次等待立即返回
+ void interrupt_writer();
+
+ // 等待线程被唤醒的次数
+ uint64_t wakeups();
+
  size_t max_size() const;
 
+ // 队列中 PCM 数据的字节数,以及曾经的最大值
+ size_t bytes();
+
+ size_t peak_bytes();
+
 private:
  AVStream *stream_;
  size_t max_size_;
- std::queue<MEDIA_BUFFER> frame_list_;
- base::Lock lock_;
+ FrameRing<MEDIA_BUFFER> ring_;
  DISALLOW_COPY_AND_ASSIGN(AudioFrameQueue);
 };
 }
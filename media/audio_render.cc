@@ -60,4 +60,17 @@ int RKAudioRender::SendInput(MEDIA_BUFFER mb) const {
   return RK_MPI_SYS_SendMediaBuffer(RK_ID_AO, AO_CHANNEL_ID, mb);
 }
 
+int RKAudioRender::QueuedBuffers() const {
+  if (!initialize_)
+    return -1;
+  AO_CHN_STATE_S state;
+  memset(&state, 0, sizeof(AO_CHN_STATE_S));
+  int ret = RK_MPI_AO_QueryChnStat(AO_CHANNEL_ID, &state);
+  if (ret) {
+    DLOG(ERROR) << "RK_MPI_AO_QueryChnStat failed:" << ret;
+    return -1;
+  }
+  return static_cast<int>(state.u32BusyNum);
+}
+
 }
\ No newline at end of file
@@ -21,6 +21,9 @@ public:
  bool SetVolume(int volume) const;
 
  int SendInput(MEDIA_BUFFER mb) const;
+
+ // AO 中已经送入还没有播放完的 buffer 数(包括正在播放的),失败返回 -1
+ int QueuedBuffers() const;
 private:
  bool initialize_;
  DISALLOW_COPY_AND_ASSIGN(RKAudioRender);
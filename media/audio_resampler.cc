@@ -4,9 +4,7 @@
 namespace media {
 
 FFmpegAudioResampler::FFmpegAudioResampler()
-    : max_dst_nb_samples_(0),
-      converted_input_samples_(nullptr),
-      in_sample_rate_(0),
+    : in_sample_rate_(0),
       in_channels_(0),
       out_sample_rate_(0),
       out_channels_(0),
@@ -17,21 +15,12 @@ FFmpegAudioResampler::~FFmpegAudioResampler() {
 }
 
 void FFmpegAudioResampler::UnInit() {
-  ReleaseBuffer();
   if (resampler_context_) {
     swr_free(&resampler_context_);
     resampler_context_ = nullptr;
   }
 }
 
-void FFmpegAudioResampler::ReleaseBuffer() {
-  if (converted_input_samples_) {
-    av_freep(&converted_input_samples_[0]);
-    av_freep(&converted_input_samples_);
-    converted_input_samples_ = nullptr;
-  }
-}
-
 bool FFmpegAudioResampler::Init(AVCodecContext *codec_context,
                                 int out_sample_rate,
                                 int out_channels) {
@@ -69,61 +58,33 @@ bool FFmpegAudioResampler::Init(AVCodecContext *codec_context,
     UnInit();
     return false;
   }
-
-  err = av_samples_alloc_array_and_samples(&converted_input_samples_,
-                                           nullptr,
-                                           out_channels_,
-                                           8192,
-                                           AV_SAMPLE_FMT_S16,
-                                           1);
-  if (err < 0) {
-    LOG(ERROR) << "av_samples_alloc_array_and_samples failed:" << err << ",err:" << AVErrorToString(err);
-    UnInit();
-    return false;
-  }
-  max_dst_nb_samples_ = 8192;
-
   return true;
 }
 
-int FFmpegAudioResampler::Resample(const uint8_t **data,
-                                   int src_nb_samples,
-                                   uint8_t ***output_samples) {
+int FFmpegAudioResampler::GetOutSamples(int src_nb_samples) {
   if (!resampler_context_)
     return -1;
   /* compute destination number of samples */
-  int64_t dst_nb_samples = av_rescale_rnd(swr_get_delay(resampler_context_, in_sample_rate_) + src_nb_samples,
-                                          out_sample_rate_,
-                                          in_sample_rate_,
-                                          AV_ROUND_UP);
-  if (dst_nb_samples <= 0)
-    return -1;
-
-  if (dst_nb_samples > max_dst_nb_samples_) {
-    ReleaseBuffer();
-    if (av_samples_alloc_array_and_samples(&converted_input_samples_,
-                                           nullptr,
-                                           out_channels_,
-                                           (int) dst_nb_samples,
-                                           AV_SAMPLE_FMT_S16,
-                                           1) < 0) {
-      return AVERROR(ENOMEM);
-    }
-    max_dst_nb_samples_ = dst_nb_samples;
-  }
+  return static_cast<int>(av_rescale_rnd(swr_get_delay(resampler_context_, in_sample_rate_) + src_nb_samples,
+                                         out_sample_rate_,
+                                         in_sample_rate_,
+                                         AV_ROUND_UP));
+}
 
-  /* convert to destination format */
-  int err = swr_convert(resampler_context_,
-                        converted_input_samples_,
-                        (int) dst_nb_samples,
-                        data,
-                        src_nb_samples);
+int FFmpegAudioResampler::Resample(const uint8_t **data,
+                                   int src_nb_samples,
+                                   uint8_t *output,
+                                   int max_out_samples) {
+  if (!resampler_context_ || max_out_samples <= 0)
+    return -1;
 
-  if (err < 0) {
-    return err;
-  }
-  *output_samples = converted_input_samples_;
-  return err;
+  /* convert to destination format, S16 is packed so there is only one plane */
+  uint8_t *out_planes[1] = {output};
+  return swr_convert(resampler_context_,
+                     out_planes,
+                     max_out_samples,
+                     data,
+                     src_nb_samples);
 }
 
 }
\ No newline at end of file
@@ -17,14 +17,17 @@ public:
 
  void UnInit();
 
+ // 转换 src_nb_samples 个输入样本最多会输出的样本数(每通道)
+ int GetOutSamples(int src_nb_samples);
+
+ // 输出为交织的 S16,直接写入 output,最多写 max_out_samples 个样本(每通道)
+ // 返回实际输出的样本数(每通道),出错时返回负数
  int Resample(const uint8_t **data,
               int src_nb_samples,
-              uint8_t ***output_samples);
+              uint8_t *output,
+              int max_out_samples);
 
 private:
- void ReleaseBuffer();
- int64_t max_dst_nb_samples_;
- uint8_t **converted_input_samples_;
  int in_sample_rate_;
  int in_channels_;
  int out_sample_rate_;
@@ -0,0 +1,254 @@
+#include "media/audio_time_stretcher.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define STRETCH_USE_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define STRETCH_USE_SSE 1
+#endif
+#include "base/logging.h"
+#include "base/time/time.h"
+
+namespace media {
+namespace {
+//每一段的长度,相邻两段交叉淡化的长度,以及搜索最相似位置的窗口(毫秒)
+const int kSequenceMs = 40;
+const int kOverlapMs = 8;
+const int kSeekWindowMs = 15;
+
+//先按这个步长粗搜,再在最好的位置附近逐个样本细搜
+const int kCoarseSeekStep = 4;
+
+//已经处理过的输入超过这么多样本时才挪动 buffer
+const size_t kCompactFrames = 8192;
+
+//a 和 b 的互相关,以及 b 的能量
+void CrossCorrelate(const float *a, const float *b, int n, float *corr, float *energy) {
+  int i = 0;
+  float c = 0;
+  float e = 0;
+#if defined(STRETCH_USE_NEON)
+  float32x4_t vc = vdupq_n_f32(0);
+  float32x4_t ve = vdupq_n_f32(0);
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t va = vld1q_f32(a + i);
+    float32x4_t vb = vld1q_f32(b + i);
+    vc = vmlaq_f32(vc, va, vb);
+    ve = vmlaq_f32(ve, vb, vb);
+  }
+  float32x2_t c2 = vadd_f32(vget_low_f32(vc), vget_high_f32(vc));
+  float32x2_t e2 = vadd_f32(vget_low_f32(ve), vget_high_f32(ve));
+  c = vget_lane_f32(vpadd_f32(c2, c2), 0);
+  e = vget_lane_f32(vpadd_f32(e2, e2), 0);
+#elif defined(STRETCH_USE_SSE)
+  __m128 vc = _mm_setzero_ps();
+  __m128 ve = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    __m128 va = _mm_loadu_ps(a + i);
+    __m128 vb = _mm_loadu_ps(b + i);
+    vc = _mm_add_ps(vc, _mm_mul_ps(va, vb));
+    ve = _mm_add_ps(ve, _mm_mul_ps(vb, vb));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, vc);
+  c = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_ps(lanes, ve);
+  e = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+  for (; i < n; ++i) {
+    c += a[i] * b[i];
+    e += b[i] * b[i];
+  }
+  *corr = c;
+  *energy = e;
+}
+
+int16_t ClampSample(float value) {
+  if (value > 32767.f)
+    return 32767;
+  if (value < -32768.f)
+    return -32768;
+  return static_cast<int16_t>(lrintf(value));
+}
+}
+
+AudioTimeStretcher::AudioTimeStretcher()
+    : sample_rate_(0),
+      channels_(0),
+      sequence_frames_(0),
+      overlap_frames_(0),
+      seek_frames_(0),
+      rate_(1.0),
+      input_pos_(0),
+      input_discarded_(0),
+      input_start_time_(0),
+      input_started_(false),
+      has_overlap_(false),
+      output_read_(0),
+      output_time_(0) {}
+
+AudioTimeStretcher::~AudioTimeStretcher() {}
+
+bool AudioTimeStretcher::Init(int sample_rate, int channels) {
+  if (sample_rate <= 0 || channels <= 0) {
+    LOG(ERROR) << "Invalid audio format, sample rate:" << sample_rate << ",channels:" << channels;
+    return false;
+  }
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  sequence_frames_ = sample_rate * kSequenceMs / 1000;
+  overlap_frames_ = sample_rate * kOverlapMs / 1000;
+  seek_frames_ = sample_rate * kSeekWindowMs / 1000;
+  fade_in_.resize(overlap_frames_);
+  for (int i = 0; i < overlap_frames_; ++i) {
+    fade_in_[i] = (i + 0.5f) / overlap_frames_;
+  }
+  overlap_.resize(overlap_frames_ * channels_);
+  overlap_mono_.resize(overlap_frames_);
+  Reset();
+  return true;
+}
+
+void AudioTimeStretcher::SetRate(double rate) {
+  rate_ = rate;
+}
+
+void AudioTimeStretcher::Reset() {
+  input_.clear();
+  input_mono_.clear();
+  input_pos_ = 0;
+  input_discarded_ = 0;
+  input_start_time_ = 0;
+  input_started_ = false;
+  has_overlap_ = false;
+  output_.clear();
+  output_read_ = 0;
+  output_time_ = 0;
+}
+
+void AudioTimeStretcher::Push(const int16_t *data, int frames, int64_t timestamp) {
+  if (sample_rate_ <= 0 || frames <= 0)
+    return;
+  if (!input_started_) {
+    input_start_time_ = timestamp;
+    input_started_ = true;
+  }
+  input_.insert(input_.end(), data, data + frames * channels_);
+  size_t mono_start = input_mono_.size();
+  input_mono_.resize(mono_start + frames);
+  const float scale = 1.f / channels_;
+  for (int i = 0; i < frames; ++i) {
+    int sum = 0;
+    for (int c = 0; c < channels_; ++c) {
+      sum += data[i * channels_ + c];
+    }
+    input_mono_[mono_start + i] = sum * scale;
+  }
+  while (ProcessSequence()) {
+  }
+  Compact();
+}
+
+int AudioTimeStretcher::available() const {
+  if (channels_ <= 0)
+    return 0;
+  return static_cast<int>(output_.size() / channels_ - output_read_);
+}
+
+int AudioTimeStretcher::Pull(int16_t *output, int max_frames, int64_t *timestamp) {
+  int frames = std::min(available(), max_frames);
+  if (frames <= 0)
+    return 0;
+  memcpy(output, &output_[output_read_ * channels_], frames * channels_ * sizeof(int16_t));
+  if (timestamp)
+    *timestamp = output_time_;
+  output_read_ += frames;
+  //输出的一个样本对应 rate 个输入样本
+  output_time_ += static_cast<int64_t>(frames * rate_ * base::Time::kMicrosecondsPerSecond / sample_rate_);
+  if (output_read_ * channels_ == output_.size()) {
+    output_.clear();
+    output_read_ = 0;
+  }
+  return frames;
+}
+
+bool AudioTimeStretcher::ProcessSequence() {
+  size_t pos = static_cast<size_t>(input_pos_);
+  if (pos + seek_frames_ + sequence_frames_ > input_mono_.size())
+    return false;
+  int offset = has_overlap_ ? FindBestOffset(&input_mono_[pos]) : 0;
+  size_t start = pos + offset;
+
+  if (output_read_ * channels_ == output_.size()) {
+    int64_t frames = input_discarded_ + static_cast<int64_t>(start);
+    output_time_ = input_start_time_ + frames * base::Time::kMicrosecondsPerSecond / sample_rate_;
+  }
+  const int16_t *src = &input_[start * channels_];
+  size_t copy_from = 0;
+  if (has_overlap_) {
+    //上一段的末尾淡出,这一段的开头淡入
+    size_t out = output_.size();
+    output_.resize(out + overlap_frames_ * channels_);
+    for (int i = 0; i < overlap_frames_; ++i) {
+      float w = fade_in_[i];
+      for (int c = 0; c < channels_; ++c) {
+        int k = i * channels_ + c;
+        output_[out + k] = ClampSample(overlap_[k] * (1.f - w) + src[k] * w);
+      }
+    }
+    copy_from = overlap_frames_;
+  }
+  size_t copy_to = sequence_frames_ - overlap_frames_;
+  output_.insert(output_.end(), src + copy_from * channels_, src + copy_to * channels_);
+
+  //这一段的末尾留给下一段交叉淡化
+  memcpy(&overlap_[0], src + copy_to * channels_, overlap_frames_ * channels_ * sizeof(int16_t));
+  memcpy(&overlap_mono_[0], &input_mono_[start + copy_to], overlap_frames_ * sizeof(float));
+  has_overlap_ = true;
+
+  input_pos_ += (sequence_frames_ - overlap_frames_) * rate_;
+  return true;
+}
+
+int AudioTimeStretcher::FindBestOffset(const float *candidates) {
+  int best = 0;
+  float best_score = -1e30f;
+  float corr;
+  float energy;
+  for (int k = 0; k < seek_frames_; k += kCoarseSeekStep) {
+    CrossCorrelate(&overlap_mono_[0], candidates + k, overlap_frames_, &corr, &energy);
+    float score = corr / sqrtf(energy + 1.f);
+    if (score > best_score) {
+      best_score = score;
+      best = k;
+    }
+  }
+  int coarse = best;
+  int begin = std::max(coarse - kCoarseSeekStep + 1, 0);
+  int end = std::min(coarse + kCoarseSeekStep, seek_frames_);
+  for (int k = begin; k < end; ++k) {
+    if (k == coarse)
+      continue;
+    CrossCorrelate(&overlap_mono_[0], candidates + k, overlap_frames_, &corr, &energy);
+    float score = corr / sqrtf(energy + 1.f);
+    if (score > best_score) {
+      best_score = score;
+      best = k;
+    }
+  }
+  return best;
+}
+
+void AudioTimeStretcher::Compact() {
+  size_t consumed = std::min(static_cast<size_t>(input_pos_), input_mono_.size());
+  if (consumed < kCompactFrames)
+    return;
+  input_.erase(input_.begin(), input_.begin() + consumed * channels_);
+  input_mono_.erase(input_mono_.begin(), input_mono_.begin() + consumed);
+  input_pos_ -= consumed;
+  input_discarded_ += consumed;
+}
+}
@@ -0,0 +1,83 @@
+#ifndef MEDIA_AUDIO_TIME_STRETCHER_H_
+#define MEDIA_AUDIO_TIME_STRETCHER_H_
+
+#include <stdint.h>
+#include <vector>
+#include "base/macros.h"
+
+namespace media {
+
+/*
+ * WSOLA 变速不变调,输入输出都是交织的 S16
+ * 输入按固定长度分段,相邻两段交叉淡化后输出,每段在输入中前进 (段长 - 交叉长度) * rate,
+ * 输出前进 (段长 - 交叉长度),所以输出时长是输入的 1/rate
+ * 每段的起点在名义位置之后的一个窗口内搜索,取与上一段末尾最相似(归一化互相关最大)的位置,避免相位不连续
+ * 互相关在单声道的 float 副本上计算,NEON/SSE 各算 4 个样本
+ * 只能在一个线程中使用
+ */
+class AudioTimeStretcher {
+public:
+ AudioTimeStretcher();
+
+ ~AudioTimeStretcher();
+
+ bool Init(int sample_rate, int channels);
+
+ // 改变速度不清空已经缓冲的样本,从下一段开始生效
+ void SetRate(double rate);
+
+ double rate() const { return rate_; }
+
+ // seek 之后丢掉所有缓冲的样本
+ void Reset();
+
+ // frames 为每通道的样本数,timestamp 是第一个样本的时间(微秒)
+ // Reset 之后第一次输入的时间作为起点,之后的输入认为是连续的
+ void Push(const int16_t *data, int frames, int64_t timestamp);
+
+ // 已经处理好,可以取出的样本数(每通道)
+ int available() const;
+
+ // 取出最多 max_frames 个样本,返回实际取出的样本数
+ // timestamp 为第一个样本对应的输入时间(微秒)
+ int Pull(int16_t *output, int max_frames, int64_t *timestamp);
+
+private:
+ // 输入足够时处理一段,返回 false 表示需要更多输入
+ bool ProcessSequence();
+
+ // 在 candidates 开始的搜索窗口中找与上一段末尾最相似的位置
+ int FindBestOffset(const float *candidates);
+
+ // 丢掉已经处理过的输入
+ void Compact();
+
+ int sample_rate_;
+ int channels_;
+ int sequence_frames_;
+ int overlap_frames_;
+ int seek_frames_;
+ double rate_;
+ // 交织的输入,以及每个样本各通道的平均值
+ std::vector<int16_t> input_;
+ std::vector<float> input_mono_;
+ // 下一段在 input_ 中的名义起点
+ double input_pos_;
+ // input_ 之前已经丢掉的样本数,以及 Reset 之后第一个输入样本的时间
+ int64_t input_discarded_;
+ int64_t input_start_time_;
+ bool input_started_;
+ // 上一段末尾,和下一段的开头交叉淡化
+ std::vector<int16_t> overlap_;
+ std::vector<float> overlap_mono_;
+ bool has_overlap_;
+ // 交叉淡化的权重
+ std::vector<float> fade_in_;
+ std::vector<int16_t> output_;
+ size_t output_read_;
+ int64_t output_time_;
+ DISALLOW_COPY_AND_ASSIGN(AudioTimeStretcher);
+};
+}
+
+#endif //MEDIA_AUDIO_TIME_STRETCHER_H_
@@ -0,0 +1,249 @@
+#include "media/decoded_clip_cache.h"
+#include <string.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "media/audio_buffer_pool.h"
+#include "media/media_constants.h"
+
+namespace media {
+
+DecodedClipCache::DecodedClipCache(size_t budget_bytes,
+                                   int streams,
+                                   AVRational audio_time_base,
+                                   int audio_sample_rate)
+    : budget_bytes_(budget_bytes),
+      streams_(streams),
+      completed_streams_(0),
+      audio_time_base_(audio_time_base),
+      audio_sample_rate_(audio_sample_rate),
+      state_(State::kFilling),
+      aborted_(false),
+      bytes_(0),
+      hits_(0),
+      replays_(0),
+      clip_length_(0),
+      frame_group_(nullptr),
+      sealed_cond_(&lock_) {}
+
+DecodedClipCache::~DecodedClipCache() {
+  base::AutoLock l(lock_);
+  Release();
+}
+
+bool DecodedClipCache::Init() {
+  //和软解一样,优先用 ION,重放的帧可以直接交给 RGA
+  MPP_RET ret = mpp_buffer_group_get_internal(&frame_group_, MPP_BUFFER_TYPE_ION);
+  if (ret != MPP_OK) {
+    ret = mpp_buffer_group_get_internal(&frame_group_, MPP_BUFFER_TYPE_NORMAL);
+  }
+  if (ret != MPP_OK) {
+    LOG(ERROR) << "mpp_buffer_group_get_internal failed: " << ret;
+    frame_group_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool DecodedClipCache::AddVideoFrame(MppFrame frame) {
+  base::AutoLock l(lock_);
+  if (state_ != State::kFilling)
+    return true;
+  MppBuffer src = mpp_frame_get_buffer(frame);
+  if (!src) {
+    return true;
+  }
+  size_t size = mpp_buffer_get_size(src);
+  if (bytes_ + size > budget_bytes_) {
+    LOG(WARNING) << "Clip cache exceeds budget: " << budget_bytes_;
+    state_ = State::kDisabled;
+    Release();
+    sealed_cond_.Broadcast();
+    return false;
+  }
+  VideoEntry entry;
+  entry.buffer = nullptr;
+  MPP_RET ret = mpp_buffer_get(frame_group_, &entry.buffer, size);
+  if (ret != MPP_OK || !entry.buffer) {
+    LOG(ERROR) << "mpp_buffer_get failed: " << ret << ",size: " << size;
+    state_ = State::kDisabled;
+    Release();
+    sealed_cond_.Broadcast();
+    return false;
+  }
+  memcpy(mpp_buffer_get_ptr(entry.buffer), mpp_buffer_get_ptr(src), size);
+  entry.width = mpp_frame_get_width(frame);
+  entry.height = mpp_frame_get_height(frame);
+  entry.hor_stride = mpp_frame_get_hor_stride(frame);
+  entry.ver_stride = mpp_frame_get_ver_stride(frame);
+  entry.fmt = mpp_frame_get_fmt(frame);
+  entry.pts = mpp_frame_get_pts(frame);
+  video_frames_.push_back(entry);
+  bytes_ += size;
+  return true;
+}
+
+bool DecodedClipCache::AddAudioFrame(MEDIA_BUFFER mb) {
+  base::AutoLock l(lock_);
+  if (state_ != State::kFilling)
+    return true;
+  size_t size = RK_MPI_MB_GetSize(mb);
+  if (bytes_ + size > budget_bytes_) {
+    LOG(WARNING) << "Clip cache exceeds budget: " << budget_bytes_;
+    state_ = State::kDisabled;
+    Release();
+    sealed_cond_.Broadcast();
+    return false;
+  }
+  auto data = static_cast<const uint8_t *>(RK_MPI_MB_GetPtr(mb));
+  AudioEntry entry;
+  entry.pcm.assign(data, data + size);
+  entry.pts = static_cast<int64_t>(RK_MPI_MB_GetTimestamp(mb));
+  audio_frames_.push_back(std::move(entry));
+  bytes_ += size;
+  return true;
+}
+
+void DecodedClipCache::MarkComplete(int stream) {
+  base::AutoLock l(lock_);
+  if (state_ != State::kFilling)
+    return;
+  completed_streams_ |= stream;
+  if ((completed_streams_ & streams_) == streams_) {
+    Seal();
+  }
+}
+
+bool DecodedClipCache::WaitSealed() {
+  base::AutoLock l(lock_);
+  while (!aborted_ && state_ == State::kFilling) {
+    sealed_cond_.Wait();
+  }
+  return !aborted_ && state_ == State::kSealed;
+}
+
+void DecodedClipCache::Disable() {
+  base::AutoLock l(lock_);
+  if (state_ != State::kFilling)
+    return;
+  state_ = State::kDisabled;
+  Release();
+  sealed_cond_.Broadcast();
+}
+
+void DecodedClipCache::Abort() {
+  base::AutoLock l(lock_);
+  aborted_ = true;
+  sealed_cond_.Broadcast();
+}
+
+bool DecodedClipCache::filling() {
+  base::AutoLock l(lock_);
+  return state_ == State::kFilling;
+}
+
+bool DecodedClipCache::sealed() {
+  base::AutoLock l(lock_);
+  return state_ == State::kSealed;
+}
+
+MppFrame DecodedClipCache::MakeVideoFrame(size_t i, int64_t offset) {
+  const VideoEntry &entry = video_frames_[i];
+  MppFrame frame = nullptr;
+  mpp_frame_init(&frame);
+  mpp_frame_set_width(frame, entry.width);
+  mpp_frame_set_height(frame, entry.height);
+  mpp_frame_set_hor_stride(frame, entry.hor_stride);
+  mpp_frame_set_ver_stride(frame, entry.ver_stride);
+  mpp_frame_set_fmt(frame, entry.fmt);
+  mpp_frame_set_pts(frame, entry.pts + offset);
+  //MppFrame 持有 buffer 的引用,缓存中的 buffer 可以同时被多个帧引用
+  mpp_frame_set_buffer(frame, entry.buffer);
+  base::AutoLock l(lock_);
+  ++hits_;
+  if (i == 0)
+    ++replays_;
+  return frame;
+}
+
+MEDIA_BUFFER DecodedClipCache::MakeAudioFrame(size_t i, int64_t offset, RKAudioBufferPool *pool) {
+  const AudioEntry &entry = audio_frames_[i];
+  MEDIA_BUFFER mb = pool->Get(entry.pcm.size());
+  if (!mb)
+    return nullptr;
+  memcpy(RK_MPI_MB_GetPtr(mb), entry.pcm.data(), entry.pcm.size());
+  RK_MPI_MB_SetSize(mb, static_cast<RK_U32>(entry.pcm.size()));
+  int64_t pts = entry.pts + ConvertToTimeBase(audio_time_base_, base::TimeDelta::FromMicroseconds(offset));
+  RK_MPI_MB_SetTimestamp(mb, static_cast<RK_U64>(pts));
+  base::AutoLock l(lock_);
+  ++hits_;
+  return mb;
+}
+
+size_t DecodedClipCache::bytes() {
+  base::AutoLock l(lock_);
+  return bytes_;
+}
+
+uint64_t DecodedClipCache::hits() {
+  base::AutoLock l(lock_);
+  return hits_;
+}
+
+uint64_t DecodedClipCache::replays() {
+  base::AutoLock l(lock_);
+  return replays_;
+}
+
+void DecodedClipCache::Release() {
+  for (auto &entry : video_frames_) {
+    mpp_buffer_put(entry.buffer);
+  }
+  video_frames_.clear();
+  audio_frames_.clear();
+  audio_frames_.shrink_to_fit();
+  bytes_ = 0;
+  if (frame_group_) {
+    mpp_buffer_group_put(frame_group_);
+    frame_group_ = nullptr;
+  }
+}
+
+void DecodedClipCache::Seal() {
+  int64_t start = INT64_MAX;
+  int64_t end = INT64_MIN;
+  if (!video_frames_.empty()) {
+    int64_t first = INT64_MAX;
+    int64_t last = INT64_MIN;
+    for (const VideoEntry &entry : video_frames_) {
+      first = std::min(first, entry.pts);
+      last = std::max(last, entry.pts);
+    }
+    //最后一帧的时长按平均帧间隔计算
+    int64_t duration = video_frames_.size() > 1
+                       ? (last - first) / static_cast<int64_t>(video_frames_.size() - 1)
+                       : 0;
+    start = std::min(start, first);
+    end = std::max(end, last + duration);
+  }
+  if (!audio_frames_.empty() && audio_sample_rate_ > 0) {
+    for (const AudioEntry &entry : audio_frames_) {
+      int64_t pts = ConvertFromTimeBase(audio_time_base_, entry.pts).InMicroseconds();
+      int64_t samples = entry.pcm.size() / (kAudioChannels * sizeof(int16_t));
+      start = std::min(start, pts);
+      end = std::max(end, pts + samples * base::Time::kMicrosecondsPerSecond / audio_sample_rate_);
+    }
+  }
+  if (end <= start) {
+    LOG(WARNING) << "Clip cache is empty";
+    state_ = State::kDisabled;
+    Release();
+  } else {
+    clip_length_ = end - start;
+    state_ = State::kSealed;
+    LOG(INFO) << "Clip cache sealed, video frames: " << video_frames_.size()
+              << ", audio frames: " << audio_frames_.size()
+              << ", bytes: " << bytes_ << ", length(us): " << clip_length_;
+  }
+  sealed_cond_.Broadcast();
+}
+}
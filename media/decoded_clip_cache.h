@@ -0,0 +1,134 @@
+#ifndef MEDIA_DECODED_CLIP_CACHE_H_
+#define MEDIA_DECODED_CLIP_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/condition_variable.h"
+#include "media/ffmpeg_common.h"
+#include <rkmedia/rkmedia_api.h>
+#include <rockchip/mpp_buffer.h>
+#include <rockchip/mpp_frame.h>
+
+namespace media {
+class RKAudioBufferPool;
+
+/*
+ * 短片循环播放时,缓存第一遍解码出来的整段视频帧和重采样后的 PCM
+ * 之后的每一遍由解码线程直接从内存重放,时间戳加上 clip 时长,MPP 和重采样都不再工作
+ * 1. 填充: 解码线程把送出的每一帧拷贝一份(视频帧拷贝到自己的 MPP buffer,不占解码器的 buffer)
+ * 2. 所有 stream 都解码到文件末尾之后封存(sealed),之后只读
+ * 3. 超出内存预算,或者填充过程中 seek,就放弃缓存(disabled),退回到普通的循环播放
+ * 视频帧的时间戳单位为微秒,音频帧为 stream time base
+ */
+class DecodedClipCache {
+public:
+ enum StreamFlags {
+   kVideo = 1,
+   kAudio = 2,
+ };
+
+ // streams: 需要缓存的 stream(StreamFlags 的组合)
+ explicit DecodedClipCache(size_t budget_bytes,
+                           int streams,
+                           AVRational audio_time_base,
+                           int audio_sample_rate);
+
+ ~DecodedClipCache();
+
+ bool Init();
+
+ // 拷贝一帧,只在填充状态下生效
+ // 这一帧超出预算导致缓存被放弃时返回 false
+ bool AddVideoFrame(MppFrame frame);
+
+ bool AddAudioFrame(MEDIA_BUFFER mb);
+
+ // stream 解码到了文件末尾,所有 stream 都完成后封存
+ void MarkComplete(int stream);
+
+ // 等待封存,返回 false 表示缓存已经放弃或者正在退出
+ bool WaitSealed();
+
+ // 填充过程中放弃缓存,已经封存时不起作用
+ void Disable();
+
+ // 唤醒所有等待的线程,之后 WaitSealed 立即返回 false
+ void Abort();
+
+ bool filling();
+
+ bool sealed();
+
+ // 以下只能在封存之后调用
+ int64_t clip_length() const { return clip_length_; }
+
+ size_t video_frame_count() const { return video_frames_.size(); }
+
+ size_t audio_frame_count() const { return audio_frames_.size(); }
+
+ // 重放第 i 帧,时间戳加上 offset(微秒),用 mpp_frame_deinit 释放
+ MppFrame MakeVideoFrame(size_t i, int64_t offset);
+
+ // 用 RK_MPI_MB_ReleaseBuffer 释放
+ MEDIA_BUFFER MakeAudioFrame(size_t i, int64_t offset, RKAudioBufferPool *pool);
+
+ // 缓存占用的字节数
+ size_t bytes();
+
+ // 从缓存重放的帧数
+ uint64_t hits();
+
+ // 从缓存重放的遍数(按视频计算)
+ uint64_t replays();
+
+private:
+ enum class State {
+   kFilling,
+   kSealed,
+   kDisabled,
+ };
+
+ struct VideoEntry {
+   MppBuffer buffer;
+   RK_U32 width;
+   RK_U32 height;
+   RK_U32 hor_stride;
+   RK_U32 ver_stride;
+   MppFrameFormat fmt;
+   int64_t pts;
+ };
+
+ struct AudioEntry {
+   std::vector<uint8_t> pcm;
+   int64_t pts;
+ };
+
+ // 调用时持有 lock_
+ void Release();
+
+ void Seal();
+
+ size_t budget_bytes_;
+ int streams_;
+ int completed_streams_;
+ AVRational audio_time_base_;
+ int audio_sample_rate_;
+ State state_;
+ bool aborted_;
+ size_t bytes_;
+ uint64_t hits_;
+ uint64_t replays_;
+ int64_t clip_length_;
+ MppBufferGroup frame_group_;
+ std::vector<VideoEntry> video_frames_;
+ std::vector<AudioEntry> audio_frames_;
+ base::Lock lock_;
+ base::ConditionVariable sealed_cond_;
+ DISALLOW_COPY_AND_ASSIGN(DecodedClipCache);
+};
+}
+
+#endif //MEDIA_DECODED_CLIP_CACHE_H_
@@ -0,0 +1,202 @@
+#include "base/logging.h"
+#include "media/demux_thread.h"
+#include "media/mp4_dataset.h"
+#include "media/packet_queue.h"
+#include "media/video_player.h"
+#include "media/ffmpeg_common.h"
+
+namespace media {
+namespace {
+//读包出错(非EOF)时,稍后重试
+const int64_t kDemuxRetryDelay = 10000;
+}
+
+DemuxThread::DemuxThread(VideoPlayer *player,
+                         Mp4Dataset *dataset,
+                         PacketQueue *audio_queue,
+                         PacketQueue *video_queue)
+    : player_(player),
+      dataset_(dataset),
+      audio_queue_(audio_queue),
+      video_queue_(video_queue),
+      keep_running_(true),
+      eos_reached_(false),
+      seek_pending_(false),
+      seek_timestamp_(0),
+      seek_serial_(0),
+      seek_accurate_(false),
+      trick_pending_(false),
+      trick_speed_(0),
+      trick_position_(0),
+      trick_serial_(0),
+      rewind_pending_(false),
+      wakeups_(0),
+      request_cond_(&lock_),
+      thread_(new base::DelegateSimpleThread(this, "DemuxThread")) {
+  thread_->Start();
+}
+
+DemuxThread::~DemuxThread() {
+  {
+    base::AutoLock l(lock_);
+    keep_running_ = false;
+    request_cond_.Signal();
+  }
+  AbortPacketQueues();
+  if (thread_) {
+    thread_->Join();
+    thread_.reset();
+  }
+}
+
+void DemuxThread::Seek(double timestamp, int serial, bool accurate) {
+  {
+    base::AutoLock l(lock_);
+    seek_pending_ = true;
+    seek_timestamp_ = timestamp;
+    seek_serial_ = serial;
+    seek_accurate_ = accurate;
+    trick_pending_ = false;
+    //解封装线程可能正阻塞在已满的队列上,在锁内 abort,保证它在处理请求(flush)之前生效
+    AbortPacketQueues();
+    request_cond_.Signal();
+  }
+}
+
+void DemuxThread::SetTrickPlay(int speed, int64_t position_us, int serial) {
+  {
+    base::AutoLock l(lock_);
+    trick_pending_ = true;
+    trick_speed_ = speed;
+    trick_position_ = position_us;
+    trick_serial_ = serial;
+    seek_pending_ = false;
+    AbortPacketQueues();
+    request_cond_.Signal();
+  }
+}
+
+void DemuxThread::Rewind() {
+  {
+    base::AutoLock l(lock_);
+    rewind_pending_ = true;
+    AbortPacketQueues();
+    request_cond_.Signal();
+  }
+}
+
+uint64_t DemuxThread::wakeups() {
+  base::AutoLock l(lock_);
+  return wakeups_;
+}
+
+void DemuxThread::Run() {
+  DemuxLoop();
+}
+
+void DemuxThread::DemuxLoop() {
+  while (true) {
+    bool do_seek = false;
+    bool do_rewind = false;
+    double timestamp = 0;
+    int serial = 0;
+    bool accurate = false;
+    bool do_trick = false;
+    int trick_speed = 0;
+    int64_t trick_position = 0;
+    int trick_serial = 0;
+    {
+      base::AutoLock l(lock_);
+      //文件读完了,没有新的请求就一直休眠
+      while (keep_running_ && eos_reached_ && !seek_pending_ && !trick_pending_ && !rewind_pending_) {
+        request_cond_.Wait();
+        ++wakeups_;
+      }
+      if (!keep_running_)
+        break;
+      do_seek = seek_pending_;
+      timestamp = seek_timestamp_;
+      serial = seek_serial_;
+      accurate = seek_accurate_;
+      do_trick = trick_pending_;
+      trick_speed = trick_speed_;
+      trick_position = trick_position_;
+      trick_serial = trick_serial_;
+      do_rewind = rewind_pending_;
+      seek_pending_ = false;
+      trick_pending_ = false;
+      rewind_pending_ = false;
+    }
+
+    if (do_rewind) {
+      dataset_->rewind();
+      FlushPacketQueues();
+      eos_reached_ = false;
+    }
+
+    if (do_seek) {
+      //serial 和 timestamp 一起取出,执行这次 seek 时放入的 flush 包只属于这个 serial
+      SetPacketQueueSerial(serial,
+                           accurate ? static_cast<int64_t>(timestamp * base::Time::kMicrosecondsPerSecond)
+                                    : AV_NOPTS_VALUE);
+      if (dataset_->seek(timestamp) < 0) {
+        //即使 seek 失败,也要 flush,解码线程据此通知 player seek 结束
+        FlushPacketQueues();
+        player_->OnMediaError(Error_SeekFailed);
+      }
+      eos_reached_ = false;
+    }
+
+    if (do_trick) {
+      SetPacketQueueSerial(trick_serial, AV_NOPTS_VALUE);
+      if (dataset_->setTrickPlay(trick_speed, trick_position) < 0) {
+        FlushPacketQueues();
+        player_->OnMediaError(Error_SeekFailed);
+      }
+      eos_reached_ = false;
+    }
+
+    if (do_seek || do_trick || do_rewind)
+      continue;
+
+    DemuxResult result = dataset_->demuxNextPacket();
+    if (result == DemuxResult::AV_EOF) {
+      DLOG(INFO) << "Demux reached end of file";
+      eos_reached_ = true;
+    } else if (result == DemuxResult::UNKNOWN) {
+      base::AutoLock l(lock_);
+      if (keep_running_ && !seek_pending_ && !trick_pending_ && !rewind_pending_) {
+        request_cond_.TimedWait(base::TimeDelta::FromMicroseconds(kDemuxRetryDelay));
+        ++wakeups_;
+      }
+    }
+  }
+}
+
+void DemuxThread::AbortPacketQueues() {
+  if (audio_queue_) {
+    audio_queue_->abort();
+  }
+  if (video_queue_) {
+    video_queue_->abort();
+  }
+}
+
+void DemuxThread::SetPacketQueueSerial(int serial, int64_t target_us) {
+  if (audio_queue_) {
+    audio_queue_->set_serial(serial, target_us);
+  }
+  if (video_queue_) {
+    video_queue_->set_serial(serial, target_us);
+  }
+}
+
+void DemuxThread::FlushPacketQueues() {
+  if (audio_queue_) {
+    audio_queue_->flush();
+  }
+  if (video_queue_) {
+    video_queue_->flush();
+  }
+}
+}
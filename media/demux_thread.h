@@ -0,0 +1,78 @@
+#ifndef MEDIA_DEMUX_THREAD_H_
+#define MEDIA_DEMUX_THREAD_H_
+
+#include <memory>
+#include "base/macros.h"
+#include "base/threading/simple_thread.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/condition_variable.h"
+
+namespace media {
+class Mp4Dataset;
+class PacketQueue;
+class VideoPlayer;
+
+/*
+ * 唯一的解封装线程,独占 AVFormatContext,把音视频包分发到各自的 PacketQueue
+ * seek/rewind/快进快退请求也在这个线程执行,避免和 av_read_frame 抢锁
+ * 队列满的时候阻塞在 PacketQueue::put 上,新的请求会通过 abort 把它唤醒
+ */
+class DemuxThread
+    : public base::DelegateSimpleThread::Delegate {
+public:
+ explicit DemuxThread(VideoPlayer *player,
+                      Mp4Dataset *dataset,
+                      PacketQueue *audio_queue,
+                      PacketQueue *video_queue);
+
+ virtual ~DemuxThread() override;
+
+ // 异步 seek,多次调用时只执行最后一次
+ // serial 是 seek 的序号,随 flush 包传给解码线程,player 据此忽略已经被取代的 seek
+ // accurate 为 true 时目标时间也随 flush 包传给解码线程,目标之前的帧解码之后直接丢弃
+ void Seek(double timestamp, int serial, bool accurate);
+
+ // 异步进入(speed 不为 0)或者退出快进快退,position_us 是当前播放时间,serial 同 Seek
+ // 和 Seek 互相取代,只执行最后一个请求
+ void SetTrickPlay(int speed, int64_t position_us, int serial);
+
+ // 异步回到文件开头,并清空所有包队列
+ void Rewind();
+
+ // 解封装线程在空闲时被唤醒的次数
+ uint64_t wakeups();
+
+private:
+ void Run() override;
+
+ void DemuxLoop();
+
+ void AbortPacketQueues();
+
+ void FlushPacketQueues();
+
+ void SetPacketQueueSerial(int serial, int64_t target_us);
+
+ VideoPlayer *player_;
+ Mp4Dataset *dataset_;
+ PacketQueue *audio_queue_;
+ PacketQueue *video_queue_;
+ bool keep_running_;
+ bool eos_reached_;
+ bool seek_pending_;
+ double seek_timestamp_;
+ int seek_serial_;
+ bool seek_accurate_;
+ bool trick_pending_;
+ int trick_speed_;
+ int64_t trick_position_;
+ int trick_serial_;
+ bool rewind_pending_;
+ uint64_t wakeups_;
+ base::Lock lock_;
+ base::ConditionVariable request_cond_;
+ std::unique_ptr<base::DelegateSimpleThread> thread_;
+ DISALLOW_COPY_AND_ASSIGN(DemuxThread);
+};
+}
+#endif  // MEDIA_DEMUX_THREAD_H_
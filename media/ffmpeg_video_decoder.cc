@@ -0,0 +1,174 @@
+#include "media/ffmpeg_video_decoder.h"
+#include "base/logging.h"
+
+namespace media {
+namespace {
+int AlignTo16(int value) {
+  return (value + 15) & ~15;
+}
+}
+
+FFmpegVideoDecoder::FFmpegVideoDecoder(AVStream *stream, size_t max_buffer_size)
+    : stream_(stream),
+      max_buffer_size_(max_buffer_size),
+      sws_context_(nullptr),
+      frame_group_(nullptr),
+      eos_output_(false) {}
+
+FFmpegVideoDecoder::~FFmpegVideoDecoder() {
+  UnInit();
+}
+
+bool FFmpegVideoDecoder::Init() {
+  UnInit();
+  int ret;
+  AVCodec *codec = avcodec_find_decoder(stream_->codecpar->codec_id);
+  if (!codec) {
+    LOG(ERROR) << "avcodec_find_decoder failed: " << stream_->codecpar->codec_id;
+    return false;
+  }
+  codec_context_.reset(avcodec_alloc_context3(codec));
+  if (!codec_context_) {
+    LOG(ERROR) << "avcodec_alloc_context3 failed";
+    return false;
+  }
+  if ((ret = avcodec_parameters_to_context(codec_context_.get(), stream_->codecpar)) < 0) {
+    LOG(ERROR) << "avcodec_parameters_to_context failed:" << ret << ",err:" << AVErrorToString(ret);
+    return false;
+  }
+  //线程数为 0 时由 ffmpeg 按 CPU 核数决定
+  codec_context_->thread_count = 0;
+  codec_context_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  //输入包的时间戳已经是微秒
+  codec_context_->pkt_timebase = AVRational{1, static_cast<int>(base::Time::kMicrosecondsPerSecond)};
+  if ((ret = avcodec_open2(codec_context_.get(), codec, nullptr)) < 0) {
+    LOG(ERROR) << "avcodec_open2 failed:" << ret << ",err:" << AVErrorToString(ret);
+    return false;
+  }
+  frame_.reset(av_frame_alloc());
+
+  //优先用 ION,和硬解输出的 buffer 一样可以直接交给 RGA;没有 ION 时用普通内存
+  MPP_RET mpp_ret = mpp_buffer_group_get_internal(&frame_group_, MPP_BUFFER_TYPE_ION);
+  if (mpp_ret != MPP_OK) {
+    mpp_ret = mpp_buffer_group_get_internal(&frame_group_, MPP_BUFFER_TYPE_NORMAL);
+  }
+  if (mpp_ret != MPP_OK) {
+    LOG(ERROR) << "mpp_buffer_group_get_internal failed: " << mpp_ret;
+    frame_group_ = nullptr;
+    return false;
+  }
+  mpp_ret = mpp_buffer_group_limit_config(frame_group_, 0, max_buffer_size_);
+  if (mpp_ret != MPP_OK) {
+    LOG(ERROR) << "mpp_buffer_group_limit_config failed: " << mpp_ret << ",max buffer size: " << max_buffer_size_;
+    return false;
+  }
+  LOG(INFO) << "ffmpeg video decoder: " << codec->name << ", threads: " << codec_context_->thread_count;
+  return true;
+}
+
+void FFmpegVideoDecoder::UnInit() {
+  codec_context_.reset();
+  frame_.reset();
+  if (sws_context_) {
+    sws_freeContext(sws_context_);
+    sws_context_ = nullptr;
+  }
+  if (frame_group_) {
+    mpp_buffer_group_clear(frame_group_);
+    mpp_buffer_group_put(frame_group_);
+    frame_group_ = nullptr;
+  }
+  eos_output_ = false;
+}
+
+int FFmpegVideoDecoder::SendInput(const AVPacket *packet) {
+  if (!codec_context_)
+    return -EFAULT;
+  return avcodec_send_packet(codec_context_.get(), packet->data ? packet : nullptr);
+}
+
+MppFrame FFmpegVideoDecoder::FetchOutput() {
+  if (!codec_context_ || eos_output_)
+    return nullptr;
+  int ret = avcodec_receive_frame(codec_context_.get(), frame_.get());
+  if (ret == AVERROR_EOF) {
+    eos_output_ = true;
+    return MakeEosFrame();
+  }
+  if (ret < 0) {
+    if (ret != AVERROR(EAGAIN)) {
+      DLOG(ERROR) << "avcodec_receive_frame failed:" << ret << ",err:" << AVErrorToString(ret);
+    }
+    return nullptr;
+  }
+  MppFrame mpp_frame = MakeMppFrame(frame_.get());
+  av_frame_unref(frame_.get());
+  return mpp_frame;
+}
+
+int FFmpegVideoDecoder::Flush() {
+  if (!codec_context_)
+    return -EFAULT;
+  avcodec_flush_buffers(codec_context_.get());
+  eos_output_ = false;
+  return 0;
+}
+
+MppFrame FFmpegVideoDecoder::MakeMppFrame(const AVFrame *frame) {
+  int width = frame->width;
+  int height = frame->height;
+  int hor_stride = AlignTo16(width);
+  int ver_stride = AlignTo16(height);
+  size_t size = static_cast<size_t>(hor_stride) * ver_stride * 3 / 2;
+
+  MppBuffer buffer = nullptr;
+  MPP_RET ret = mpp_buffer_get(frame_group_, &buffer, size);
+  if (ret != MPP_OK || !buffer) {
+    LOG(ERROR) << "mpp_buffer_get failed: " << ret << ",size: " << size;
+    return nullptr;
+  }
+
+  //统一转换为 NV12,和 MPP 硬解的输出格式一致
+  sws_context_ = sws_getCachedContext(sws_context_,
+                                      width,
+                                      height,
+                                      static_cast<AVPixelFormat>(frame->format),
+                                      width,
+                                      height,
+                                      AV_PIX_FMT_NV12,
+                                      SWS_POINT,
+                                      nullptr,
+                                      nullptr,
+                                      nullptr);
+  if (!sws_context_) {
+    LOG(ERROR) << "sws_getCachedContext failed, format: " << frame->format;
+    mpp_buffer_put(buffer);
+    return nullptr;
+  }
+  auto dst = static_cast<uint8_t *>(mpp_buffer_get_ptr(buffer));
+  uint8_t *dst_data[4] = {dst, dst + hor_stride * ver_stride, nullptr, nullptr};
+  int dst_linesize[4] = {hor_stride, hor_stride, 0, 0};
+  sws_scale(sws_context_, frame->data, frame->linesize, 0, height, dst_data, dst_linesize);
+
+  MppFrame mpp_frame = nullptr;
+  mpp_frame_init(&mpp_frame);
+  mpp_frame_set_width(mpp_frame, width);
+  mpp_frame_set_height(mpp_frame, height);
+  mpp_frame_set_hor_stride(mpp_frame, hor_stride);
+  mpp_frame_set_ver_stride(mpp_frame, ver_stride);
+  mpp_frame_set_fmt(mpp_frame, MPP_FMT_YUV420SP);
+  mpp_frame_set_pts(mpp_frame, frame->best_effort_timestamp);
+  //MppFrame 持有 buffer 的引用,这里释放我们自己的
+  mpp_frame_set_buffer(mpp_frame, buffer);
+  mpp_buffer_put(buffer);
+  return mpp_frame;
+}
+
+MppFrame FFmpegVideoDecoder::MakeEosFrame() {
+  MppFrame mpp_frame = nullptr;
+  mpp_frame_init(&mpp_frame);
+  mpp_frame_set_eos(mpp_frame, 1);
+  mpp_frame_set_pts(mpp_frame, AV_NOPTS_VALUE);
+  return mpp_frame;
+}
+}
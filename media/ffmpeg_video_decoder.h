@@ -0,0 +1,57 @@
+#ifndef MEDIA_FFMPEG_VIDEO_DECODER_H_
+#define MEDIA_FFMPEG_VIDEO_DECODER_H_
+
+#include <memory>
+#include "base/macros.h"
+#include "media/ffmpeg_common.h"
+#include "media/video_decoder.h"
+#include <rockchip/mpp_buffer.h>
+
+struct SwsContext;
+
+namespace media {
+
+/*
+ * libavcodec 软解,H.264/HEVC 同时打开帧级和 slice 级多线程
+ * 解码后的图像转换为 NV12,拷贝到 MPP buffer 中,以 MppFrame 输出
+ * MPP 硬解初始化失败或者不支持的码流可以用它代替
+ * 输出仍然是 MppFrame,需要 librockchip_mpp; 播放器的其余部分依赖 rkmedia 和 RGA,所以整个流程目前只能在板子上运行
+ */
+class FFmpegVideoDecoder : public VideoDecoder {
+public:
+ // max_buffer_size: 输出帧 MPP buffer 的数量上限
+ explicit FFmpegVideoDecoder(AVStream *stream, size_t max_buffer_size);
+
+ virtual ~FFmpegVideoDecoder();
+
+ bool Init() override;
+
+ void UnInit();
+
+ int SendInput(const AVPacket *packet) override;
+
+ MppFrame FetchOutput() override;
+
+ int Flush() override;
+
+ bool NeedsAnnexB() const override { return false; }
+
+ const char *name() const override { return "ffmpeg"; }
+
+private:
+ MppFrame MakeMppFrame(const AVFrame *frame);
+
+ MppFrame MakeEosFrame();
+
+ AVStream *stream_;
+ size_t max_buffer_size_;
+ std::unique_ptr<AVCodecContext, ScopedPtrAVFreeContext> codec_context_;
+ std::unique_ptr<AVFrame, ScopedPtrAVFreeFrame> frame_;
+ SwsContext *sws_context_;
+ MppBufferGroup frame_group_;
+ bool eos_output_;
+ DISALLOW_COPY_AND_ASSIGN(FFmpegVideoDecoder);
+};
+}
+
+#endif //MEDIA_FFMPEG_VIDEO_DECODER_H_
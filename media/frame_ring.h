@@ -0,0 +1,281 @@
+#ifndef MEDIA_FRAME_RING_H_
+#define MEDIA_FRAME_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "base/macros.h"
+#include "base/containers/spsc_ring.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace media {
+
+/*
+ * 解码帧队列的公共部分: 一个解码线程写,render 线程读,基于无锁的 base::SpscRing
+ * 1. put/get 不加锁,也不申请内存,只有队列满(空)需要等待时才用到 lock_ 和条件变量
+ *    等待的一方先置 waiting 标志再检查队列,另一方改完队列再检查标志,两边都有 seq_cst fence,不会丢失唤醒
+ *    睡眠之前先让出几次 CPU,另一方通常马上就会取走(放入)一帧,省掉一次条件变量的等待和唤醒
+ * 2. 两个线程都可以 flush: render 线程(读)直接取出所有帧释放;
+ *    解码线程(写)只把 epoch 加一,比当前 epoch 旧的帧由读的一方取到时丢掉
+ * 3. marker 帧(EOS)单独计数,不用遍历队列
+ */
+template <typename T>
+class FrameRing {
+public:
+ // 进入条件变量等待之前最多让出 CPU 的次数
+ static const int kWaitYields = 4;
+
+ typedef void (*ReleaseFunc)(T item);
+ typedef size_t (*BytesFunc)(T item);
+
+ FrameRing(size_t capacity, ReleaseFunc release, BytesFunc bytes)
+     : ring_(capacity),
+       release_(release),
+       bytes_func_(bytes),
+       epoch_(0),
+       bytes_(0),
+       peak_bytes_(0),
+       markers_(0),
+       shutdown_(false),
+       producer_waiting_(false),
+       consumer_waiting_(false),
+       writer_interrupted_(false),
+       wakeups_(0),
+       not_full_cond_(&lock_),
+       not_empty_cond_(&lock_) {}
+
+ // 两个线程都已经停止
+ ~FrameRing() {
+   Clear();
+ }
+
+ // 以下只能在写的线程调用
+ bool full() {
+   return ring_.Full();
+ }
+
+ // 调用之前要保证队列没满
+ void Push(T item, bool marker) {
+   Entry entry;
+   entry.item = item;
+   entry.epoch = epoch_.load(std::memory_order_relaxed);
+   entry.marker = marker;
+   AddBytes(bytes_func_(item));
+   if (marker)
+     markers_.fetch_add(1);
+   if (!ring_.TryPush(entry)) {
+     //不应该发生,调用者没有等待可写
+     SubBytes(bytes_func_(item));
+     if (marker)
+       markers_.fetch_sub(1);
+     release_(item);
+     return;
+   }
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (consumer_waiting_.load(std::memory_order_relaxed)) {
+     base::AutoLock l(lock_);
+     not_empty_cond_.Signal();
+   }
+ }
+
+ // 写的一方 flush,已经在队列中的帧作废
+ void Invalidate() {
+   epoch_.fetch_add(1, std::memory_order_release);
+ }
+
+ bool wait_for_writable(const base::TimeDelta &timeout) {
+   if (YieldUntilReady(true))
+     return true;
+   base::AutoLock l(lock_);
+   producer_waiting_.store(true, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   bool ok = Wait(&not_full_cond_, timeout, true);
+   producer_waiting_.store(false, std::memory_order_relaxed);
+   return ok;
+ }
+
+ // 一直等到可写,或者被 InterruptWriter 打断; 可写时返回 true
+ // 等待之前已经有 InterruptWriter 时立即返回 false
+ bool wait_for_writable_or_interrupted() {
+   if (YieldUntilReady(true))
+     return true;
+   base::AutoLock l(lock_);
+   producer_waiting_.store(true, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   while (!shutdown_.load() && !writer_interrupted_ && ring_.Full()) {
+     not_full_cond_.Wait();
+     ++wakeups_;
+   }
+   producer_waiting_.store(false, std::memory_order_relaxed);
+   writer_interrupted_ = false;
+   return !shutdown_.load() && !ring_.Full();
+ }
+
+ // 以下只能在读的线程调用
+ // 队首的帧,队列为空时返回 nullptr,顺便丢掉已经作废的帧
+ T *Front(bool *marker) {
+   while (Entry *entry = ring_.Front()) {
+     int32_t age = static_cast<int32_t>(epoch_.load(std::memory_order_acquire) - entry->epoch);
+     if (age <= 0) {
+       if (marker)
+         *marker = entry->marker;
+       return &entry->item;
+     }
+     Entry stale{};
+     if (PopEntry(&stale))
+       release_(stale.item);
+   }
+   return nullptr;
+ }
+
+ // 取出队首,调用之前 Front 不为空; 队列为空时返回 T()
+ T Pop() {
+   Entry entry{};
+   PopEntry(&entry);
+   return entry.item;
+ }
+
+ // 读的一方 flush
+ void Clear() {
+   Entry entry{};
+   while (ring_.TryPop(&entry)) {
+     SubBytes(bytes_func_(entry.item));
+     if (entry.marker)
+       markers_.fetch_sub(1);
+     release_(entry.item);
+   }
+   WakeProducer();
+ }
+
+ bool wait_for_readable(const base::TimeDelta &timeout) {
+   if (YieldUntilReady(false))
+     return true;
+   base::AutoLock l(lock_);
+   consumer_waiting_.store(true, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   bool ok = Wait(&not_empty_cond_, timeout, false);
+   consumer_waiting_.store(false, std::memory_order_relaxed);
+   return ok;
+ }
+
+ // 以下可以在任意线程调用
+ void InterruptWriter() {
+   base::AutoLock l(lock_);
+   writer_interrupted_ = true;
+   not_full_cond_.Signal();
+ }
+
+ void shutdown() {
+   base::AutoLock l(lock_);
+   shutdown_.store(true);
+   not_full_cond_.Broadcast();
+   not_empty_cond_.Broadcast();
+ }
+
+ uint64_t wakeups() {
+   base::AutoLock l(lock_);
+   return wakeups_;
+ }
+
+ size_t size() const { return ring_.Size(); }
+
+ size_t capacity() const { return ring_.capacity(); }
+
+ bool has_marker() const { return markers_.load() > 0; }
+
+ size_t bytes() const { return bytes_.load(); }
+
+ size_t peak_bytes() const { return peak_bytes_.load(); }
+
+ // 不在 ring 中,由调用者持有的帧(重排窗口)也计入字节数
+ void AddBytes(size_t n) {
+   size_t bytes = bytes_.fetch_add(n) + n;
+   size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+   while (bytes > peak && !peak_bytes_.compare_exchange_weak(peak, bytes)) {
+   }
+ }
+
+ void SubBytes(size_t n) {
+   bytes_.fetch_sub(n);
+ }
+
+private:
+ struct Entry {
+   T item;
+   uint32_t epoch;
+   bool marker;
+ };
+
+ // 队列为空时返回 false,不改动 entry
+ bool PopEntry(Entry *entry) {
+   if (!ring_.TryPop(entry))
+     return false;
+   SubBytes(bytes_func_(entry->item));
+   if (entry->marker)
+     markers_.fetch_sub(1);
+   WakeProducer();
+   return true;
+ }
+
+ void WakeProducer() {
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (producer_waiting_.load(std::memory_order_relaxed)) {
+     base::AutoLock l(lock_);
+     not_full_cond_.Signal();
+   }
+ }
+
+ // 不加锁, for_write 为 true 时等待不满,否则等待不空; 让出 kWaitYields 次之后还没好返回 false
+ bool YieldUntilReady(bool for_write) {
+   for (int i = 0;; ++i) {
+     if (shutdown_.load())
+       return false;
+     if (!(for_write ? ring_.Full() : ring_.Empty()))
+       return true;
+     if (i == kWaitYields)
+       return false;
+     base::PlatformThread::YieldCurrentThread();
+   }
+ }
+
+ // 持有 lock_ 调用, for_write 为 true 时等待不满,否则等待不空
+ bool Wait(base::ConditionVariable *cond, const base::TimeDelta &timeout, bool for_write) {
+   base::TimeTicks deadline =
+       timeout.is_max() ? base::TimeTicks() : base::TimeTicks::Now() + timeout;
+   while (!shutdown_.load() && (for_write ? ring_.Full() : ring_.Empty())) {
+     if (timeout.is_max()) {
+       cond->Wait();
+     } else {
+       base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+       if (remaining <= base::TimeDelta())
+         return false;
+       cond->TimedWait(remaining);
+     }
+     ++wakeups_;
+   }
+   return !shutdown_.load();
+ }
+
+ base::SpscRing<Entry> ring_;
+ ReleaseFunc release_;
+ BytesFunc bytes_func_;
+ std::atomic<uint32_t> epoch_;
+ std::atomic<size_t> bytes_;
+ std::atomic<size_t> peak_bytes_;
+ std::atomic<int> markers_;
+ std::atomic<bool> shutdown_;
+ std::atomic<bool> producer_waiting_;
+ std::atomic<bool> consumer_waiting_;
+ bool writer_interrupted_;
+ uint64_t wakeups_;
+ base::Lock lock_;
+ base::ConditionVariable not_full_cond_;
+ base::ConditionVariable not_empty_cond_;
+ DISALLOW_COPY_AND_ASSIGN(FrameRing);
+};
+}
+
+#endif //MEDIA_FRAME_RING_H_
@@ -7,8 +7,100 @@
 namespace media {
 const int64_t kRenderPollDelay = 20000;
 
+//render 线程的 timer slack(微秒),内核默认 50 微秒,实时优先级的线程没有 slack
+const int64_t kRenderTimerSlack = 10;
+
+//RenderMode::kNextFrame 下定时器的最长间隔(微秒)
+const int64_t kMaxRenderScheduleDelay = 100000;
+
 const int kAudioChannels = 2;
 
+//容器中没有 frame_size 时使用的默认值(AAC-LC)
+const int kDefaultAudioFrameSize = 1024;
+
+//包队列除了 buffer_time 之外额外缓冲的时长(微秒)
+const int64_t kPacketBufferExtraDuration = 1000000;
+
+//包队列的字节数上限,防止交织很差的文件占用过多内存
+const size_t kMaxVideoPacketBytes = 16 * 1024 * 1024;
+
+const size_t kMaxAudioPacketBytes = 2 * 1024 * 1024;
+
+//mmap 模式下每次 madvise(MADV_WILLNEED) 提示预读的长度
+const int64_t kMmapReadAheadBytes = 4 * 1024 * 1024;
+
+//mmap 模式下 AVIOContext 的缓冲区大小
+const int kMmapIOBufferSize = 32 * 1024;
+
+//压缩包缓冲模式下,解码帧队列在重排深度之外多保留的帧数
+const int kDecodedFrameMargin = 3;
+
+//MPP buffer 在 DPB 和输出队列之外多准备的帧数: 正在解码的一帧, UI 正在显示的一帧, 再留一帧余量
+const size_t kMppExtraFrames = 3;
+
+//无法确定重排深度时使用的默认值
+const int kDefaultReorderDepth = 2;
+
+//从索引计算重排深度时检查的 sample 数
+const size_t kReorderProbeSamples = 256;
+
+//音频输出 buffer 池在输出队列之外多准备的 buffer 数,用来覆盖 AO 内部缓冲的帧
+const size_t kAudioPoolExtraBuffers = 8;
+
+//音频输出 buffer 在一帧样本数之外预留的样本数,用来容纳重采样器的延迟
+const int kAudioPoolSampleMargin = 64;
+
+//ClockMode::kAudioMaster 下 AO 中保持的 buffer 数,以及音频提前送入的时长(微秒)
+const int kAudioMasterQueueBuffers = 4;
+
+const int64_t kAudioMasterLeadTime = 100000;
+
+//音频时钟与视频时钟偏差超过这个值(微秒)时直接对齐,否则逐步修正
+const int64_t kAudioResyncThreshold = 200000;
+
+//每次修正偏差的 1/kAudioClockSmoothing
+const int64_t kAudioClockSmoothing = 16;
+
+//fast start 时,开始走时钟之前在重排深度之外至少缓冲的帧数
+const size_t kFastStartExtraFrames = 1;
+
+//fast start 时等待第一帧和最小缓冲的轮询间隔(微秒)
+const int64_t kFastStartPollDelay = 2000;
+
+//RenderMode::kFreeRun 下视频帧队列为空时的轮询间隔(微秒)
+const int64_t kFreeRunPollDelay = 1000;
+
+//解码延迟统计中最多同时跟踪的未输出包数,超过时丢弃最早的
+const size_t kMaxPendingDecodeSamples = 64;
+
+//送入 EOS 之后,等待解码器输出剩余帧的轮询间隔(微秒)
+const int64_t kDecoderDrainPollDelay = 5000;
+
+//快进快退时每秒最多送给解码器的同步帧数,CPU 占用与速度无关
+const int64_t kTrickPlayFps = 8;
+
+//快进快退的最大倍速
+const int kMaxTrickPlaySpeed = 32;
+
+//没有索引时,seek 之后最多读多少个包去找关键帧
+const int kTrickPlayMaxScanPackets = 1000;
+
+//显示的帧比它的显示时间晚这么多(微秒)时认为渲染落后
+const int64_t kLateFrameThreshold = 50000;
+
+//连续这么多帧落后时让解码器跳过不参考的帧,之后连续这么多帧准时时恢复
+const int kLateFramesBeforeSkip = 8;
+
+const int kOnTimeFramesBeforeResume = 60;
+
+//SetPlaybackRate 的范围
+const double kMinPlaybackRate = 0.5;
+
+const double kMaxPlaybackRate = 2.0;
+
+//统计信息(唤醒次数等)的计算周期(微秒)
+const int64_t kStatsReportInterval = 5000000;
+
 }
 
 #endif //MEDIA_MEDIA_CONSTANTS_H_
@@ -0,0 +1,165 @@
+#include "media/mmap_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "media/ffmpeg_common.h"
+#include "media/media_constants.h"
+
+namespace media {
+namespace {
+struct IOState {
+  std::shared_ptr<MmapFile> file;
+  int64_t pos;
+};
+
+int64_t PageSize() {
+  static const int64_t page_size = sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+}
+
+std::shared_ptr<MmapFile> MmapFile::Open(const std::string &file) {
+  std::shared_ptr<MmapFile> mmap_file(new MmapFile());
+  if (!mmap_file->Map(file)) {
+    LOG(WARNING) << "Failed to mmap file: " << file;
+    return nullptr;
+  }
+  return mmap_file;
+}
+
+MmapFile::MmapFile()
+    : data_(nullptr),
+      size_(0),
+      advised_begin_(0),
+      advised_end_(0) {}
+
+MmapFile::~MmapFile() {
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), static_cast<size_t>(size_));
+  }
+}
+
+bool MmapFile::Map(const std::string &file) {
+  int fd = HANDLE_EINTR(open(file.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd < 0)
+    return false;
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  void *addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  //映射建立之后就不再需要 fd
+  close(fd);
+  if (addr == MAP_FAILED) {
+    PLOG(ERROR) << "mmap";
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(addr);
+  size_ = st.st_size;
+  //不用 MADV_SEQUENTIAL,它会让内核尽快回收读过的页,而广告片是循环播放的
+  WillNeed(0);
+  return true;
+}
+
+void MmapFile::WillNeed(int64_t offset) {
+  if (offset < 0 || offset >= size_)
+    return;
+  //读到预读窗口的后半段再发下一次提示,避免每个包都调用 madvise
+  if (offset >= advised_begin_ && offset < advised_end_ - kMmapReadAheadBytes / 2)
+    return;
+  int64_t begin = offset / PageSize() * PageSize();
+  int64_t end = std::min(size_, begin + kMmapReadAheadBytes);
+  madvise(const_cast<uint8_t *>(data_ + begin), static_cast<size_t>(end - begin), MADV_WILLNEED);
+  advised_begin_ = begin;
+  advised_end_ = end;
+}
+
+AVBufferRef *MmapFile::Wrap(int64_t offset, int size) {
+  if (offset < 0 || size <= 0 || offset + size + AV_INPUT_BUFFER_PADDING_SIZE > size_)
+    return nullptr;
+  auto ref = new std::shared_ptr<MmapFile>(shared_from_this());
+  AVBufferRef *buf = av_buffer_create(const_cast<uint8_t *>(data_ + offset),
+                                      size,
+                                      &MmapFile::ReleaseBuffer,
+                                      ref,
+                                      AV_BUFFER_FLAG_READONLY);
+  if (!buf) {
+    delete ref;
+  }
+  return buf;
+}
+
+void MmapFile::ReleaseBuffer(void *opaque, uint8_t * /*data*/) {
+  delete static_cast<std::shared_ptr<MmapFile> *>(opaque);
+}
+
+AVIOContext *MmapFile::CreateIOContext() {
+  auto buffer = static_cast<uint8_t *>(av_malloc(kMmapIOBufferSize));
+  if (!buffer)
+    return nullptr;
+  auto state = new IOState{shared_from_this(), 0};
+  AVIOContext *io_ctx = avio_alloc_context(buffer,
+                                           kMmapIOBufferSize,
+                                           0,
+                                           state,
+                                           &MmapFile::ReadPacket,
+                                           nullptr,
+                                           &MmapFile::Seek);
+  if (!io_ctx) {
+    av_free(buffer);
+    delete state;
+  }
+  return io_ctx;
+}
+
+void MmapFile::FreeIOContext(AVIOContext **io_ctx) {
+  if (!*io_ctx)
+    return;
+  delete static_cast<IOState *>((*io_ctx)->opaque);
+  av_freep(&(*io_ctx)->buffer);
+  avio_context_free(io_ctx);
+}
+
+int MmapFile::ReadPacket(void *opaque, uint8_t *buf, int buf_size) {
+  auto state = static_cast<IOState *>(opaque);
+  MmapFile *file = state->file.get();
+  if (state->pos >= file->size_)
+    return AVERROR_EOF;
+  int size = static_cast<int>(std::min<int64_t>(buf_size, file->size_ - state->pos));
+  file->WillNeed(state->pos);
+  memcpy(buf, file->data_ + state->pos, size);
+  state->pos += size;
+  return size;
+}
+
+int64_t MmapFile::Seek(void *opaque, int64_t offset, int whence) {
+  auto state = static_cast<IOState *>(opaque);
+  int64_t size = state->file->size_;
+  int64_t pos;
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return size;
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = state->pos + offset;
+      break;
+    case SEEK_END:
+      pos = size + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if (pos < 0 || pos > size)
+    return AVERROR(EINVAL);
+  state->pos = pos;
+  return pos;
+}
+}
@@ -0,0 +1,62 @@
+#ifndef MEDIA_MMAP_FILE_H_
+#define MEDIA_MMAP_FILE_H_
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include "base/macros.h"
+
+struct AVBufferRef;
+struct AVIOContext;
+
+namespace media {
+
+/*
+ * 只读映射整个媒体文件
+ * 1. 提供基于映射内存的 AVIOContext,libavformat 读数据时只有一次 memcpy,没有 read 系统调用
+ * 2. Wrap 直接用映射的内存构造 AVBufferRef,包数据不再拷贝
+ * 用 shared_ptr 管理,AVIOContext 和 AVBufferRef 都持有引用,保证映射比它们活得久
+ * 只能在解封装线程中使用
+ */
+class MmapFile : public std::enable_shared_from_this<MmapFile> {
+public:
+ static std::shared_ptr<MmapFile> Open(const std::string &file);
+
+ ~MmapFile();
+
+ const uint8_t *data() const { return data_; }
+
+ int64_t size() const { return size_; }
+
+ // 播放位置移动到 offset,提示内核预读后面一段数据
+ void WillNeed(int64_t offset);
+
+ // 引用 [offset, offset + size) 的只读 buffer,末尾需要留出 AV_INPUT_BUFFER_PADDING_SIZE
+ // 超出文件范围返回 nullptr
+ AVBufferRef *Wrap(int64_t offset, int size);
+
+ // 用 FreeIOContext 释放
+ AVIOContext *CreateIOContext();
+
+ static void FreeIOContext(AVIOContext **io_ctx);
+
+private:
+ MmapFile();
+
+ bool Map(const std::string &file);
+
+ static int ReadPacket(void *opaque, uint8_t *buf, int buf_size);
+
+ static int64_t Seek(void *opaque, int64_t offset, int whence);
+
+ static void ReleaseBuffer(void *opaque, uint8_t *data);
+
+ const uint8_t *data_;
+ int64_t size_;
+ int64_t advised_begin_;
+ int64_t advised_end_;
+ DISALLOW_COPY_AND_ASSIGN(MmapFile);
+};
+}
+
+#endif //MEDIA_MMAP_FILE_H_
@@ -1,6 +1,12 @@
 ﻿#include "media/mp4_dataset.h"
+#include <string.h>
+#include <algorithm>
 #include "media/packet_queue.h"
+#include "media/mp4_index.h"
+#include "media/mmap_file.h"
+#include "media/media_constants.h"
 #include "base/logging.h"
+#include "base/trace_event/trace_event.h"
 
 namespace media {
 namespace {
@@ -15,9 +21,9 @@ AVPacket *make_eos_packet(int stream_idx) {
 }
 }
 
-std::unique_ptr<Mp4Dataset> Mp4Dataset::create(const std::string &file) {
+std::unique_ptr<Mp4Dataset> Mp4Dataset::create(const std::string &file, const Options &options) {
   std::unique_ptr<Mp4Dataset> dataset(new Mp4Dataset());
-  if (dataset->init(file) < 0) {
+  if (dataset->init(file, options) < 0) {
     LOG(ERROR) << "Failed to initialize mp4 dataset";
     return nullptr;
   }
@@ -31,18 +37,24 @@ Mp4Dataset::~Mp4Dataset() {
   clearFormatContext();
 }
 
-int Mp4Dataset::init(const std::string &file) {
-  AVFormatContext *input_ctx = nullptr;
-  int err = avformat_open_input(&input_ctx, file.c_str(), NULL, NULL);
-  if (err) {
-    LOG(ERROR) << "avformat_open_input:" << err << ",err:" << AVErrorToString(err);
+int Mp4Dataset::init(const std::string &file, const Options &options) {
+  if (!openInput(file, options))
     return -1;
+  if (options.use_index) {
+    index_ = mmap_file_ ? Mp4Index::Create(mmap_file_->data(), mmap_file_->size()) : Mp4Index::Create(file);
   }
-  format_ctx_ = input_ctx;
-  err = avformat_find_stream_info(format_ctx_, NULL);
-  if (err < 0) {
-    LOG(ERROR) << "avformat_find_stream_info:" << err << ",err:" << AVErrorToString(err);
-    return -1;
+  //索引的 track 数和 AVStream 对不上,说明不是我们能处理的 mp4,退回到探测
+  if (index_ && index_->track_count() != format_ctx_->nb_streams) {
+    LOG(WARNING) << "Mp4 index mismatch, tracks:" << index_->track_count()
+                 << ",streams:" << format_ctx_->nb_streams;
+    index_.reset();
+  }
+  if (!index_) {
+    int err = avformat_find_stream_info(format_ctx_, NULL);
+    if (err < 0) {
+      LOG(ERROR) << "avformat_find_stream_info:" << err << ",err:" << AVErrorToString(err);
+      return -1;
+    }
   }
   av_dump_format(format_ctx_, 0, file.c_str(), false);
 
@@ -61,6 +73,53 @@ int Mp4Dataset::init(const std::string &file) {
     return -1;
   }
 
+  if (index_) {
+    //有同步帧表就可以 seek,不需要读包探测
+    const Mp4Index::Track *track = index_->track(video_stream_idx_);
+    enable_seek_ = track && track->sample_count() > 0
+        && (track->all_sync || !track->sync_samples.empty());
+    if (mmap_file_) {
+      //索引的时间戳单位是 timescale,要和 AVStream 的 time_base 一致才能直接用
+      index_demux_ = true;
+      for (int idx : {audio_stream_idx_, video_stream_idx_}) {
+        if (idx < 0)
+          continue;
+        AVRational time_base = format_ctx_->streams[idx]->time_base;
+        if (time_base.num != 1 || time_base.den != static_cast<int>(index_->track(idx)->timescale)) {
+          index_demux_ = false;
+        }
+      }
+      next_samples_.assign(format_ctx_->nb_streams, 0);
+    }
+    return 0;
+  }
+  return probeSeekable();
+}
+
+bool Mp4Dataset::openInput(const std::string &file, const Options &options) {
+  AVFormatContext *input_ctx = nullptr;
+  if (options.use_mmap) {
+    mmap_file_ = MmapFile::Open(file);
+  }
+  if (mmap_file_) {
+    io_ctx_ = mmap_file_->CreateIOContext();
+    input_ctx = avformat_alloc_context();
+    if (!io_ctx_ || !input_ctx) {
+      avformat_free_context(input_ctx);
+      return false;
+    }
+    input_ctx->pb = io_ctx_;
+  }
+  int err = avformat_open_input(&input_ctx, file.c_str(), NULL, NULL);
+  if (err) {
+    LOG(ERROR) << "avformat_open_input:" << err << ",err:" << AVErrorToString(err);
+    return false;
+  }
+  format_ctx_ = input_ctx;
+  return true;
+}
+
+int Mp4Dataset::probeSeekable() {
   for (int i = 0; i < 100; ++i) {
     std::unique_ptr<AVPacket, ScopedPtrAVFreePacket> packet(av_packet_alloc());
     int ret = av_read_frame(format_ctx_, packet.get());
@@ -85,17 +144,22 @@ int Mp4Dataset::init(const std::string &file) {
 }
 
 DemuxResult Mp4Dataset::demuxNextPacket() {
+  TRACE_EVENT0("demux", "Mp4Dataset::demuxNextPacket");
   base::AutoLock l(lock_);
+  if (trick_speed_ != 0) {
+    return demuxTrickPlay();
+  }
+  if (index_demux_) {
+    return demuxFromIndex();
+  }
   std::unique_ptr<AVPacket, ScopedPtrAVFreePacket> packet(av_packet_alloc());
   int ret = av_read_frame(format_ctx_, packet.get());
   if (ret >= 0) {
-    if (audio_queue_ && audio_stream_idx_ >= 0
-        && audio_stream_idx_ == packet->stream_index) {
-      audio_queue_->put(packet.release());
-
-    } else if (video_queue_ && video_stream_idx_ >= 0
-        && video_stream_idx_ == packet->stream_index) {
-      video_queue_->put(packet.release());
+    if ((audio_queue_ && audio_stream_idx_ >= 0
+        && audio_stream_idx_ == packet->stream_index)
+        || (video_queue_ && video_stream_idx_ >= 0
+            && video_stream_idx_ == packet->stream_index)) {
+      putPacket(packet.release());
     } else {
       av_packet_unref(packet.get());
     }
@@ -103,30 +167,176 @@ DemuxResult Mp4Dataset::demuxNextPacket() {
   }
 
   if (ret == AVERROR_EOF || avio_feof(format_ctx_->pb)) {
-    if (audio_queue_ && audio_stream_idx_ >= 0) {
-      AVPacket *pkt = make_eos_packet(audio_stream_idx_);
-      audio_queue_->put(pkt);
-    }
-    if (video_queue_ && video_stream_idx_ >= 0) {
-      AVPacket *pkt = make_eos_packet(video_stream_idx_);
-      video_queue_->put(pkt);
-    }
+    if (loop_ && wrapAround())
+      return DemuxResult::OK;
+    putEosPackets();
     return DemuxResult::AV_EOF;
   }
   return DemuxResult::UNKNOWN;
 }
 
+DemuxResult Mp4Dataset::demuxFromIndex() {
+  int stream_idx = -1;
+  int64_t offset = INT64_MAX;
+  for (int idx : {audio_stream_idx_, video_stream_idx_}) {
+    if (idx < 0 || (idx == audio_stream_idx_ && !audio_queue_) || (idx == video_stream_idx_ && !video_queue_))
+      continue;
+    const Mp4Index::Track *track = index_->track(idx);
+    size_t sample = next_samples_[idx];
+    if (sample < track->sample_count() && track->offsets[sample] < offset) {
+      offset = track->offsets[sample];
+      stream_idx = idx;
+    }
+  }
+  if (stream_idx < 0) {
+    if (loop_ && wrapAround())
+      return DemuxResult::OK;
+    putEosPackets();
+    return DemuxResult::AV_EOF;
+  }
+
+  mmap_file_->WillNeed(offset);
+  AVPacket *pkt = makeIndexPacket(stream_idx, next_samples_[stream_idx]++);
+  if (!pkt)
+    return DemuxResult::UNKNOWN;
+  putPacket(pkt);
+  return DemuxResult::OK;
+}
+
+void Mp4Dataset::putPacket(AVPacket *pkt) {
+  if (loop_) {
+    adjustLoopTimestamp(pkt);
+  }
+  if (pkt->stream_index == audio_stream_idx_) {
+    audio_queue_->put(pkt);
+  } else {
+    //帧在整个流水线中按微秒 PTS 关联,和解码线程转换后的一致
+    TRACE_EVENT_FLOW_BEGIN0("media", "VideoFrame",
+                            ConvertFromTimeBase(format_ctx_->streams[pkt->stream_index]->time_base, pkt->pts).InMicroseconds());
+    video_queue_->put(pkt);
+  }
+}
+
+void Mp4Dataset::adjustLoopTimestamp(AVPacket *pkt) {
+  AVRational time_base = format_ctx_->streams[pkt->stream_index]->time_base;
+  if (pkt->pts != static_cast<int64_t>(AV_NOPTS_VALUE)) {
+    int64_t end = ConvertFromTimeBase(time_base, pkt->pts + pkt->duration).InMicroseconds();
+    if (clip_end_ == static_cast<int64_t>(AV_NOPTS_VALUE) || end > clip_end_)
+      clip_end_ = end;
+  }
+  if (loop_offset_ == 0)
+    return;
+  int64_t offset = ConvertToTimeBase(time_base, base::TimeDelta::FromMicroseconds(loop_offset_));
+  if (pkt->pts != static_cast<int64_t>(AV_NOPTS_VALUE))
+    pkt->pts += offset;
+  if (pkt->dts != static_cast<int64_t>(AV_NOPTS_VALUE))
+    pkt->dts += offset;
+}
+
+bool Mp4Dataset::wrapAround() {
+  //这一轮一个包都没有读到,继续循环只会空转
+  if (clip_end_ == static_cast<int64_t>(AV_NOPTS_VALUE))
+    return false;
+  if (rewindInternal() < 0)
+    return false;
+  //下一轮第一帧紧接着这一轮最后一帧
+  loop_offset_ += clip_end_ - clipStartTime();
+  clip_end_ = AV_NOPTS_VALUE;
+  ++loop_count_;
+  DLOG(INFO) << "Gapless loop, timestamp offset(us):" << loop_offset_;
+  return true;
+}
+
+int64_t Mp4Dataset::clipStartTime() {
+  int64_t start = INT64_MAX;
+  for (int idx : {audio_stream_idx_, video_stream_idx_}) {
+    if (idx < 0)
+      continue;
+    AVStream *stream = format_ctx_->streams[idx];
+    int64_t pts = AV_NOPTS_VALUE;
+    if (index_) {
+      const Mp4Index::Track *track = index_->track(idx);
+      if (track->sample_count() > 0)
+        pts = av_rescale(track->pts(0), base::Time::kMicrosecondsPerSecond, track->timescale);
+    } else if (stream->start_time != static_cast<int64_t>(AV_NOPTS_VALUE)) {
+      pts = ConvertFromTimeBase(stream->time_base, stream->start_time).InMicroseconds();
+    }
+    if (pts != static_cast<int64_t>(AV_NOPTS_VALUE))
+      start = std::min(start, pts);
+  }
+  return start == INT64_MAX ? 0 : start;
+}
+
+AVPacket *Mp4Dataset::makeIndexPacket(int stream_idx, size_t sample) {
+  const Mp4Index::Track *track = index_->track(stream_idx);
+  int64_t offset = track->offsets[sample];
+  auto size = static_cast<int>(track->sizes[sample]);
+  if (offset < 0 || size <= 0 || offset + size > mmap_file_->size()) {
+    LOG(ERROR) << "Invalid sample, stream:" << stream_idx << ",sample:" << sample;
+    return nullptr;
+  }
+  std::unique_ptr<AVPacket, ScopedPtrAVFreePacket> pkt(av_packet_alloc());
+  //文件末尾的 sample 后面没有足够的 padding,只能拷贝
+  AVBufferRef *buf = mmap_file_->Wrap(offset, size);
+  if (buf) {
+    pkt->buf = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+  } else {
+    if (av_new_packet(pkt.get(), size) < 0)
+      return nullptr;
+    memcpy(pkt->data, mmap_file_->data() + offset, size);
+  }
+  pkt->stream_index = stream_idx;
+  pkt->dts = track->dts[sample];
+  pkt->pts = track->pts(sample);
+  if (sample + 1 < track->sample_count()) {
+    pkt->duration = track->dts[sample + 1] - track->dts[sample];
+  } else if (sample > 0) {
+    pkt->duration = track->dts[sample] - track->dts[sample - 1];
+  }
+  pkt->pos = offset;
+  if (track->is_keyframe(sample)) {
+    pkt->flags |= AV_PKT_FLAG_KEY;
+  }
+  return pkt.release();
+}
+
+void Mp4Dataset::putEosPackets() {
+  if (audio_queue_ && audio_stream_idx_ >= 0) {
+    AVPacket *pkt = make_eos_packet(audio_stream_idx_);
+    audio_queue_->put(pkt);
+  }
+  if (video_queue_ && video_stream_idx_ >= 0) {
+    AVPacket *pkt = make_eos_packet(video_stream_idx_);
+    video_queue_->put(pkt);
+  }
+}
+
 int Mp4Dataset::seek(double timestamp) {
   base::AutoLock l(lock_);
+  return seekInternal(timestamp);
+}
+
+int Mp4Dataset::seekInternal(double timestamp) {
   if (!enable_seek_) {
     return -1;
   }
-  auto seek_time = static_cast<int64_t>(timestamp * base::Time::kMicrosecondsPerSecond);
-  int ret = av_seek_frame(format_ctx_, -1, seek_time, AVSEEK_FLAG_BACKWARD);
+  trick_speed_ = 0;
+  int ret;
+  if (index_) {
+    ret = seekByIndex(timestamp);
+  } else {
+    auto seek_time = static_cast<int64_t>(timestamp * base::Time::kMicrosecondsPerSecond);
+    ret = av_seek_frame(format_ctx_, -1, seek_time, AVSEEK_FLAG_BACKWARD);
+  }
   if (ret < 0) {
     LOG(ERROR) << "av_seek_frame:" << ret << ",err:" << AVErrorToString(ret);
     return ret;
   }
+  //seek 之后 player 重新按第一帧的时间戳开始播放,不需要再保持单调
+  loop_offset_ = 0;
+  clip_end_ = AV_NOPTS_VALUE;
   if (audio_queue_ && audio_stream_idx_ >= 0) {
     audio_queue_->flush();
   }
@@ -136,8 +346,185 @@ int Mp4Dataset::seek(double timestamp) {
   return 0;
 }
 
+int Mp4Dataset::setTrickPlay(int speed, int64_t position_us) {
+  base::AutoLock l(lock_);
+  if (!enable_seek_) {
+    return -1;
+  }
+  //播放时间换算回文件位置
+  int64_t position;
+  if (trick_speed_ != 0) {
+    position = trick_origin_ + (position_us - trick_origin_) * trick_speed_;
+  } else {
+    position = position_us - loop_offset_;
+  }
+  if (position < 0)
+    position = 0;
+
+  if (speed == 0) {
+    return seekInternal(static_cast<double>(position) / base::Time::kMicrosecondsPerSecond);
+  }
+
+  loop_offset_ = 0;
+  clip_end_ = AV_NOPTS_VALUE;
+  trick_speed_ = speed;
+  trick_origin_ = position;
+  //第一次取的目标正好是当前位置
+  int64_t step = std::abs(speed) * base::Time::kMicrosecondsPerSecond / kTrickPlayFps;
+  trick_position_ = speed > 0 ? position - step : position + step;
+  if (audio_queue_ && audio_stream_idx_ >= 0) {
+    audio_queue_->flush();
+  }
+  if (video_queue_ && video_stream_idx_ >= 0) {
+    video_queue_->flush();
+  }
+  LOG(INFO) << "Trick play, speed:" << speed << ",position(us):" << position;
+  return 0;
+}
+
+DemuxResult Mp4Dataset::demuxTrickPlay() {
+  AVStream *stream = format_ctx_->streams[video_stream_idx_];
+  int64_t step = std::abs(trick_speed_) * base::Time::kMicrosecondsPerSecond / kTrickPlayFps;
+  int64_t target = trick_position_ + (trick_speed_ > 0 ? step : -step);
+  AVPacket *pkt = nullptr;
+  DemuxResult result = index_ ? readSyncSampleFromIndex(target, &pkt) : readSyncSampleByScan(target, &pkt);
+  if (result == DemuxResult::AV_EOF) {
+    //到头了,解码器要收到 EOS 才会把剩下的帧输出
+    if (video_queue_) {
+      video_queue_->put(make_eos_packet(video_stream_idx_));
+    }
+    return result;
+  }
+  if (result != DemuxResult::OK)
+    return result;
+
+  trick_position_ = ConvertFromTimeBase(stream->time_base, pkt->pts).InMicroseconds();
+  //文件时间按速度压缩成播放时间,离起点越远时间戳越大,倒放也是递增的
+  int64_t distance = trick_position_ - trick_origin_;
+  int64_t play_time = trick_origin_ + (distance < 0 ? -distance : distance) / std::abs(trick_speed_);
+  pkt->pts = ConvertToTimeBase(stream->time_base, base::TimeDelta::FromMicroseconds(play_time));
+  pkt->dts = pkt->pts;
+  pkt->duration = ConvertToTimeBase(stream->time_base,
+                                    base::TimeDelta::FromMicroseconds(base::Time::kMicrosecondsPerSecond
+                                                                          / kTrickPlayFps));
+  if (video_queue_) {
+    video_queue_->put(pkt);
+  } else {
+    av_packet_unref(pkt);
+    av_packet_free(&pkt);
+  }
+  return DemuxResult::OK;
+}
+
+DemuxResult Mp4Dataset::readSyncSampleFromIndex(int64_t target, AVPacket **pkt) {
+  AVStream *stream = format_ctx_->streams[video_stream_idx_];
+  const Mp4Index::Track *track = index_->track(video_stream_idx_);
+  int64_t position = ConvertToTimeBase(stream->time_base, base::TimeDelta::FromMicroseconds(trick_position_));
+  int64_t sample = track->FindSyncSample(ConvertToTimeBase(stream->time_base,
+                                                           base::TimeDelta::FromMicroseconds(target)));
+  //同步帧比步长稀疏时,至少前进(后退)一个同步帧
+  if (trick_speed_ > 0) {
+    while (sample >= 0 && track->pts(sample) <= position)
+      sample = track->NextSyncSample(sample);
+  } else {
+    while (sample >= 0 && track->pts(sample) >= position)
+      sample = track->PrevSyncSample(sample);
+  }
+  if (sample < 0)
+    return DemuxResult::AV_EOF;
+
+  if (index_demux_) {
+    mmap_file_->WillNeed(track->offsets[sample]);
+    *pkt = makeIndexPacket(video_stream_idx_, static_cast<size_t>(sample));
+    return *pkt ? DemuxResult::OK : DemuxResult::UNKNOWN;
+  }
+  int ret = av_seek_frame(format_ctx_, video_stream_idx_, track->dts[sample], AVSEEK_FLAG_BACKWARD);
+  if (ret < 0)
+    return DemuxResult::UNKNOWN;
+  return readNextKeyPacket(pkt);
+}
+
+DemuxResult Mp4Dataset::readSyncSampleByScan(int64_t target, AVPacket **pkt) {
+  AVStream *stream = format_ctx_->streams[video_stream_idx_];
+  int64_t position = ConvertToTimeBase(stream->time_base, base::TimeDelta::FromMicroseconds(trick_position_));
+  int64_t ts = ConvertToTimeBase(stream->time_base, base::TimeDelta::FromMicroseconds(target));
+  //限定范围,保证一定前进(后退)
+  int ret = trick_speed_ > 0
+            ? avformat_seek_file(format_ctx_, video_stream_idx_, position + 1, ts, INT64_MAX, 0)
+            : avformat_seek_file(format_ctx_, video_stream_idx_, INT64_MIN, ts, position - 1, 0);
+  if (ret < 0)
+    return DemuxResult::AV_EOF;
+  DemuxResult result = readNextKeyPacket(pkt);
+  if (result != DemuxResult::OK)
+    return result;
+  if ((trick_speed_ > 0 && (*pkt)->pts <= position) || (trick_speed_ < 0 && (*pkt)->pts >= position)) {
+    av_packet_unref(*pkt);
+    av_packet_free(pkt);
+    return DemuxResult::AV_EOF;
+  }
+  return DemuxResult::OK;
+}
+
+DemuxResult Mp4Dataset::readNextKeyPacket(AVPacket **pkt) {
+  std::unique_ptr<AVPacket, ScopedPtrAVFreePacket> packet(av_packet_alloc());
+  for (int i = 0; i < kTrickPlayMaxScanPackets; ++i) {
+    int ret = av_read_frame(format_ctx_, packet.get());
+    if (ret < 0)
+      return ret == AVERROR_EOF ? DemuxResult::AV_EOF : DemuxResult::UNKNOWN;
+    if (packet->stream_index == video_stream_idx_ && (packet->flags & AV_PKT_FLAG_KEY)
+        && packet->pts != static_cast<int64_t>(AV_NOPTS_VALUE)) {
+      *pkt = packet.release();
+      return DemuxResult::OK;
+    }
+    av_packet_unref(packet.get());
+  }
+  return DemuxResult::AV_EOF;
+}
+
+int Mp4Dataset::seekByIndex(double timestamp) {
+  //二分查找目标时间之前最近的同步帧,直接定位到它的 dts
+  AVStream *stream = format_ctx_->streams[video_stream_idx_];
+  const Mp4Index::Track *track = index_->track(video_stream_idx_);
+  int64_t target = ConvertToTimeBase(stream->time_base, base::TimeDelta::FromSecondsD(timestamp));
+  int64_t sample = track->FindSyncSample(target);
+  if (sample < 0)
+    return AVERROR(EINVAL);
+  if (!index_demux_)
+    return av_seek_frame(format_ctx_, video_stream_idx_, track->dts[sample], AVSEEK_FLAG_BACKWARD);
+
+  //和 libavformat 一样,其他 stream 定位到同步帧 dts 之前的最后一个 sample
+  next_samples_[video_stream_idx_] = static_cast<size_t>(sample);
+  if (audio_stream_idx_ >= 0) {
+    AVStream *audio_stream = format_ctx_->streams[audio_stream_idx_];
+    int64_t audio_dts = av_rescale_q(track->dts[sample], stream->time_base, audio_stream->time_base);
+    int64_t audio_sample = index_->track(audio_stream_idx_)->FindSampleByDts(audio_dts);
+    next_samples_[audio_stream_idx_] = audio_sample < 0 ? 0 : static_cast<size_t>(audio_sample);
+  }
+  return 0;
+}
+
 int Mp4Dataset::rewind() {
   base::AutoLock l(lock_);
+  trick_speed_ = 0;
+  loop_offset_ = 0;
+  clip_end_ = AV_NOPTS_VALUE;
+  return rewindInternal();
+}
+
+void Mp4Dataset::setLoop(bool loop) {
+  //不加锁: 解封装线程阻塞在包队列上时一直持有 lock_
+  loop_ = loop;
+}
+
+uint64_t Mp4Dataset::loopCount() const {
+  return loop_count_.load();
+}
+
+int Mp4Dataset::rewindInternal() {
+  if (index_demux_) {
+    std::fill(next_samples_.begin(), next_samples_.end(), 0);
+    return 0;
+  }
   int ret = avformat_seek_file(format_ctx_,
                                -1,
                                INT64_MIN,
@@ -175,6 +562,10 @@ AVFormatContext *Mp4Dataset::getFormatContext() {
   return format_ctx_;
 }
 
+const Mp4Index *Mp4Dataset::index() const {
+  return index_.get();
+}
+
 AVStream *Mp4Dataset::getAudioStream() {
   if (audio_stream_idx_ < 0)
     return nullptr;
@@ -201,5 +592,7 @@ void Mp4Dataset::clearFormatContext() {
     avformat_free_context(format_ctx_);
     format_ctx_ = nullptr;
   }
+  //自定义的 AVIOContext 不会被 avformat_close_input 释放
+  MmapFile::FreeIOContext(&io_ctx_);
 }
 }
\ No newline at end of file
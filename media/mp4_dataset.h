@@ -1,7 +1,9 @@
 ﻿#ifndef MEDIA_MP4_DATASET_H_
 #define MEDIA_MP4_DATASET_H_
 
+#include <atomic>
 #include <memory>
+#include <vector>
 #include "base/macros.h"
 #include "media/ffmpeg_common.h"
 #include "base/synchronization/lock.h"
@@ -11,6 +13,8 @@ namespace media {
 //mp4 file demuxe
 
 class PacketQueue;
+class Mp4Index;
+class MmapFile;
 
 enum class DemuxResult {
  UNKNOWN,
@@ -20,18 +24,45 @@ enum class DemuxResult {
 
 class Mp4Dataset {
 public:
+ struct Options {
+   // 直接解析 moov 建立 sample 索引,跳过 avformat_find_stream_info 和探测读包
+   bool use_index;
+   // 映射整个文件,libavformat 通过自定义 AVIOContext 读取,没有 read 系统调用
+   // 同时有索引时直接按索引从映射内存生成包,包数据不拷贝
+   bool use_mmap;
+   Options() : use_index(true), use_mmap(false) {}
+ };
+
  Mp4Dataset();
  virtual ~Mp4Dataset();
 
  static std::unique_ptr<Mp4Dataset>
- create(const std::string& file);
+ create(const std::string& file, const Options &options = Options());
 
+ // 只能在 DemuxThread 中调用,包队列满的时候会阻塞
  DemuxResult demuxNextPacket();
 
  int seek(double timestamp);
 
  int rewind();
 
+ // 快进快退(trick play): speed 为 ±2~±32 时只读视频同步帧送给解码器,不读音频
+ // 每秒最多送出 kTrickPlayFps 个同步帧,与速度无关,时间戳按速度压缩,倒放时也是递增的
+ // speed 为 0 时回到正常播放,从当前位置 seek 到关键帧
+ // position_us 是当前的播放时间(最近送出的包的时间线),会换算回文件位置
+ // 和 seek 一样 flush 所有包队列
+ int setTrickPlay(int speed, int64_t position_us);
+
+ // 无缝循环: 读到文件末尾时不再送出 EOS 包,直接回到开头继续读,
+ // 后面的包时间戳加上已经播放的时长,保证跨越循环边界时单调递增
+ // seek/rewind 会把累计的时间戳偏移清零
+ // 可以在任意线程调用,下一次读到文件末尾时生效
+ void setLoop(bool loop);
+
+ // 无缝循环回到开头的次数,可以在任意线程调用
+ // 不加锁: 解封装线程阻塞在包队列上时一直持有 lock_
+ uint64_t loopCount() const;
+
  void setAudioPacketQueue(PacketQueue *audio_queue);
 
  void setVideoPacketQueue(PacketQueue *video_queue);
@@ -48,14 +79,73 @@ public:
 
  AVFormatContext *getFormatContext();
 
+ // 没有使用索引或者索引解析失败时为空
+ const Mp4Index *index() const;
+
  void clearFormatContext();
 private:
- int init(const std::string& file);
+ int init(const std::string& file, const Options &options);
+
+ int probeSeekable();
+
+ int seekByIndex(double timestamp);
+
+ bool openInput(const std::string &file, const Options &options);
+
+ // 按索引解封装: 每次取文件偏移最小的下一个 sample, 保证顺序读
+ DemuxResult demuxFromIndex();
+
+ AVPacket *makeIndexPacket(int stream_idx, size_t sample);
+
+ void putEosPackets();
+
+ int rewindInternal();
+
+ // 读到文件末尾时回到开头,返回 false 表示不能继续循环
+ bool wrapAround();
+
+ // 记录本轮读到的最大结束时间,并加上循环的时间戳偏移
+ void adjustLoopTimestamp(AVPacket *pkt);
+
+ // 第一个 sample 的显示时间(微秒)
+ int64_t clipStartTime();
+
+ void putPacket(AVPacket *pkt);
+
+ int seekInternal(double timestamp);
+
+ DemuxResult demuxTrickPlay();
+
+ // 找到 target(微秒)附近,并且在当前位置之后(倒放时之前)的下一个同步帧
+ DemuxResult readSyncSampleFromIndex(int64_t target, AVPacket **pkt);
+
+ // 没有索引时用 avformat_seek_file 限定范围,再读到第一个关键帧
+ DemuxResult readSyncSampleByScan(int64_t target, AVPacket **pkt);
+
+ // 从当前读位置往后读到第一个视频关键帧
+ DemuxResult readNextKeyPacket(AVPacket **pkt);
 
  AVFormatContext *format_ctx_;
+ std::unique_ptr<Mp4Index> index_;
+ std::shared_ptr<MmapFile> mmap_file_;
+ AVIOContext *io_ctx_ = nullptr;
+ bool index_demux_ = false;
+ // 按索引解封装时每个 stream 下一个要读的 sample
+ std::vector<size_t> next_samples_;
  int audio_stream_idx_ = -1;
  int video_stream_idx_ = -1;
  bool enable_seek_ = false;
+ std::atomic<bool> loop_{false};
+ // 循环时累加到包时间戳上的偏移(微秒)
+ int64_t loop_offset_ = 0;
+ // 本轮读到的包(不含偏移)的最大结束时间(微秒)
+ int64_t clip_end_ = AV_NOPTS_VALUE;
+ std::atomic<uint64_t> loop_count_{0};
+ // 快进快退的速度,0 表示正常播放
+ int trick_speed_ = 0;
+ // 进入快进快退时的文件位置,以及最近送出的同步帧的文件位置(微秒)
+ int64_t trick_origin_ = 0;
+ int64_t trick_position_ = 0;
  PacketQueue *audio_queue_{};
  PacketQueue *video_queue_{};
  base::Lock lock_;
@@ -0,0 +1,540 @@
+#include "media/mp4_index.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "base/logging.h"
+
+namespace media {
+namespace {
+//moov 一般只有几 MB,超过这个值认为文件有问题
+const int64_t kMaxMoovSize = 64 * 1024 * 1024;
+
+constexpr uint32_t FourCC(char a, char b, char c, char d) {
+  return (static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(b) << 16)
+      | (static_cast<uint32_t>(c) << 8) | static_cast<uint32_t>(d);
+}
+
+uint16_t ReadU16(const uint8_t *p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t ReadU32(const uint8_t *p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+      | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint64_t ReadU64(const uint8_t *p) {
+  return (static_cast<uint64_t>(ReadU32(p)) << 32) | ReadU32(p + 4);
+}
+
+struct Box {
+  uint32_t type;
+  const uint8_t *data; //payload, 不包含 box 头
+  size_t size;
+  Box() : type(0), data(nullptr), size(0) {}
+};
+
+//从 [*p, end) 中读取下一个 box,成功后 *p 指向下一个 box
+bool NextBox(const uint8_t **p, const uint8_t *end, Box *box) {
+  const uint8_t *cur = *p;
+  if (end - cur < 8)
+    return false;
+  uint64_t size = ReadU32(cur);
+  box->type = ReadU32(cur + 4);
+  size_t header_size = 8;
+  if (size == 1) {
+    if (end - cur < 16)
+      return false;
+    size = ReadU64(cur + 8);
+    header_size = 16;
+  } else if (size == 0) {
+    size = static_cast<uint64_t>(end - cur);
+  }
+  if (size < header_size || size > static_cast<uint64_t>(end - cur))
+    return false;
+  box->data = cur + header_size;
+  box->size = static_cast<size_t>(size - header_size);
+  *p = cur + size;
+  return true;
+}
+
+//一个 trak 中我们关心的 box
+struct TrakBoxes {
+  uint32_t track_id;
+  uint32_t handler;
+  uint32_t timescale;
+  int64_t duration;
+  Box stts, ctts, stss, stsc, stsz, stz2, stco, co64, elst;
+  TrakBoxes() : track_id(0), handler(0), timescale(0), duration(0) {}
+};
+
+void CollectTrakBoxes(const uint8_t *data, size_t size, TrakBoxes *trak) {
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  Box box;
+  while (NextBox(&p, end, &box)) {
+    switch (box.type) {
+      case FourCC('m', 'd', 'i', 'a'):
+      case FourCC('m', 'i', 'n', 'f'):
+      case FourCC('s', 't', 'b', 'l'):
+      case FourCC('e', 'd', 't', 's'):
+        CollectTrakBoxes(box.data, box.size, trak);
+        break;
+      case FourCC('t', 'k', 'h', 'd'):
+        if (box.size >= 24) {
+          trak->track_id = box.data[0] == 1 ? ReadU32(box.data + 20) : ReadU32(box.data + 12);
+        }
+        break;
+      case FourCC('m', 'd', 'h', 'd'):
+        if (box.size >= 32 && box.data[0] == 1) {
+          trak->timescale = ReadU32(box.data + 20);
+          trak->duration = static_cast<int64_t>(ReadU64(box.data + 24));
+        } else if (box.size >= 20) {
+          trak->timescale = ReadU32(box.data + 12);
+          trak->duration = ReadU32(box.data + 16);
+        }
+        break;
+      case FourCC('h', 'd', 'l', 'r'):
+        if (box.size >= 12) {
+          trak->handler = ReadU32(box.data + 8);
+        }
+        break;
+      case FourCC('s', 't', 't', 's'): trak->stts = box;
+        break;
+      case FourCC('c', 't', 't', 's'): trak->ctts = box;
+        break;
+      case FourCC('s', 't', 's', 's'): trak->stss = box;
+        break;
+      case FourCC('s', 't', 's', 'c'): trak->stsc = box;
+        break;
+      case FourCC('s', 't', 's', 'z'): trak->stsz = box;
+        break;
+      case FourCC('s', 't', 'z', '2'): trak->stz2 = box;
+        break;
+      case FourCC('s', 't', 'c', 'o'): trak->stco = box;
+        break;
+      case FourCC('c', 'o', '6', '4'): trak->co64 = box;
+        break;
+      case FourCC('e', 'l', 's', 't'): trak->elst = box;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+//full box: version(1) + flags(3) + entry_count(4), 检查 entry 是否越界
+bool TableEntries(const Box &box, size_t header, size_t entry_size, uint32_t *count) {
+  if (!box.data || box.size < header)
+    return false;
+  *count = ReadU32(box.data + header - 4);
+  return (box.size - header) / entry_size >= *count;
+}
+
+bool BuildSizes(const TrakBoxes &trak, int64_t file_size, Mp4Index::Track *track) {
+  uint32_t count = 0;
+  if (trak.stsz.data) {
+    if (trak.stsz.size < 12)
+      return false;
+    uint32_t sample_size = ReadU32(trak.stsz.data + 4);
+    count = ReadU32(trak.stsz.data + 8);
+    if (sample_size) {
+      //count 没有表项可以校验,所有 sample 加起来不能比文件还大,否则损坏的 stsz 会申请几个 GB 的内存
+      if (static_cast<uint64_t>(count) * sample_size > static_cast<uint64_t>(file_size))
+        return false;
+      track->sizes.assign(count, sample_size);
+      return true;
+    }
+    if ((trak.stsz.size - 12) / 4 < count)
+      return false;
+    track->sizes.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      track->sizes[i] = ReadU32(trak.stsz.data + 12 + i * 4);
+    }
+    return true;
+  }
+  if (trak.stz2.data) {
+    if (trak.stz2.size < 12)
+      return false;
+    uint8_t field_size = trak.stz2.data[7];
+    count = ReadU32(trak.stz2.data + 8);
+    if (field_size != 4 && field_size != 8 && field_size != 16)
+      return false;
+    if ((trak.stz2.size - 12) * 8 / field_size < count)
+      return false;
+    const uint8_t *p = trak.stz2.data + 12;
+    track->sizes.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      if (field_size == 16) {
+        track->sizes[i] = ReadU16(p + i * 2);
+      } else if (field_size == 8) {
+        track->sizes[i] = p[i];
+      } else {
+        track->sizes[i] = (i & 1) ? (p[i / 2] & 0x0f) : (p[i / 2] >> 4);
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+bool BuildOffsets(const TrakBoxes &trak, Mp4Index::Track *track) {
+  std::vector<uint64_t> chunk_offsets;
+  uint32_t chunk_count = 0;
+  if (trak.stco.data) {
+    if (!TableEntries(trak.stco, 8, 4, &chunk_count))
+      return false;
+    chunk_offsets.resize(chunk_count);
+    for (uint32_t i = 0; i < chunk_count; ++i) {
+      chunk_offsets[i] = ReadU32(trak.stco.data + 8 + i * 4);
+    }
+  } else if (trak.co64.data) {
+    if (!TableEntries(trak.co64, 8, 8, &chunk_count))
+      return false;
+    chunk_offsets.resize(chunk_count);
+    for (uint32_t i = 0; i < chunk_count; ++i) {
+      chunk_offsets[i] = ReadU64(trak.co64.data + 8 + i * 8);
+    }
+  } else {
+    return false;
+  }
+
+  uint32_t stsc_count = 0;
+  if (!TableEntries(trak.stsc, 8, 12, &stsc_count) || stsc_count == 0)
+    return false;
+
+  const size_t sample_count = track->sizes.size();
+  track->offsets.resize(sample_count);
+  size_t sample = 0;
+  for (uint32_t entry = 0; entry < stsc_count && sample < sample_count; ++entry) {
+    const uint8_t *e = trak.stsc.data + 8 + entry * 12;
+    uint32_t first_chunk = ReadU32(e);
+    uint32_t samples_per_chunk = ReadU32(e + 4);
+    uint32_t last_chunk = chunk_count;
+    if (entry + 1 < stsc_count) {
+      last_chunk = std::min(chunk_count, ReadU32(e + 12) - 1);
+    }
+    if (first_chunk == 0)
+      return false;
+    for (uint32_t chunk = first_chunk; chunk <= last_chunk && sample < sample_count; ++chunk) {
+      uint64_t offset = chunk_offsets[chunk - 1];
+      for (uint32_t i = 0; i < samples_per_chunk && sample < sample_count; ++i) {
+        track->offsets[sample] = static_cast<int64_t>(offset);
+        offset += track->sizes[sample];
+        ++sample;
+      }
+    }
+  }
+  return sample == sample_count;
+}
+
+bool BuildTimestamps(const TrakBoxes &trak, Mp4Index::Track *track) {
+  const size_t sample_count = track->sizes.size();
+  uint32_t stts_count = 0;
+  if (!TableEntries(trak.stts, 8, 8, &stts_count))
+    return false;
+  track->dts.resize(sample_count);
+  int64_t dts = 0;
+  uint32_t delta = 0;
+  size_t sample = 0;
+  for (uint32_t entry = 0; entry < stts_count && sample < sample_count; ++entry) {
+    uint32_t count = ReadU32(trak.stts.data + 8 + entry * 8);
+    delta = ReadU32(trak.stts.data + 12 + entry * 8);
+    for (uint32_t i = 0; i < count && sample < sample_count; ++i) {
+      track->dts[sample++] = dts;
+      dts += delta;
+    }
+  }
+  //stts 比 sample 少,沿用最后一个 delta
+  while (sample < sample_count) {
+    track->dts[sample++] = dts;
+    dts += delta;
+  }
+
+  uint32_t ctts_count = 0;
+  if (TableEntries(trak.ctts, 8, 8, &ctts_count) && ctts_count > 0) {
+    track->cts_offsets.assign(sample_count, 0);
+    sample = 0;
+    for (uint32_t entry = 0; entry < ctts_count && sample < sample_count; ++entry) {
+      uint32_t count = ReadU32(trak.ctts.data + 8 + entry * 8);
+      //version 0 按规范是无符号的,但和 ffmpeg 一样按有符号处理
+      auto offset = static_cast<int32_t>(ReadU32(trak.ctts.data + 12 + entry * 8));
+      for (uint32_t i = 0; i < count && sample < sample_count; ++i) {
+        track->cts_offsets[sample++] = offset;
+      }
+    }
+  }
+  return true;
+}
+
+void BuildSyncSamples(const TrakBoxes &trak, Mp4Index::Track *track) {
+  uint32_t stss_count = 0;
+  if (!TableEntries(trak.stss, 8, 4, &stss_count)) {
+    track->all_sync = true;
+    return;
+  }
+  track->all_sync = false;
+  track->sync_samples.reserve(stss_count);
+  for (uint32_t i = 0; i < stss_count; ++i) {
+    uint32_t number = ReadU32(trak.stss.data + 8 + i * 4);
+    if (number == 0 || number > track->sizes.size())
+      continue;
+    track->sync_samples.push_back(number - 1);
+  }
+  std::sort(track->sync_samples.begin(), track->sync_samples.end());
+}
+
+//只处理常见的情况: 可选的空 edit + 一个 media_time 偏移
+int64_t EditListOffset(const TrakBoxes &trak, uint32_t movie_timescale) {
+  if (!trak.elst.data || trak.elst.size < 8 || !movie_timescale || !trak.timescale)
+    return 0;
+  uint8_t version = trak.elst.data[0];
+  uint32_t count = ReadU32(trak.elst.data + 4);
+  size_t entry_size = version == 1 ? 20 : 12;
+  if ((trak.elst.size - 8) / entry_size < count)
+    return 0;
+  int64_t offset = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint8_t *e = trak.elst.data + 8 + i * entry_size;
+    int64_t segment_duration;
+    int64_t media_time;
+    if (version == 1) {
+      segment_duration = static_cast<int64_t>(ReadU64(e));
+      media_time = static_cast<int64_t>(ReadU64(e + 8));
+    } else {
+      segment_duration = ReadU32(e);
+      media_time = static_cast<int32_t>(ReadU32(e + 4));
+    }
+    if (media_time == -1) {
+      offset += segment_duration * trak.timescale / movie_timescale;
+      continue;
+    }
+    offset -= media_time;
+    break;
+  }
+  return offset;
+}
+
+//在 [0, count) 中找最后一个满足 key(i) <= value 的位置,没有返回 -1
+template<typename KeyFunc>
+int64_t FindLastNotAfter(size_t count, int64_t value, KeyFunc key) {
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (key(mid) <= value) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return static_cast<int64_t>(lo) - 1;
+}
+}
+
+Mp4Index::Track::Track()
+    : type(kUnknownTrack),
+      track_id(0),
+      timescale(0),
+      duration(0),
+      time_offset(0),
+      all_sync(true) {}
+
+bool Mp4Index::Track::is_keyframe(size_t i) const {
+  if (all_sync)
+    return true;
+  return std::binary_search(sync_samples.begin(), sync_samples.end(), static_cast<uint32_t>(i));
+}
+
+int64_t Mp4Index::Track::FindSyncSample(int64_t timestamp) const {
+  if (sizes.empty())
+    return -1;
+  if (all_sync) {
+    int64_t sample = FindLastNotAfter(sizes.size(), timestamp, [this](size_t i) { return pts(i); });
+    return sample < 0 ? 0 : sample;
+  }
+  if (sync_samples.empty())
+    return -1;
+  //关键帧不会被重排,它们的 pts 是递增的
+  int64_t k = FindLastNotAfter(sync_samples.size(), timestamp,
+                               [this](size_t i) { return pts(sync_samples[i]); });
+  return sync_samples[k < 0 ? 0 : k];
+}
+
+int64_t Mp4Index::Track::NextSyncSample(size_t sample) const {
+  if (all_sync)
+    return sample + 1 < sizes.size() ? static_cast<int64_t>(sample + 1) : -1;
+  auto it = std::upper_bound(sync_samples.begin(), sync_samples.end(), static_cast<uint32_t>(sample));
+  return it == sync_samples.end() ? -1 : *it;
+}
+
+int64_t Mp4Index::Track::PrevSyncSample(size_t sample) const {
+  if (all_sync)
+    return sample > 0 && sample <= sizes.size() ? static_cast<int64_t>(sample - 1) : -1;
+  auto it = std::lower_bound(sync_samples.begin(), sync_samples.end(), static_cast<uint32_t>(sample));
+  return it == sync_samples.begin() ? -1 : *(--it);
+}
+
+int64_t Mp4Index::Track::FindSampleByDts(int64_t timestamp) const {
+  if (dts.empty())
+    return -1;
+  int64_t sample = FindLastNotAfter(dts.size(), timestamp, [this](size_t i) { return dts[i]; });
+  return sample < 0 ? 0 : sample;
+}
+
+int Mp4Index::Track::ReorderDepth(size_t max_samples) const {
+  if (cts_offsets.empty())
+    return 0;
+  size_t count = std::min(max_samples, sample_count());
+  int depth = 0;
+  for (size_t j = 1; j < count; ++j) {
+    int reordered = 0;
+    for (size_t i = 0; i < j; ++i) {
+      if (pts(i) > pts(j))
+        ++reordered;
+    }
+    depth = std::max(depth, reordered);
+  }
+  return depth;
+}
+
+std::unique_ptr<Mp4Index> Mp4Index::Create(const std::string &file) {
+  std::unique_ptr<Mp4Index> index(new Mp4Index());
+  if (!index->Parse(file)) {
+    LOG(WARNING) << "Failed to build mp4 index: " << file;
+    return nullptr;
+  }
+  return index;
+}
+
+std::unique_ptr<Mp4Index> Mp4Index::Create(const uint8_t *data, int64_t size) {
+  std::unique_ptr<Mp4Index> index(new Mp4Index());
+  index->file_size_ = size;
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  Box box;
+  while (NextBox(&p, end, &box)) {
+    if (box.type == FourCC('m', 'o', 'o', 'v')) {
+      if (index->ParseMoov(box.data, box.size))
+        return index;
+      break;
+    }
+  }
+  LOG(WARNING) << "Failed to build mp4 index from memory";
+  return nullptr;
+}
+
+Mp4Index::Mp4Index()
+    : movie_timescale_(0),
+      file_size_(0) {}
+
+Mp4Index::~Mp4Index() = default;
+
+const Mp4Index::Track *Mp4Index::track(size_t index) const {
+  if (index >= tracks_.size())
+    return nullptr;
+  return &tracks_[index];
+}
+
+bool Mp4Index::Parse(const std::string &file) {
+  FILE *fp = fopen(file.c_str(), "rb");
+  if (!fp)
+    return false;
+  struct stat st{};
+  if (fstat(fileno(fp), &st) != 0) {
+    fclose(fp);
+    return false;
+  }
+  file_size_ = st.st_size;
+
+  //只扫描顶层 box 的头,找到 moov 后整体读入
+  std::vector<uint8_t> moov;
+  int64_t pos = 0;
+  uint8_t header[16];
+  while (pos + 8 <= file_size_) {
+    if (fseeko(fp, pos, SEEK_SET) != 0 || fread(header, 1, 8, fp) != 8)
+      break;
+    uint64_t size = ReadU32(header);
+    uint32_t type = ReadU32(header + 4);
+    int64_t header_size = 8;
+    if (size == 1) {
+      if (fread(header + 8, 1, 8, fp) != 8)
+        break;
+      size = ReadU64(header + 8);
+      header_size = 16;
+    } else if (size == 0) {
+      size = static_cast<uint64_t>(file_size_ - pos);
+    }
+    if (size < static_cast<uint64_t>(header_size) || pos + static_cast<int64_t>(size) > file_size_)
+      break;
+    if (type == FourCC('m', 'o', 'o', 'v')) {
+      int64_t payload = static_cast<int64_t>(size) - header_size;
+      if (payload > kMaxMoovSize)
+        break;
+      moov.resize(static_cast<size_t>(payload));
+      if (fread(moov.data(), 1, moov.size(), fp) != moov.size())
+        moov.clear();
+      break;
+    }
+    pos += static_cast<int64_t>(size);
+  }
+  fclose(fp);
+
+  if (moov.empty())
+    return false;
+  return ParseMoov(moov.data(), moov.size());
+}
+
+bool Mp4Index::ParseMoov(const uint8_t *data, size_t size) {
+  std::vector<TrakBoxes> traks;
+  const uint8_t *p = data;
+  const uint8_t *end = data + size;
+  Box box;
+  while (NextBox(&p, end, &box)) {
+    if (box.type == FourCC('m', 'v', 'h', 'd')) {
+      if (box.size >= 24) {
+        movie_timescale_ = box.data[0] == 1 ? ReadU32(box.data + 20) : ReadU32(box.data + 12);
+      }
+    } else if (box.type == FourCC('t', 'r', 'a', 'k')) {
+      TrakBoxes trak;
+      CollectTrakBoxes(box.data, box.size, &trak);
+      traks.push_back(trak);
+    }
+  }
+  if (traks.empty())
+    return false;
+
+  tracks_.resize(traks.size());
+  for (size_t i = 0; i < traks.size(); ++i) {
+    const TrakBoxes &trak = traks[i];
+    Track &track = tracks_[i];
+    track.track_id = trak.track_id;
+    track.timescale = trak.timescale;
+    track.duration = trak.duration;
+    if (trak.handler == FourCC('v', 'i', 'd', 'e')) {
+      track.type = kVideoTrack;
+    } else if (trak.handler == FourCC('s', 'o', 'u', 'n')) {
+      track.type = kAudioTrack;
+    }
+    //不认识的 track 允许解析失败,音视频 track 必须完整
+    bool ok = BuildSizes(trak, file_size_, &track)
+        && BuildOffsets(trak, &track)
+        && BuildTimestamps(trak, &track);
+    if (!ok) {
+      if (track.type != kUnknownTrack) {
+        LOG(ERROR) << "Invalid sample table, track id:" << track.track_id;
+        return false;
+      }
+      track = Track();
+      continue;
+    }
+    BuildSyncSamples(trak, &track);
+    track.time_offset = EditListOffset(trak, movie_timescale_);
+    if (track.time_offset) {
+      for (auto &dts : track.dts) {
+        dts += track.time_offset;
+      }
+    }
+  }
+  return true;
+}
+}
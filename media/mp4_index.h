@@ -0,0 +1,95 @@
+#ifndef MEDIA_MP4_INDEX_H_
+#define MEDIA_MP4_INDEX_H_
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "base/macros.h"
+
+namespace media {
+
+/*
+ * 直接解析 moov 中的 sample table (stts/ctts/stss/stsc/stsz/stco),
+ * 得到每个 sample 的文件偏移,大小,pts/dts 以及是否关键帧
+ * 打开文件时不需要 avformat_find_stream_info 探测,seek 时可以二分查找最近的同步帧
+ * 不依赖 ffmpeg,track 的顺序与 libavformat 中 AVStream 的顺序一致
+ */
+class Mp4Index {
+public:
+ enum TrackType {
+   kUnknownTrack,
+   kVideoTrack,
+   kAudioTrack,
+ };
+
+ // 按列存储(struct-of-arrays),时间戳单位为 timescale
+ struct Track {
+   TrackType type;
+   uint32_t track_id;
+   uint32_t timescale;
+   int64_t duration;
+   // edit list 带来的时间偏移,已经算进 dts 中
+   int64_t time_offset;
+   std::vector<int64_t> offsets;
+   std::vector<uint32_t> sizes;
+   std::vector<int64_t> dts;
+   std::vector<int32_t> cts_offsets; // 没有 ctts 时为空
+   std::vector<uint32_t> sync_samples; // 升序, 没有 stss 时为空(全部都是同步帧)
+   bool all_sync;
+
+   Track();
+
+   size_t sample_count() const { return sizes.size(); }
+
+   int64_t pts(size_t i) const {
+     return cts_offsets.empty() ? dts[i] : dts[i] + cts_offsets[i];
+   }
+
+   bool is_keyframe(size_t i) const;
+
+   // pts <= timestamp 的最后一个同步帧, 没有则返回第一个同步帧, 空 track 返回 -1
+   int64_t FindSyncSample(int64_t timestamp) const;
+
+   // 下一个/上一个同步帧, 没有则返回 -1
+   int64_t NextSyncSample(size_t sample) const;
+
+   int64_t PrevSyncSample(size_t sample) const;
+
+   // dts <= timestamp 的最后一个 sample, 没有则返回 0, 空 track 返回 -1
+   int64_t FindSampleByDts(int64_t timestamp) const;
+
+   // 前 max_samples 个 sample 中解码顺序和显示顺序的最大重排深度,
+   // 即某一帧之前解码、之后显示的帧数的最大值, 没有 ctts 时为 0
+   int ReorderDepth(size_t max_samples) const;
+ };
+
+ static std::unique_ptr<Mp4Index> Create(const std::string &file);
+
+ // 从已经映射到内存的整个文件建立索引
+ static std::unique_ptr<Mp4Index> Create(const uint8_t *data, int64_t size);
+
+ ~Mp4Index();
+
+ size_t track_count() const { return tracks_.size(); }
+
+ // index 与 AVStream::index 对应
+ const Track *track(size_t index) const;
+
+ int64_t file_size() const { return file_size_; }
+
+private:
+ Mp4Index();
+
+ bool Parse(const std::string &file);
+
+ bool ParseMoov(const uint8_t *data, size_t size);
+
+ std::vector<Track> tracks_;
+ uint32_t movie_timescale_;
+ int64_t file_size_;
+ DISALLOW_COPY_AND_ASSIGN(Mp4Index);
+};
+}
+
+#endif //MEDIA_MP4_INDEX_H_
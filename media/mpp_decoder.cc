@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include "media/mpp_decoder.h"
 #include "base/logging.h"
+#include "base/trace_event/trace_event.h"
 
 namespace media {
 
@@ -79,13 +80,34 @@ void RKMppDecoder::UnInit() {
   }
 }
 
-int RKMppDecoder::SendInput(MppPacket packet) {
+int RKMppDecoder::SendInput(const AVPacket *packet) {
+  TRACE_EVENT1("decoder", "RKMppDecoder::SendInput", "pts", packet->pts);
   if (!ctx_)
     return -EFAULT;
-  return mpi_->decode_put_packet(ctx_, packet);
+  if (packet->data)
+    TRACE_EVENT_FLOW_STEP0("media", "VideoFrame", packet->pts);
+  MppPacket mpp_packet = nullptr;
+  MPP_RET ret = mpp_packet_init(&mpp_packet, packet->data, packet->size);
+  if (ret != MPP_OK) {
+    LOG(ERROR) << "mpp_packet_init failed, ret: " << ret;
+    return ret;
+  }
+  mpp_packet_set_dts(mpp_packet, packet->dts);
+  mpp_packet_set_pts(mpp_packet, packet->pts);
+  if (!packet->data) {
+    mpp_packet_set_eos(mpp_packet);
+    DLOG(INFO) << "Send EOS to decoder";
+  }
+  ret = mpi_->decode_put_packet(ctx_, mpp_packet);
+  mpp_packet_deinit(&mpp_packet);
+  //解码器输入队列满了,和 ffmpeg 一样返回 EAGAIN
+  if (ret == MPP_ERR_BUFFER_FULL)
+    return AVERROR(EAGAIN);
+  return ret;
 }
 
 MppFrame RKMppDecoder::FetchOutput() {
+  TRACE_EVENT0("decoder", "RKMppDecoder::FetchOutput");
   if (!ctx_)
     return nullptr;
 
@@ -126,6 +148,7 @@ MppFrame RKMppDecoder::FetchOutput() {
     mpp_frame_deinit(&mppframe);
     return nullptr;
   }
+  TRACE_EVENT_FLOW_STEP0("media", "VideoFrame", mpp_frame_get_pts(mppframe));
   return mppframe;
 }
 
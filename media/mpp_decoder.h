@@ -3,6 +3,7 @@
 
 #include "base/macros.h"
 #include "base/time/time.h"
+#include "media/video_decoder.h"
 #include <rockchip/rk_mpi.h>
 #include <rockchip/mpp_buffer.h>
 #include <rockchip/mpp_packet.h>
@@ -11,21 +12,25 @@ namespace media {
 
 #define FRAMEGROUP_MAX_FRAMES   16
 
-class RKMppDecoder {
+class RKMppDecoder : public VideoDecoder {
 public:
  explicit RKMppDecoder(MppCodingType coding_type, size_t max_buffer_size = FRAMEGROUP_MAX_FRAMES);
 
  virtual ~RKMppDecoder();
 
- bool Init();
+ bool Init() override;
 
  void UnInit();
 
- int SendInput(MppPacket packet);
+ int SendInput(const AVPacket *packet) override;
 
- MppFrame FetchOutput();
+ MppFrame FetchOutput() override;
 
- int Flush();
+ int Flush() override;
+
+ bool NeedsAnnexB() const override { return true; }
+
+ const char *name() const override { return "mpp"; }
 
 private:
  MppCodingType coding_type_;
@@ -0,0 +1,496 @@
+#include "media/nal_unit.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace media {
+namespace {
+//H.264 的 slice(1~5),HEVC 的 VCL(0~31)
+bool IsH264Slice(int type) {
+  return type >= 1 && type <= 5;
+}
+
+bool IsHevcVcl(int type) {
+  return type >= 0 && type <= 31;
+}
+
+//TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N 以及保留的 RSV_VCL_N10/12/14
+bool IsHevcSubLayerNonReference(int type) {
+  return type <= 14 && type % 2 == 0;
+}
+
+//找到下一个起始码之后的位置,没有则返回 end
+const uint8_t *FindStartCode(const uint8_t *p, const uint8_t *end) {
+  for (; p + 3 <= end; ++p) {
+    if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+      return p + 3;
+  }
+  return end;
+}
+
+const int kH264NalSps = 7;
+const int kHevcNalVps = 32;
+const int kHevcNalSps = 33;
+
+//标准规定 DPB 最多 16 帧
+const int kMaxDpbFrames = 16;
+
+typedef std::vector<std::pair<const uint8_t *, int>> NalList;
+
+//去掉防竞争字节(00 00 03 中的 03)之后按位读取,读过头之后 ok() 为 false
+class BitReader {
+public:
+ BitReader(const uint8_t *data, int size) : pos_(0), ok_(true) {
+   data_.reserve(size);
+   int zeros = 0;
+   for (int i = 0; i < size; ++i) {
+     if (zeros >= 2 && data[i] == 3) {
+       zeros = 0;
+       continue;
+     }
+     zeros = data[i] == 0 ? zeros + 1 : 0;
+     data_.push_back(data[i]);
+   }
+ }
+
+ uint32_t ReadBits(int n) {
+   uint32_t value = 0;
+   for (int i = 0; i < n; ++i) {
+     if (pos_ >= data_.size() * 8) {
+       ok_ = false;
+       return 0;
+     }
+     value = (value << 1) | ((data_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1);
+     ++pos_;
+   }
+   return value;
+ }
+
+ void SkipBits(size_t n) {
+   pos_ += n;
+   if (pos_ > data_.size() * 8)
+     ok_ = false;
+ }
+
+ //ue(v) 指数哥伦布编码
+ uint32_t ReadUe() {
+   int zeros = 0;
+   while (ReadBits(1) == 0) {
+     if (!ok_ || ++zeros > 31) {
+       ok_ = false;
+       return 0;
+     }
+   }
+   return ((1u << zeros) - 1) + ReadBits(zeros);
+ }
+
+ int32_t ReadSe() {
+   uint32_t value = ReadUe();
+   return value & 1 ? static_cast<int32_t>((value + 1) / 2) : -static_cast<int32_t>(value / 2);
+ }
+
+ bool ok() const { return ok_; }
+
+private:
+ std::vector<uint8_t> data_;
+ size_t pos_;
+ bool ok_;
+};
+
+//avcC/hvcC 或者 Annex B 格式的 extradata 中的参数集
+NalList CollectParameterSets(const AVCodecParameters *par) {
+  NalList nals;
+  const uint8_t *p = par->extradata;
+  int size = par->extradata_size;
+  if (!p || size <= 0)
+    return nals;
+  if (p[0] != 1) {
+    NalUnitReader reader(p, size, 0);
+    const uint8_t *nal;
+    int nal_size;
+    while (reader.Next(&nal, &nal_size)) {
+      nals.push_back(std::make_pair(nal, nal_size));
+    }
+    return nals;
+  }
+  const uint8_t *end = p + size;
+  const uint8_t *pos;
+  int arrays;
+  if (par->codec_id == AV_CODEC_ID_H264) {
+    //avcC 的 SPS 直接跟在头后面,这里只需要 SPS
+    if (size < 6)
+      return nals;
+    arrays = 1;
+    pos = p + 5;
+  } else {
+    if (size < 23)
+      return nals;
+    arrays = p[22];
+    pos = p + 23;
+  }
+  for (int i = 0; i < arrays; ++i) {
+    int count;
+    if (par->codec_id == AV_CODEC_ID_H264) {
+      count = pos[0] & 0x1f;
+      pos += 1;
+    } else {
+      if (end - pos < 3)
+        return nals;
+      count = (pos[1] << 8) | pos[2];
+      pos += 3;
+    }
+    for (int j = 0; j < count; ++j) {
+      if (end - pos < 2)
+        return nals;
+      int length = (pos[0] << 8) | pos[1];
+      pos += 2;
+      if (length <= 0 || length > end - pos)
+        return nals;
+      nals.push_back(std::make_pair(pos, length));
+      pos += length;
+    }
+  }
+  return nals;
+}
+
+//level 对应的 MaxDpbMbs(H.264 表 A-1), level 9 是 level 1b
+int H264MaxDpbMbs(int level_idc) {
+  static const struct {
+    int level;
+    int max_dpb_mbs;
+  } kLevels[] = {
+      {9, 396}, {10, 396}, {11, 900}, {12, 2376}, {13, 2376}, {20, 2376}, {21, 4752},
+      {22, 8100}, {30, 8100}, {31, 18000}, {32, 20480}, {40, 32768}, {41, 32768},
+      {42, 34816}, {50, 110400}, {51, 184320}, {52, 184320}, {60, 696320},
+  };
+  for (const auto &level : kLevels) {
+    if (level_idc <= level.level)
+      return level.max_dpb_mbs;
+  }
+  return kLevels[sizeof(kLevels) / sizeof(kLevels[0]) - 1].max_dpb_mbs;
+}
+
+void SkipH264ScalingList(BitReader *reader, int size) {
+  int last_scale = 8;
+  int next_scale = 8;
+  for (int j = 0; j < size; ++j) {
+    if (next_scale != 0) {
+      int delta = reader->ReadSe();
+      next_scale = (last_scale + delta + 256) % 256;
+    }
+    last_scale = next_scale == 0 ? last_scale : next_scale;
+  }
+}
+
+bool SkipH264HrdParameters(BitReader *reader) {
+  int cpb_count = reader->ReadUe() + 1;
+  if (cpb_count > 32)
+    return false;
+  reader->SkipBits(8);
+  for (int i = 0; i < cpb_count; ++i) {
+    reader->ReadUe();
+    reader->ReadUe();
+    reader->SkipBits(1);
+  }
+  reader->SkipBits(20);
+  return reader->ok();
+}
+
+bool ParseH264Sps(const uint8_t *nal, int size, VideoReorderInfo *info) {
+  BitReader reader(nal + 1, size - 1);
+  int profile_idc = reader.ReadBits(8);
+  reader.SkipBits(8);
+  int level_idc = reader.ReadBits(8);
+  reader.ReadUe();
+  if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 || profile_idc == 244 ||
+      profile_idc == 44 || profile_idc == 83 || profile_idc == 86 || profile_idc == 118 ||
+      profile_idc == 128 || profile_idc == 138 || profile_idc == 139 || profile_idc == 134 ||
+      profile_idc == 135) {
+    int chroma_format_idc = reader.ReadUe();
+    if (chroma_format_idc == 3)
+      reader.SkipBits(1);
+    reader.ReadUe();
+    reader.ReadUe();
+    reader.SkipBits(1);
+    if (reader.ReadBits(1)) {
+      int lists = chroma_format_idc == 3 ? 12 : 8;
+      for (int i = 0; i < lists; ++i) {
+        if (reader.ReadBits(1))
+          SkipH264ScalingList(&reader, i < 6 ? 16 : 64);
+      }
+    }
+  }
+  reader.ReadUe();
+  int poc_type = reader.ReadUe();
+  if (poc_type == 0) {
+    reader.ReadUe();
+  } else if (poc_type == 1) {
+    reader.SkipBits(1);
+    reader.ReadSe();
+    reader.ReadSe();
+    uint32_t cycle = reader.ReadUe();
+    if (cycle > 255)
+      return false;
+    for (uint32_t i = 0; i < cycle; ++i) {
+      reader.ReadSe();
+    }
+  }
+  int max_num_ref_frames = reader.ReadUe();
+  reader.SkipBits(1);
+  int width_mbs = reader.ReadUe() + 1;
+  int height_map_units = reader.ReadUe() + 1;
+  int frame_mbs_only = reader.ReadBits(1);
+  if (!frame_mbs_only)
+    reader.SkipBits(1);
+  reader.SkipBits(1);
+  if (reader.ReadBits(1)) {
+    for (int i = 0; i < 4; ++i) {
+      reader.ReadUe();
+    }
+  }
+  if (!reader.ok())
+    return false;
+
+  //没有 bitstream_restriction 时的推导值
+  int frame_mbs = width_mbs * height_map_units * (2 - frame_mbs_only);
+  int dpb_frames = std::min(H264MaxDpbMbs(level_idc) / std::max(frame_mbs, 1), kMaxDpbFrames);
+  dpb_frames = std::max(dpb_frames, max_num_ref_frames);
+  info->max_dec_frame_buffering = dpb_frames;
+  //baseline 没有 B 帧, pic_order_cnt_type 2 的显示顺序就是解码顺序
+  info->num_reorder_frames = profile_idc == 66 || poc_type == 2 ? 0 : dpb_frames;
+
+  if (!reader.ReadBits(1))
+    return true;
+  if (reader.ReadBits(1)) {
+    if (reader.ReadBits(8) == 255)
+      reader.SkipBits(32);
+  }
+  if (reader.ReadBits(1))
+    reader.SkipBits(1);
+  if (reader.ReadBits(1)) {
+    reader.SkipBits(4);
+    if (reader.ReadBits(1))
+      reader.SkipBits(24);
+  }
+  if (reader.ReadBits(1)) {
+    reader.ReadUe();
+    reader.ReadUe();
+  }
+  if (reader.ReadBits(1))
+    reader.SkipBits(65);
+  int nal_hrd = reader.ReadBits(1);
+  if (nal_hrd && !SkipH264HrdParameters(&reader))
+    return true;
+  int vcl_hrd = reader.ReadBits(1);
+  if (vcl_hrd && !SkipH264HrdParameters(&reader))
+    return true;
+  if (nal_hrd || vcl_hrd)
+    reader.SkipBits(1);
+  reader.SkipBits(1);
+  if (!reader.ReadBits(1) || !reader.ok())
+    return true;
+  reader.SkipBits(1);
+  for (int i = 0; i < 4; ++i) {
+    reader.ReadUe();
+  }
+  int num_reorder_frames = reader.ReadUe();
+  int max_dec_frame_buffering = reader.ReadUe();
+  //VUI 损坏时保留推导值
+  if (!reader.ok() || max_dec_frame_buffering > kMaxDpbFrames || num_reorder_frames > max_dec_frame_buffering)
+    return true;
+  info->num_reorder_frames = num_reorder_frames;
+  info->max_dec_frame_buffering = std::max(max_dec_frame_buffering, 1);
+  return true;
+}
+
+void SkipHevcProfileTierLevel(BitReader *reader, int max_sub_layers_minus1) {
+  //general profile 88 位, general_level_idc 8 位
+  reader->SkipBits(96);
+  bool profile_present[8];
+  bool level_present[8];
+  for (int i = 0; i < max_sub_layers_minus1; ++i) {
+    profile_present[i] = reader->ReadBits(1);
+    level_present[i] = reader->ReadBits(1);
+  }
+  if (max_sub_layers_minus1 > 0) {
+    for (int i = max_sub_layers_minus1; i < 8; ++i) {
+      reader->SkipBits(2);
+    }
+  }
+  for (int i = 0; i < max_sub_layers_minus1; ++i) {
+    if (profile_present[i])
+      reader->SkipBits(88);
+    if (level_present[i])
+      reader->SkipBits(8);
+  }
+}
+
+//取最高 sub-layer 的值,也就是播放所有层时的值
+bool ReadHevcSubLayerOrdering(BitReader *reader, int max_sub_layers_minus1, VideoReorderInfo *info) {
+  bool all_layers = reader->ReadBits(1);
+  int max_dec_frame_buffering = 0;
+  int num_reorder_frames = 0;
+  for (int i = all_layers ? 0 : max_sub_layers_minus1; i <= max_sub_layers_minus1; ++i) {
+    max_dec_frame_buffering = reader->ReadUe() + 1;
+    num_reorder_frames = reader->ReadUe();
+    reader->ReadUe();
+  }
+  if (!reader->ok() || max_dec_frame_buffering > kMaxDpbFrames || num_reorder_frames > max_dec_frame_buffering)
+    return false;
+  info->max_dec_frame_buffering = max_dec_frame_buffering;
+  info->num_reorder_frames = num_reorder_frames;
+  return true;
+}
+
+bool ParseHevcSps(const uint8_t *nal, int size, VideoReorderInfo *info) {
+  if (size < 3)
+    return false;
+  BitReader reader(nal + 2, size - 2);
+  reader.SkipBits(4);
+  int max_sub_layers_minus1 = reader.ReadBits(3);
+  if (max_sub_layers_minus1 > 6)
+    return false;
+  reader.SkipBits(1);
+  SkipHevcProfileTierLevel(&reader, max_sub_layers_minus1);
+  reader.ReadUe();
+  if (reader.ReadUe() == 3)
+    reader.SkipBits(1);
+  reader.ReadUe();
+  reader.ReadUe();
+  if (reader.ReadBits(1)) {
+    for (int i = 0; i < 4; ++i) {
+      reader.ReadUe();
+    }
+  }
+  reader.ReadUe();
+  reader.ReadUe();
+  reader.ReadUe();
+  return ReadHevcSubLayerOrdering(&reader, max_sub_layers_minus1, info);
+}
+
+bool ParseHevcVps(const uint8_t *nal, int size, VideoReorderInfo *info) {
+  if (size < 3)
+    return false;
+  BitReader reader(nal + 2, size - 2);
+  reader.SkipBits(12);
+  int max_sub_layers_minus1 = reader.ReadBits(3);
+  if (max_sub_layers_minus1 > 6)
+    return false;
+  reader.SkipBits(17);
+  SkipHevcProfileTierLevel(&reader, max_sub_layers_minus1);
+  return ReadHevcSubLayerOrdering(&reader, max_sub_layers_minus1, info);
+}
+}
+
+bool ParseNalStreamInfo(const AVCodecParameters *par, NalStreamInfo *info) {
+  if (par->codec_id != AV_CODEC_ID_H264 && par->codec_id != AV_CODEC_ID_HEVC)
+    return false;
+  info->codec_id = par->codec_id;
+  info->length_size = 0;
+  info->max_temporal_id = 0;
+  const uint8_t *extradata = par->extradata;
+  int size = par->extradata_size;
+  //avcC/hvcC 的第一个字节是 configurationVersion = 1, Annex B 以起始码开头
+  if (!extradata || size < 7 || extradata[0] != 1)
+    return true;
+  if (par->codec_id == AV_CODEC_ID_H264) {
+    info->length_size = (extradata[4] & 0x3) + 1;
+  } else if (size >= 23) {
+    info->length_size = (extradata[21] & 0x3) + 1;
+    int temporal_layers = (extradata[21] >> 3) & 0x7;
+    info->max_temporal_id = temporal_layers > 0 ? temporal_layers - 1 : 0;
+  }
+  return true;
+}
+
+bool ParseVideoReorderInfo(const AVCodecParameters *par, VideoReorderInfo *info) {
+  if (par->codec_id != AV_CODEC_ID_H264 && par->codec_id != AV_CODEC_ID_HEVC)
+    return false;
+  //HEVC 优先用 SPS, VPS 中的值只是上限
+  VideoReorderInfo vps_info;
+  bool has_vps = false;
+  for (const auto &nal : CollectParameterSets(par)) {
+    if (nal.second < 2)
+      continue;
+    if (par->codec_id == AV_CODEC_ID_H264) {
+      if ((nal.first[0] & 0x1f) == kH264NalSps && ParseH264Sps(nal.first, nal.second, info))
+        return true;
+      continue;
+    }
+    int type = (nal.first[0] >> 1) & 0x3f;
+    if (type == kHevcNalSps && ParseHevcSps(nal.first, nal.second, info))
+      return true;
+    if (type == kHevcNalVps && !has_vps)
+      has_vps = ParseHevcVps(nal.first, nal.second, &vps_info);
+  }
+  if (!has_vps)
+    return false;
+  *info = vps_info;
+  return true;
+}
+
+NalUnitReader::NalUnitReader(const uint8_t *data, int size, int length_size)
+    : pos_(data),
+      end_(data + size),
+      length_size_(length_size) {
+  if (length_size_ == 0)
+    pos_ = FindStartCode(pos_, end_);
+}
+
+bool NalUnitReader::Next(const uint8_t **nal, int *nal_size) {
+  if (length_size_ > 0) {
+    if (end_ - pos_ < length_size_)
+      return false;
+    uint32_t length = 0;
+    for (int i = 0; i < length_size_; ++i) {
+      length = (length << 8) | pos_[i];
+    }
+    pos_ += length_size_;
+    if (length == 0 || length > static_cast<uint32_t>(end_ - pos_))
+      return false;
+    *nal = pos_;
+    *nal_size = static_cast<int>(length);
+    pos_ += length;
+    return true;
+  }
+  if (pos_ >= end_)
+    return false;
+  const uint8_t *next = FindStartCode(pos_, end_);
+  const uint8_t *nal_end = next == end_ ? end_ : next - 3;
+  //4 字节起始码前面多出来的 0
+  while (nal_end > pos_ && nal_end[-1] == 0 && next != end_)
+    --nal_end;
+  *nal = pos_;
+  *nal_size = static_cast<int>(nal_end - pos_);
+  pos_ = next;
+  return *nal_size > 0;
+}
+
+bool IsNonReferenceFrame(const NalStreamInfo &info, const uint8_t *data, int size) {
+  NalUnitReader reader(data, size, info.length_size);
+  const uint8_t *nal;
+  int nal_size;
+  bool has_picture = false;
+  while (reader.Next(&nal, &nal_size)) {
+    if (info.codec_id == AV_CODEC_ID_H264) {
+      int type = nal[0] & 0x1f;
+      if (!IsH264Slice(type))
+        continue;
+      if ((nal[0] >> 5) & 0x3)
+        return false;
+    } else {
+      if (nal_size < 2)
+        return false;
+      int type = (nal[0] >> 1) & 0x3f;
+      if (!IsHevcVcl(type))
+        continue;
+      //低层的 sub-layer non-reference 图像还可能被更高的 temporal 层参考
+      int temporal_id = (nal[1] & 0x7) - 1;
+      if (!IsHevcSubLayerNonReference(type) || temporal_id < info.max_temporal_id)
+        return false;
+    }
+    has_picture = true;
+  }
+  return has_picture;
+}
+}
@@ -0,0 +1,61 @@
+#ifndef MEDIA_NAL_UNIT_H_
+#define MEDIA_NAL_UNIT_H_
+
+#include <stdint.h>
+#include "media/ffmpeg_common.h"
+
+namespace media {
+
+/*
+ * H.264/HEVC 包的 NAL 单元解析
+ * mp4 中的包是长度前缀格式(avcC/hvcC),extradata 不是 avcC/hvcC 时按 Annex B 起始码格式处理
+ */
+struct NalStreamInfo {
+  AVCodecID codec_id;
+  // NAL 长度字段的字节数,0 表示 Annex B
+  int length_size;
+  // HEVC 的最大 temporal id(hvcC 中的 numTemporalLayers - 1)
+  int max_temporal_id;
+  NalStreamInfo() : codec_id(AV_CODEC_ID_NONE), length_size(0), max_temporal_id(0) {}
+};
+
+// 不是 H.264/HEVC 时返回 false
+bool ParseNalStreamInfo(const AVCodecParameters *par, NalStreamInfo *info);
+
+// 按顺序取出包中的 NAL 单元(不含长度字段或起始码)
+class NalUnitReader {
+public:
+ NalUnitReader(const uint8_t *data, int size, int length_size);
+
+ // 没有更多 NAL 单元或者数据损坏时返回 false
+ bool Next(const uint8_t **nal, int *nal_size);
+
+private:
+ const uint8_t *pos_;
+ const uint8_t *end_;
+ int length_size_;
+};
+
+// SPS(HEVC 还有 VPS)中与输出顺序和 DPB 大小有关的参数,-1 表示没有得到
+struct VideoReorderInfo {
+  // 解码顺序在前、显示顺序在后的最大帧数
+  // H.264 为 VUI 中的 max_num_reorder_frames, HEVC 为最高 sub-layer 的 sps_max_num_reorder_pics
+  int num_reorder_frames;
+  // 解码器需要保留的最大帧数
+  // H.264 为 VUI 中的 max_dec_frame_buffering, HEVC 为 sps_max_dec_pic_buffering_minus1 + 1
+  int max_dec_frame_buffering;
+  VideoReorderInfo() : num_reorder_frames(-1), max_dec_frame_buffering(-1) {}
+};
+
+// 解析 extradata(avcC/hvcC 或者 Annex B)中的参数集
+// H.264 没有 VUI bitstream_restriction 时按标准的推导: DPB 大小由 level 和分辨率算出,
+// pic_order_cnt_type 为 2 或者 baseline profile 时没有重排,否则重排帧数等于 DPB 大小
+// 不是 H.264/HEVC,或者找不到可以解析的参数集时返回 false
+bool ParseVideoReorderInfo(const AVCodecParameters *par, VideoReorderInfo *info);
+
+// 包中所有图像 NAL(VCL)都不会被其他帧参考时返回 true,丢掉它不影响后面的帧
+// H.264 为 nal_ref_idc == 0,HEVC 为最高 temporal 层的 sub-layer non-reference 图像
+bool IsNonReferenceFrame(const NalStreamInfo &info, const uint8_t *data, int size);
+}
+
+#endif //MEDIA_NAL_UNIT_H_
@@ -11,29 +11,185 @@ void PacketQueue::Init() {
   kFlushPkt.data = (uint8_t *) &kFlushPkt;
 }
 
-PacketQueue::PacketQueue() = default;
+PacketQueue::PacketQueue(AVStream *stream,
+                         const base::TimeDelta &max_duration,
+                         size_t max_bytes)
+    : stream_(stream),
+      max_duration_(max_duration),
+      max_bytes_(max_bytes),
+      bytes_(0),
+      peak_bytes_(0),
+      duration_(0),
+      abort_request_(false),
+      shutdown_(false),
+      serial_(0),
+      target_us_(AV_NOPTS_VALUE),
+      queued_flush_serial_(0),
+      queued_flush_target_(AV_NOPTS_VALUE),
+      popped_flush_serial_(0),
+      popped_flush_target_(AV_NOPTS_VALUE),
+      wakeups_(0),
+      observer_(nullptr),
+      not_full_cond_(&lock_),
+      not_empty_cond_(&lock_) {}
 
 PacketQueue::~PacketQueue() {
-  flush();
+  base::AutoLock l(lock_);
+  FreeAllPackets();
 }
 
-void PacketQueue::put(AVPacket *pkt) {
+bool PacketQueue::put(AVPacket *pkt) {
   base::AutoLock l(lock_);
+  if (pkt != &kFlushPkt) {
+    //队列满了,等待解码线程取走数据
+    while (!abort_request_ && !shutdown_ && is_full()) {
+      not_full_cond_.Wait();
+      ++wakeups_;
+    }
+    if (abort_request_ || shutdown_) {
+      av_packet_unref(pkt);
+      av_packet_free(&pkt);
+      return false;
+    }
+    bytes_ += pkt->size;
+    if (bytes_ > peak_bytes_)
+      peak_bytes_ = bytes_;
+    if (pkt->duration > 0)
+      duration_ += pkt->duration;
+  }
   incoming_packets_.push(pkt);
+  not_empty_cond_.Signal();
+  NotifyObserver();
+  return true;
 }
 
 AVPacket *PacketQueue::get() {
   base::AutoLock l(lock_);
+  return PopFront();
+}
+
+bool PacketQueue::wait_for_readable(const base::TimeDelta &timeout) {
+  base::AutoLock l(lock_);
+  base::TimeTicks deadline =
+      timeout.is_max() ? base::TimeTicks() : base::TimeTicks::Now() + timeout;
+  while (!shutdown_ && incoming_packets_.empty()) {
+    if (timeout.is_max()) {
+      not_empty_cond_.Wait();
+    } else {
+      base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+      if (remaining <= base::TimeDelta())
+        return false;
+      not_empty_cond_.TimedWait(remaining);
+    }
+    ++wakeups_;
+  }
+  return !shutdown_;
+}
+
+AVPacket *PacketQueue::PopFront() {
   if (incoming_packets_.empty())
     return nullptr;
   AVPacket *pkt = incoming_packets_.front();
   incoming_packets_.pop();
+  if (pkt != &kFlushPkt) {
+    bytes_ -= pkt->size;
+    if (pkt->duration > 0)
+      duration_ -= pkt->duration;
+    not_full_cond_.Signal();
+  } else {
+    popped_flush_serial_ = queued_flush_serial_;
+    popped_flush_target_ = queued_flush_target_;
+  }
   DLOG(INFO) << "PacketQueue size: " << incoming_packets_.size();
   return pkt;
 }
 
 void PacketQueue::flush() {
   base::AutoLock l(lock_);
+  FreeAllPackets();
+  abort_request_ = false;
+  queued_flush_serial_ = serial_;
+  queued_flush_target_ = target_us_;
+  //目标时间只对这一次 seek 有效,之后 rewind 的 flush 不能再丢帧
+  target_us_ = AV_NOPTS_VALUE;
+  incoming_packets_.push(&kFlushPkt);
+  not_full_cond_.Broadcast();
+  not_empty_cond_.Signal();
+  NotifyObserver();
+}
+
+void PacketQueue::abort() {
+  base::AutoLock l(lock_);
+  abort_request_ = true;
+  FreeAllPackets();
+  not_full_cond_.Broadcast();
+  NotifyObserver();
+}
+
+void PacketQueue::set_serial(int serial, int64_t target_us) {
+  base::AutoLock l(lock_);
+  serial_ = serial;
+  target_us_ = target_us;
+}
+
+int PacketQueue::flush_serial() {
+  base::AutoLock l(lock_);
+  return popped_flush_serial_;
+}
+
+int64_t PacketQueue::flush_target() {
+  base::AutoLock l(lock_);
+  return popped_flush_target_;
+}
+
+void PacketQueue::shutdown() {
+  base::AutoLock l(lock_);
+  shutdown_ = true;
+  not_full_cond_.Broadcast();
+  not_empty_cond_.Broadcast();
+  NotifyObserver();
+}
+
+void PacketQueue::set_observer(Observer *observer) {
+  base::AutoLock l(lock_);
+  observer_ = observer;
+}
+
+uint64_t PacketQueue::wakeups() {
+  base::AutoLock l(lock_);
+  return wakeups_;
+}
+
+size_t PacketQueue::bytes() {
+  base::AutoLock l(lock_);
+  return bytes_;
+}
+
+size_t PacketQueue::peak_bytes() {
+  base::AutoLock l(lock_);
+  return peak_bytes_;
+}
+
+base::TimeDelta PacketQueue::duration() {
+  base::AutoLock l(lock_);
+  return media::ConvertFromTimeBase(stream_->time_base, duration_);
+}
+
+bool PacketQueue::is_full() const {
+  //空队列总是可写的,否则一个超大的包会永远阻塞
+  if (incoming_packets_.empty())
+    return false;
+  if (bytes_ >= max_bytes_)
+    return true;
+  return media::ConvertFromTimeBase(stream_->time_base, duration_) >= max_duration_;
+}
+
+void PacketQueue::NotifyObserver() {
+  if (observer_)
+    observer_->OnPacketQueueChanged();
+}
+
+void PacketQueue::FreeAllPackets() {
   while (!incoming_packets_.empty()) {
     AVPacket *pkt = incoming_packets_.front();
     incoming_packets_.pop();
@@ -42,6 +198,7 @@ void PacketQueue::flush() {
       av_packet_free(&pkt);
     }
   }
-  incoming_packets_.push(&kFlushPkt);
+  bytes_ = 0;
+  duration_ = 0;
 }
 }
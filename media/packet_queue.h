@@ -6,33 +6,118 @@
 #include "base/macros.h"
 #include "base/time/time.h"
 #include "base/synchronization/lock.h"
+#include "base/synchronization/condition_variable.h"
 
 struct AVPacket;
+struct AVStream;
 
 namespace media {
 
+/*
+ * 解封装线程与解码线程之间的压缩包队列
+ * 队列按缓冲时长和字节数限制容量,超过任一限制时 put 会阻塞,直到解码线程取走数据,
+ * 或者调用 abort/flush 打断
+ * 解码线程用 wait_for_readable 阻塞等待新数据,flush 放入的 kFlushPkt 和 shutdown 都会唤醒它
+ */
 class PacketQueue {
 public:
+ // 队列有新的包,或者被 flush/abort/shutdown 时通知,在持有队列锁的时候调用
+ // 解码线程阻塞在别的地方(比如输出队列)时用它唤醒,不能在回调中再访问这个队列
+ class Observer {
+ public:
+  virtual ~Observer() {}
+  virtual void OnPacketQueueChanged() = 0;
+ protected:
+  Observer() {}
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Observer);
+ };
+
  static void Init();
 
- PacketQueue();
+ explicit PacketQueue(AVStream *stream,
+                      const base::TimeDelta &max_duration,
+                      size_t max_bytes);
 
  virtual ~PacketQueue();
 
- void put(AVPacket *pkt);
+ // 获得 pkt 的所有权,队列已满时阻塞;被 abort 打断时释放 pkt 并返回 false
+ bool put(AVPacket *pkt);
 
  AVPacket *get();
 
+ // 等待直到有数据可读,返回 false 表示超时或者已经 shutdown
+ // timeout 为 base::TimeDelta::Max() 时一直等待
+ bool wait_for_readable(const base::TimeDelta &timeout);
+
+ // 清空队列并放入 kFlushPkt,同时解除 abort 状态
+ // kFlushPkt 带上当前的 serial
  void flush();
 
+ // 唤醒阻塞在 put 上的线程,此后的 put 都会失败,直到下一次 flush
+ // 队列中已有的包(包括还没取走的 kFlushPkt)都已经过时,一并丢弃,解码线程不再为它们浪费时间
+ void abort();
+
+ // 设置之后 flush 放入的 kFlushPkt 对应的 seek 序号和精确 seek 的目标时间(微秒)
+ // target_us 为 AV_NOPTS_VALUE 时表示只 seek 到关键帧,解码线程不丢帧;目标时间只用于下一次 flush
+ void set_serial(int serial, int64_t target_us);
+
+ // 最近一次 get 取出的 kFlushPkt 对应的 serial 和目标时间,只能在取包的线程调用
+ int flush_serial();
+
+ int64_t flush_target();
+
+ // 停止使用队列,唤醒所有等待的线程,此后 put 失败,wait_for_readable 立即返回
+ void shutdown();
+
+ // nullptr 表示取消,返回之后旧的 observer 不会再被调用
+ void set_observer(Observer *observer);
+
+ // 等待线程被唤醒的次数
+ uint64_t wakeups();
+
+ size_t bytes();
+
+ // 队列中曾经缓冲的最大字节数
+ size_t peak_bytes();
+
+ base::TimeDelta duration();
+
 public:
  // this is special packet to mark a flush is needed
  // mainly for future use of seeking a video file
  static AVPacket kFlushPkt;
 
 private:
+ bool is_full() const;
+
+ AVPacket *PopFront();
+
+ void FreeAllPackets();
+
+ void NotifyObserver();
+
+ AVStream *stream_;
+ const base::TimeDelta max_duration_;
+ const size_t max_bytes_;
  std::queue<AVPacket *> incoming_packets_;
+ size_t bytes_;
+ size_t peak_bytes_;
+ int64_t duration_; //stream time base
+ bool abort_request_;
+ bool shutdown_;
+ int serial_;
+ int64_t target_us_;
+ // 队列中 kFlushPkt 的 serial/目标时间,以及最近取出的 kFlushPkt 的 serial/目标时间
+ int queued_flush_serial_;
+ int64_t queued_flush_target_;
+ int popped_flush_serial_;
+ int64_t popped_flush_target_;
+ uint64_t wakeups_;
+ Observer *observer_;
  base::Lock lock_;
+ base::ConditionVariable not_full_cond_;
+ base::ConditionVariable not_empty_cond_;
  DISALLOW_COPY_AND_ASSIGN(PacketQueue);
 };
 }
@@ -0,0 +1,111 @@
+#ifndef MEDIA_PLAYBACK_STATS_H_
+#define MEDIA_PLAYBACK_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace media {
+
+/*
+ * 播放过程中的统计信息,由 VideoPlayer 在 render 线程中定期更新
+ * 通过 VideoPlayer::GetStats 获取一份拷贝
+ */
+struct PlaybackStats {
+  // 解封装/解码线程在各个队列上等待后被唤醒的总次数
+  uint64_t wakeups;
+  // 最近一个统计周期内平均每秒的唤醒次数
+  double wakeups_per_second;
+  // 音视频包队列各自峰值字节数之和
+  size_t peak_packet_bytes;
+  // 解码后的音视频帧队列各自峰值字节数之和(视频帧按 MPP buffer 大小计算)
+  size_t peak_frame_bytes;
+  // 最近一个统计周期内,视频帧实际送出时间与理想显示时间之差的绝对值(微秒)
+  int64_t jitter_p50_us;
+  int64_t jitter_p99_us;
+  int64_t jitter_max_us;
+  // 最近 4096 帧从送入解码器到解码器输出的时间(微秒)
+  int64_t decode_p50_us;
+  int64_t decode_p99_us;
+  // 最近一个统计周期内,音频实际播放位置(由 AO 中剩余的 buffer 估计)与视频时钟之差的绝对值(微秒)
+  int64_t av_drift_p50_us;
+  int64_t av_drift_p99_us;
+  int64_t av_drift_max_us;
+  // 同上,从开始播放累计(分桶统计,分位数误差不超过 12.5%,max 是精确值)
+  int64_t run_jitter_p50_us;
+  int64_t run_jitter_p99_us;
+  int64_t run_jitter_max_us;
+  int64_t run_av_drift_p50_us;
+  int64_t run_av_drift_p99_us;
+  int64_t run_av_drift_max_us;
+  // ClockMode::kAudioMaster 下跟随音频时钟对基准时间的累计修正(微秒),反映声卡时钟与系统时钟的偏差
+  int64_t audio_clock_correction_us;
+  // ClockMode::kAudioMaster 下偏差过大直接对齐的次数
+  uint64_t audio_resyncs;
+  // 从开始播放到第一帧送出的时间(微秒),还没有送出时为 -1
+  int64_t ttff_us;
+  // 完成的 seek 次数,以及被后来的 seek 取代(没有解码出目标帧)的次数
+  uint64_t seeks;
+  uint64_t seeks_coalesced;
+  // 最近 4096 次 seek 从发起到目标位置第一帧送出的时间(微秒)
+  // seek_* 是 SeekMode::kKeyFrame,accurate_seek_* 是 SeekMode::kAccurate
+  int64_t seek_p50_us;
+  int64_t seek_p99_us;
+  int64_t accurate_seek_p50_us;
+  int64_t accurate_seek_p99_us;
+  // 精确 seek 时解码之后丢弃的视频帧数
+  uint64_t seek_discarded_frames;
+  // 无缝循环回到开头的次数(包括从解码帧缓存重放的次数)
+  uint64_t loops;
+  // 解码帧缓存占用的字节数,没有启用或者已经放弃时为 0
+  size_t clip_cache_bytes;
+  // 从解码帧缓存重放的音视频帧数,大于 0 说明解码线程已经停止解码
+  uint64_t clip_cache_hits;
+  // 同一次 render 中已经被更新的帧取代,没有显示就丢掉的视频帧数
+  uint64_t frames_dropped;
+  // 渲染持续落后时没有送入解码器的不参考帧数
+  uint64_t frames_skipped;
+  // 当前的播放速度
+  double playback_rate;
+  // 变速时音频 time stretch 累计占用的时间(微秒)
+  int64_t audio_stretch_us;
+
+  PlaybackStats()
+      : wakeups(0),
+        wakeups_per_second(0),
+        peak_packet_bytes(0),
+        peak_frame_bytes(0),
+        jitter_p50_us(0),
+        jitter_p99_us(0),
+        jitter_max_us(0),
+        decode_p50_us(0),
+        decode_p99_us(0),
+        av_drift_p50_us(0),
+        av_drift_p99_us(0),
+        av_drift_max_us(0),
+        run_jitter_p50_us(0),
+        run_jitter_p99_us(0),
+        run_jitter_max_us(0),
+        run_av_drift_p50_us(0),
+        run_av_drift_p99_us(0),
+        run_av_drift_max_us(0),
+        audio_clock_correction_us(0),
+        audio_resyncs(0),
+        ttff_us(-1),
+        seeks(0),
+        seeks_coalesced(0),
+        seek_p50_us(0),
+        seek_p99_us(0),
+        accurate_seek_p50_us(0),
+        accurate_seek_p99_us(0),
+        seek_discarded_frames(0),
+        loops(0),
+        clip_cache_bytes(0),
+        clip_cache_hits(0),
+        frames_dropped(0),
+        frames_skipped(0),
+        playback_rate(1.0),
+        audio_stretch_us(0) {}
+};
+}
+
+#endif //MEDIA_PLAYBACK_STATS_H_
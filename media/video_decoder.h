@@ -0,0 +1,51 @@
+#ifndef MEDIA_VIDEO_DECODER_H_
+#define MEDIA_VIDEO_DECODER_H_
+
+#include <stddef.h>
+#include "base/macros.h"
+#include "media/ffmpeg_common.h"
+#include <rockchip/mpp_frame.h>
+
+namespace media {
+
+enum class VideoDecoderType {
+ // 优先使用 MPP 硬解,失败时退回到 ffmpeg 软解
+ kAuto,
+ kMpp,
+ kFFmpeg,
+};
+
+/*
+ * 视频解码器接口
+ * 输入的 AVPacket 时间戳单位为微秒, data 为空表示 EOS
+ * 输出统一为 MppFrame(时间戳单位为微秒),渲染端不用关心是硬解还是软解
+ * 解码器输出 eos 帧之后,要调用 Flush 才能继续解码
+ */
+class VideoDecoder {
+public:
+ virtual ~VideoDecoder() {}
+
+ virtual bool Init() = 0;
+
+ // 返回 0 表示已经接收, AVERROR(EAGAIN) 表示需要先取走输出帧再重新送入, 其他负数为错误
+ virtual int SendInput(const AVPacket *packet) = 0;
+
+ // 没有输出时返回 nullptr
+ virtual MppFrame FetchOutput() = 0;
+
+ virtual int Flush() = 0;
+
+ // H.264/HEVC 是否需要先转换成 Annex B 格式
+ virtual bool NeedsAnnexB() const = 0;
+
+ virtual const char *name() const = 0;
+
+protected:
+ VideoDecoder() {}
+
+private:
+ DISALLOW_COPY_AND_ASSIGN(VideoDecoder);
+};
+}
+
+#endif //MEDIA_VIDEO_DECODER_H_
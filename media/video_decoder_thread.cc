@@ -2,33 +2,55 @@
 #include "media/video_decoder_thread.h"
 #include "media/mp4_dataset.h"
 #include "media/mpp_decoder.h"
+#include "media/ffmpeg_video_decoder.h"
 #include "media/video_frame_queue.h"
 #include "media/packet_queue.h"
 #include "media/video_player.h"
+#include "media/decoded_clip_cache.h"
+#include "media/media_constants.h"
 
 namespace media {
 
 VideoDecoderThread::VideoDecoderThread(VideoPlayer *player,
                                        Mp4Dataset *dataset,
                                        PacketQueue *input_queue,
-                                       VideoFrameQueue *output_queue)
+                                       VideoFrameQueue *output_queue,
+                                       VideoDecoderType decoder_type,
+                                       DecodedClipCache *clip_cache)
     : player_(player),
       dataset_(dataset),
       input_queue_(input_queue),
       output_queue_(output_queue),
+      decoder_type_(decoder_type),
+      clip_cache_(clip_cache),
+      pending_packet_(nullptr),
+      replay_pending_(false),
       avbsf_(nullptr),
       next_pts_(0),
+      eos_sent_(false),
+      discard_before_(AV_NOPTS_VALUE),
       keep_running_(true),
+      seek_discarded_frames_(0),
+      skipped_frames_(0),
+      nal_parsable_(false),
+      skip_non_reference_(false),
       thread_(new base::DelegateSimpleThread(this, "VDThread")) {
   thread_->Start();
 }
 
 VideoDecoderThread::~VideoDecoderThread() {
   keep_running_ = false;
+  //唤醒阻塞在队列上的解码线程
+  input_queue_->shutdown();
+  output_queue_->shutdown();
   if (thread_) {
     thread_->Join();
     thread_.reset();
   }
+  if (pending_packet_ && pending_packet_ != &PacketQueue::kFlushPkt) {
+    av_packet_unref(pending_packet_);
+    av_packet_free(&pending_packet_);
+  }
 }
 
 void VideoDecoderThread::Run() {
@@ -45,29 +67,54 @@ void VideoDecoderThread::InitDecoder() {
     coding_type = MPP_VIDEO_CodingHEVC;
   } else if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
     coding_type = MPP_VIDEO_CodingAVC;
-  } else {
+  } else if (decoder_type_ == VideoDecoderType::kMpp) {
     player_->OnMediaError(Error_VideoCodecUnsupported);
     return;
   }
 
+  //MPP 的 buffer: 解码器参考和等待输出的帧(DPB),输出队列中的帧,正在解码的帧和 UI 正在显示的帧
+  //输出队列中的帧可能同时还在 DPB 中,这里按最坏情况相加,保证解码器永远拿得到 buffer
+  //SPS 中没有 DPB 大小时按标准的最大值
+  VideoReorderInfo reorder_info;
+  size_t dpb_frames = FRAMEGROUP_MAX_FRAMES;
+  if (ParseVideoReorderInfo(stream->codecpar, &reorder_info) && reorder_info.max_dec_frame_buffering > 0)
+    dpb_frames = static_cast<size_t>(reorder_info.max_dec_frame_buffering);
   size_t buffer_size = output_queue_->max_size();
-  if (buffer_size < FRAMEGROUP_MAX_FRAMES) {
-    buffer_size = FRAMEGROUP_MAX_FRAMES;
+  LOG(INFO) << "video dpb frames:" << dpb_frames << ", output frames:" << buffer_size;
+  std::unique_ptr<VideoDecoder> decoder;
+  if (decoder_type_ != VideoDecoderType::kFFmpeg && coding_type != MPP_VIDEO_CodingUnused) {
+    decoder.reset(new RKMppDecoder(coding_type, buffer_size + dpb_frames + kMppExtraFrames));
+    if (!decoder->Init()) {
+      LOG(WARNING) << "create mpp video decoder failed";
+      decoder.reset();
+    }
+  }
+  //MPP 不可用或者不支持这个码流,退回到软解
+  if (!decoder && decoder_type_ != VideoDecoderType::kMpp) {
+    //软解的参考帧在 ffmpeg 自己的内存中,mpp buffer 只用来输出
+    decoder.reset(new FFmpegVideoDecoder(stream, buffer_size + kMppExtraFrames));
+    if (!decoder->Init()) {
+      LOG(WARNING) << "create ffmpeg video decoder failed";
+      decoder.reset();
+    }
   }
-  std::unique_ptr<RKMppDecoder> decoder(new RKMppDecoder(coding_type, buffer_size + 2));
-  if (decoder->Init()) {
-    decoder_ = std::move(decoder);
-  } else {
+  if (!decoder) {
     LOG(ERROR) << "create video decoder failed";
-    player_->OnMediaError(Error_VideoCodecCreateFailed);
+    player_->OnMediaError(coding_type == MPP_VIDEO_CodingUnused ? Error_VideoCodecUnsupported
+                                                                : Error_VideoCodecCreateFailed);
+    return;
   }
+  LOG(INFO) << "video decoder: " << decoder->name();
+  decoder_ = std::move(decoder);
+  nal_parsable_ = ParseNalStreamInfo(stream->codecpar, &nal_info_);
+
   std::string bsf_name;
   if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
     bsf_name = "h264_mp4toannexb";
   } else if (stream->codecpar->codec_id == AV_CODEC_ID_HEVC) {
     bsf_name = "hevc_mp4toannexb";
   }
-  if (!bsf_name.empty()) {
+  if (!bsf_name.empty() && decoder_->NeedsAnnexB()) {
     const struct AVBitStreamFilter *bsfptr = av_bsf_get_by_name(bsf_name.c_str());
     av_bsf_alloc(bsfptr, &avbsf_);
     avcodec_parameters_copy(avbsf_->par_in, stream->codecpar);
@@ -80,6 +127,7 @@ void VideoDecoderThread::InitDecoder() {
 }
 
 void VideoDecoderThread::UnInitDecoder() {
+  output_queue_->invalidate();
   output_queue_->flush();
   decoder_.reset();
   if (avbsf_) {
@@ -101,9 +149,12 @@ void VideoDecoderThread::DecodeLoop() {
         if (decoder_) {
           decoder_->Flush();
         }
-        output_queue_->flush();
+        output_queue_->invalidate();
         next_pts_ = 0;
-        player_->OnFlushCompleted(dataset_->getVideoStreamIndex());
+        eos_sent_ = false;
+        decode_start_.clear();
+        discard_before_ = input_queue_->flush_target();
+        player_->OnFlushCompleted(dataset_->getVideoStreamIndex(), input_queue_->flush_serial());
         continue;
       }
 
@@ -111,7 +162,13 @@ void VideoDecoderThread::DecodeLoop() {
         //读到文件末尾了,我们需要将 end of stream packet 写入解码器
         //并等待解码器输出 eos帧,则说明解码器已经输出所有的帧,此刻可以正常关闭解码器
         DLOG(INFO) << "Got video EOS packet";
+        eos_sent_ = true;
         SendInput(pkt, &eos_reached);
+      } else if (ShouldSkipPacket(pkt)) {
+        av_packet_unref(pkt);
+        av_packet_free(&pkt);
+        base::AutoLock l(stats_lock_);
+        ++skipped_frames_;
       } else {
         if (avbsf_) {
           //H264,H265要处理之后才能送到解码器
@@ -130,34 +187,75 @@ void VideoDecoderThread::DecodeLoop() {
       }
     } else {
       if (!ProcessOneOutputBuffer(&eos_reached)) {
-        usleep(5000);
+        //没有数据包也没有输出帧,阻塞等待新的数据包
+        //只有送入 EOS 之后,解码器还在吐剩余的帧,才需要定时去取
+        base::TimeDelta timeout = eos_sent_
+                                  ? base::TimeDelta::FromMicroseconds(kDecoderDrainPollDelay)
+                                  : base::TimeDelta::Max();
+        input_queue_->wait_for_readable(timeout);
       }
     }
     if (eos_reached) {
+      eos_sent_ = false;
       decoder_->Flush();
     }
+    if (replay_pending_) {
+      replay_pending_ = false;
+      ReplayFromCache();
+    }
   }
 }
 
+void VideoDecoderThread::GetDecodeLatency(int64_t *p50_us, int64_t *p99_us) {
+  base::AutoLock l(stats_lock_);
+  *p50_us = decode_latency_.Percentile(50);
+  *p99_us = decode_latency_.Percentile(99);
+}
+
+void VideoDecoderThread::SetSkipNonReference(bool skip) {
+  skip_non_reference_ = skip;
+}
+
+uint64_t VideoDecoderThread::skipped_frames() {
+  base::AutoLock l(stats_lock_);
+  return skipped_frames_;
+}
+
+bool VideoDecoderThread::ShouldSkipPacket(const AVPacket *pkt) {
+  if (!skip_non_reference_ || !nal_parsable_)
+    return false;
+  //填充中的解码帧缓存要完整的一遍
+  if (clip_cache_ && clip_cache_->filling())
+    return false;
+  return IsNonReferenceFrame(nal_info_, pkt->data, pkt->size);
+}
+
+uint64_t VideoDecoderThread::seek_discarded_frames() {
+  base::AutoLock l(stats_lock_);
+  return seek_discarded_frames_;
+}
+
 void VideoDecoderThread::SendInput(AVPacket *pkt, bool *eos_reached) {
-  MppPacket mpp_packet = MakeMppPacket(pkt);
-  if (mpp_packet) {
-    DecodePacket(mpp_packet, eos_reached);
-    mpp_packet_deinit(&mpp_packet);
+  ConvertTimestamps(pkt);
+  if (pkt->data && pkt->pts != static_cast<int64_t>(AV_NOPTS_VALUE)) {
+    decode_start_[pkt->pts] = base::TimeTicks::Now();
+    //解码器丢弃的包永远等不到输出,限制跟踪的数量
+    if (decode_start_.size() > kMaxPendingDecodeSamples)
+      decode_start_.erase(decode_start_.begin());
   }
+  DecodePacket(pkt, eos_reached);
   av_packet_unref(pkt);
   av_packet_free(&pkt);
 }
 
 AVPacket *VideoDecoderThread::FetchPacket() {
-  AVPacket *pkt = input_queue_->get();
-  while (!pkt) {
-    DemuxResult result = dataset_->demuxNextPacket();
-    if (result != DemuxResult::OK)
-      break; //AV_EOF or UNKNOWN
-    pkt = input_queue_->get();
+  if (pending_packet_) {
+    AVPacket *pkt = pending_packet_;
+    pending_packet_ = nullptr;
+    return pkt;
   }
-  return pkt;
+  //数据由 DemuxThread 写入,这里只负责取
+  return input_queue_->get();
 }
 
 bool VideoDecoderThread::ProcessOneOutputBuffer(bool *eos_reached) {
@@ -178,18 +276,18 @@ bool VideoDecoderThread::ProcessOneOutputBuffer(bool *eos_reached) {
   return true;
 }
 
-bool VideoDecoderThread::DecodePacket(MppPacket mpp_packet, bool *eos_reached) {
+bool VideoDecoderThread::DecodePacket(const AVPacket *packet, bool *eos_reached) {
   if (!decoder_)
     return false;
 
   bool sent_packet = false, frames_remaining = true;
   while (!sent_packet || frames_remaining) {
     if (!sent_packet) {
-      const int result = decoder_->SendInput(mpp_packet);
-      if (result < 0 && result != MPP_ERR_BUFFER_FULL) {
+      const int result = decoder_->SendInput(packet);
+      if (result < 0 && result != AVERROR(EAGAIN)) {
         return false;
       }
-      sent_packet = (result != MPP_ERR_BUFFER_FULL);
+      sent_packet = (result != AVERROR(EAGAIN));
     }
 
     MppFrame frame = decoder_->FetchOutput();
@@ -209,8 +307,21 @@ bool VideoDecoderThread::DecodePacket(MppPacket mpp_packet, bool *eos_reached) {
   return true;
 }
 
+void VideoDecoderThread::RecordDecodeLatency(int64_t pts) {
+  auto iter = decode_start_.find(pts);
+  if (iter == decode_start_.end())
+    return;
+  int64_t latency = (base::TimeTicks::Now() - iter->second).InMicroseconds();
+  decode_start_.erase(iter);
+  base::AutoLock l(stats_lock_);
+  decode_latency_.Add(latency);
+}
+
 bool VideoDecoderThread::SendFrame(MppFrame frame) {
+  if (mpp_frame_get_eos(frame) && OnEndOfStream())
+    return false;
   int64_t pts = mpp_frame_get_pts(frame);
+  RecordDecodeLatency(pts);
   if (pts == static_cast<int64_t>(AV_NOPTS_VALUE)) {
     pts = next_pts_;
     mpp_frame_set_pts(frame, pts);
@@ -219,42 +330,82 @@ bool VideoDecoderThread::SendFrame(MppFrame frame) {
     next_pts_ = pts + frame_duration_.InMicroseconds();
   }
 
-  while (keep_running_) {
-    if (!output_queue_->is_writable()) {
-      usleep(5000);
-      continue;
+  //精确 seek: 从关键帧开始解码,显示区间在目标之前的帧不进输出队列
+  //输出按显示顺序,第一个到达目标的帧之后就不用再检查了
+  if (discard_before_ != static_cast<int64_t>(AV_NOPTS_VALUE) && !mpp_frame_get_eos(frame)) {
+    if (pts != static_cast<int64_t>(AV_NOPTS_VALUE) && next_pts_ <= discard_before_) {
+      base::AutoLock l(stats_lock_);
+      ++seek_discarded_frames_;
+      return false;
     }
-    output_queue_->put(frame);
-    return true;
+    discard_before_ = AV_NOPTS_VALUE;
   }
-  return false;
+
+  if (clip_cache_ && !mpp_frame_get_eos(frame) && !clip_cache_->AddVideoFrame(frame)) {
+    player_->OnClipCacheDisabled();
+  }
+
+  //输出队列满的时候阻塞,render 取走数据或者 flush 都会唤醒
+  if (!keep_running_ || !output_queue_->wait_for_writable(base::TimeDelta::Max()))
+    return false;
+  output_queue_->put(frame);
+  return true;
+}
+
+bool VideoDecoderThread::OnEndOfStream() {
+  if (!clip_cache_)
+    return false;
+  clip_cache_->MarkComplete(DecodedClipCache::kVideo);
+  //音频可能还没解码完,等它一起封存
+  if (!clip_cache_->WaitSealed() || clip_cache_->video_frame_count() == 0)
+    return false;
+  replay_pending_ = true;
+  return true;
+}
+
+void VideoDecoderThread::ReplayFromCache() {
+  DLOG(INFO) << "Replay video from clip cache";
+  //输出队列满时一直阻塞,输入队列有新的包才唤醒,暂停时没有定时唤醒
+  input_queue_->set_observer(this);
+  int64_t offset = 0;
+  bool replaying = true;
+  while (replaying && keep_running_) {
+    offset += clip_cache_->clip_length();
+    for (size_t i = 0; i < clip_cache_->video_frame_count(); ++i) {
+      //seek 时会收到 flush 包,交给 DecodeLoop 处理
+      if (!WaitForReplayWritable()) {
+        replaying = false;
+        break;
+      }
+      MppFrame frame = clip_cache_->MakeVideoFrame(i, offset);
+      output_queue_->put(frame);
+    }
+  }
+  input_queue_->set_observer(nullptr);
 }
 
-MppPacket VideoDecoderThread::MakeMppPacket(AVPacket *packet) {
-  MppPacket mpp_packet = nullptr;
-  MPP_RET ret = mpp_packet_init(&mpp_packet, packet->data, packet->size);
-  if (ret != MPP_OK) {
-    LOG(ERROR) << "mpp_packet_init failed, ret: " << ret;
-    return nullptr;
+bool VideoDecoderThread::WaitForReplayWritable() {
+  while (keep_running_) {
+    pending_packet_ = input_queue_->get();
+    if (pending_packet_)
+      return false;
+    if (output_queue_->wait_for_writable_or_interrupted())
+      return true;
   }
+  return false;
+}
+
+void VideoDecoderThread::OnPacketQueueChanged() {
+  output_queue_->interrupt_writer();
+}
 
+void VideoDecoderThread::ConvertTimestamps(AVPacket *packet) {
+  AVRational time_base = dataset_->getVideoStream()->time_base;
   if (packet->dts != static_cast<int64_t>(AV_NOPTS_VALUE)) {
-    auto dts = media::ConvertFromTimeBase(dataset_->getVideoStream()->time_base, packet->dts);
-    mpp_packet_set_dts(mpp_packet, dts.InMicroseconds());
-  } else {
-    mpp_packet_set_dts(mpp_packet, packet->dts);
+    packet->dts = media::ConvertFromTimeBase(time_base, packet->dts).InMicroseconds();
   }
   if (packet->pts != static_cast<int64_t>(AV_NOPTS_VALUE)) {
-    auto pts = media::ConvertFromTimeBase(dataset_->getVideoStream()->time_base, packet->pts);
-    mpp_packet_set_pts(mpp_packet, pts.InMicroseconds());
-  } else {
-    mpp_packet_set_pts(mpp_packet, packet->pts);
+    packet->pts = media::ConvertFromTimeBase(time_base, packet->pts).InMicroseconds();
   }
-
-  if (!packet->data) {
-    mpp_packet_set_eos(mpp_packet);
-    DLOG(INFO) << "Send EOS to decoder";
-  }
-  return mpp_packet;
 }
-}
\ No newline at end of file
+}
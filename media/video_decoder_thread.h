@@ -1,34 +1,57 @@
 ﻿#ifndef MEDIA_VIDEO_DECODER_THREAD_H_
 #define MEDIA_VIDEO_DECODER_THREAD_H_
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include "base/macros.h"
 #include "base/threading/simple_thread.h"
 #include "base/synchronization/lock.h"
+#include "base/metrics/sample_stats.h"
 #include "media/ffmpeg_common.h"
+#include "media/packet_queue.h"
+#include "media/video_decoder.h"
+#include "media/nal_unit.h"
 #include <rkmedia/rkmedia_api.h>
-#include <rockchip/mpp_packet.h>
 
 namespace media {
 class Mp4Dataset;
-class PacketQueue;
+class DecodedClipCache;
 class VideoFrameQueue;
-class RKMppDecoder;
 class VideoPlayer;
 
 class VideoDecoderThread
-    : public base::DelegateSimpleThread::Delegate {
+    : public base::DelegateSimpleThread::Delegate,
+      public PacketQueue::Observer {
 public:
  explicit VideoDecoderThread(VideoPlayer *player,
                              Mp4Dataset *dataset,
                              PacketQueue *input_queue,
-                             VideoFrameQueue *output_queue);
+                             VideoFrameQueue *output_queue,
+                             VideoDecoderType decoder_type,
+                             DecodedClipCache *clip_cache);
 
  virtual ~VideoDecoderThread() override;
 
+ // 可以在任意线程调用
+ void GetDecodeLatency(int64_t *p50_us, int64_t *p99_us);
+
+ // 精确 seek 时在目标之前解码出来又丢弃的帧数,可以在任意线程调用
+ uint64_t seek_discarded_frames();
+
+ // 渲染持续落后时打开: 不参考的帧(H.264 nal_ref_idc 为 0,HEVC 的 sub-layer non-reference)不送入解码器
+ // 可以在任意线程调用,从下一个包开始生效
+ void SetSkipNonReference(bool skip);
+
+ // 因为 SetSkipNonReference 没有解码的帧数,可以在任意线程调用
+ uint64_t skipped_frames();
+
 private:
  void Run() override;
 
+ // 重放时由操作输入队列的线程调用,唤醒阻塞在输出队列上的解码线程
+ void OnPacketQueueChanged() override;
+
  void InitDecoder();
 
  void UnInitDecoder();
@@ -39,23 +62,56 @@ private:
 
  bool ProcessOneOutputBuffer(bool *eos_reached);
 
- bool DecodePacket(MppPacket mpp_packet, bool *eos_reached);
+ bool DecodePacket(const AVPacket *packet, bool *eos_reached);
 
- MppPacket MakeMppPacket(AVPacket *packet);
+ // 把包的时间戳从 stream time base 转换为微秒
+ void ConvertTimestamps(AVPacket *packet);
 
  bool SendFrame(MppFrame frame);
 
+ // 解码器输出了 EOS 帧,缓存封存之后返回 true,EOS 帧不再送出,改为从缓存重放
+ bool OnEndOfStream();
+
+ // 从缓存循环重放,直到收到新的包(flush)或者退出
+ void ReplayFromCache();
+
+ // 输出队列满时等待,期间收到新的包时返回 false
+ bool WaitForReplayWritable();
+
+ void RecordDecodeLatency(int64_t pts);
+
  void SendInput(AVPacket *pkt, bool *eos_reached);
 
+ // 是否跳过这个包(在转换为 Annex B 之前)
+ bool ShouldSkipPacket(const AVPacket *pkt);
+
  VideoPlayer *player_;
  Mp4Dataset *dataset_;
  PacketQueue *input_queue_;
  VideoFrameQueue *output_queue_;
+ VideoDecoderType decoder_type_;
+ DecodedClipCache *clip_cache_;
+ // 重放时取到的包,下一次 FetchPacket 返回
+ AVPacket *pending_packet_;
+ bool replay_pending_;
  AVBSFContext *avbsf_;
  int64_t next_pts_;
+ bool eos_sent_;
  base::TimeDelta frame_duration_;
+ // 精确 seek 的目标时间(微秒),显示时间在这之前的帧直接丢弃,AV_NOPTS_VALUE 表示不丢
+ int64_t discard_before_;
  bool keep_running_;
- std::unique_ptr<RKMppDecoder> decoder_;
+ // 已送入解码器,还没有输出的包的 pts 和送入时间
+ std::map<int64_t, base::TimeTicks> decode_start_;
+ base::Lock stats_lock_;
+ base::SampleStats decode_latency_;
+ uint64_t seek_discarded_frames_;
+ uint64_t skipped_frames_;
+ // 码流不是 H.264/HEVC 时为 false,不跳帧
+ bool nal_parsable_;
+ NalStreamInfo nal_info_;
+ std::atomic<bool> skip_non_reference_;
+ std::unique_ptr<VideoDecoder> decoder_;
  std::unique_ptr<base::DelegateSimpleThread> thread_;
  DISALLOW_COPY_AND_ASSIGN(VideoDecoderThread);
 };
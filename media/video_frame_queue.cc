@@ -1,76 +1,170 @@
 #include "base/logging.h"
+#include "base/trace_event/trace_event.h"
 #include "media/video_frame_queue.h"
 #include "media/ffmpeg_common.h"
-#include "base/logging.h"
 
 namespace media {
-VideoFrameQueue::VideoFrameQueue(AVStream *stream, size_t max_size)
+namespace {
+size_t FrameBytes(MppFrame frame) {
+  MppBuffer buffer = mpp_frame_get_buffer(frame);
+  return buffer ? mpp_buffer_get_size(buffer) : 0;
+}
+
+void ReleaseFrame(MppFrame frame) {
+  mpp_frame_deinit(&frame);
+}
+
+size_t RingCapacity(size_t max_size, size_t reorder_depth) {
+  return max_size > reorder_depth ? max_size - reorder_depth : 1;
+}
+}
+
+VideoFrameQueue::VideoFrameQueue(AVStream *stream, size_t max_size, size_t reorder_depth)
     : stream_(stream),
-      max_size_(max_size) {}
+      max_size_(max_size),
+      reorder_depth_(reorder_depth),
+      ring_(RingCapacity(max_size, reorder_depth), ReleaseFrame, FrameBytes) {
+  window_.reserve(reorder_depth + 1);
+}
 
 VideoFrameQueue::~VideoFrameQueue() {
-  flush();
+  ReleaseWindow();
 }
 
-bool VideoFrameQueue::is_writable() {
-  base::AutoLock l(lock_);
-  return frame_list_.size() < max_size_;
+bool VideoFrameQueue::wait_for_writable(const base::TimeDelta &timeout) {
+  return ring_.wait_for_writable(timeout);
 }
 
-int64_t VideoFrameQueue::startTimestamp() {
-  base::AutoLock l(lock_);
-  if (frame_list_.empty())
-    return AV_NOPTS_VALUE;
-  return frame_list_.begin()->first;
+bool VideoFrameQueue::wait_for_writable_or_interrupted() {
+  return ring_.wait_for_writable_or_interrupted();
 }
 
 void VideoFrameQueue::put(MppFrame frame) {
-  base::AutoLock l(lock_);
+  TRACE_EVENT1("queue", "VideoFrameQueue::put", "pts", mpp_frame_get_pts(frame));
+  if (mpp_frame_get_eos(frame)) {
+    //EOS 之后不会再有更早的帧,窗口中的帧全部按顺序放入
+    for (MppFrame f : window_) {
+      ring_.SubBytes(FrameBytes(f));
+      PushToRing(f, false);
+    }
+    window_.clear();
+    PushToRing(frame, true);
+    return;
+  }
+
   int64_t pts = mpp_frame_get_pts(frame);
-  auto iter = frame_list_.find(pts);
-  if (iter != frame_list_.end()) {
+  TRACE_EVENT_FLOW_STEP0("media", "VideoFrame", pts);
+  size_t bytes = FrameBytes(frame);
+  auto iter = window_.end();
+  while (iter != window_.begin() && mpp_frame_get_pts(*(iter - 1)) > pts) {
+    --iter;
+  }
+  if (iter != window_.begin() && mpp_frame_get_pts(*(iter - 1)) == pts) {
     //可能存在 PTS 重复,我们把早期的销毁,保存后来的帧
-    mpp_frame_deinit(&iter->second);
-    frame_list_.erase(iter);
+    ring_.SubBytes(FrameBytes(*(iter - 1)));
+    ReleaseFrame(*(iter - 1));
+    *(iter - 1) = frame;
+    ring_.AddBytes(bytes);
+    return;
   }
-  frame_list_.insert(std::make_pair(pts, frame));
+  window_.insert(iter, frame);
+  ring_.AddBytes(bytes);
+  if (window_.size() > reorder_depth_) {
+    MppFrame first = window_.front();
+    window_.erase(window_.begin());
+    ring_.SubBytes(FrameBytes(first));
+    PushToRing(first, false);
+  }
+}
+
+void VideoFrameQueue::invalidate() {
+  ReleaseWindow();
+  ring_.Invalidate();
+}
+
+bool VideoFrameQueue::is_writable() {
+  ring_.Front(nullptr);
+  return ring_.size() < ring_.capacity();
+}
+
+bool VideoFrameQueue::wait_for_readable(const base::TimeDelta &timeout) {
+  return ring_.wait_for_readable(timeout);
+}
+
+int64_t VideoFrameQueue::startTimestamp() {
+  MppFrame *frame = ring_.Front(nullptr);
+  if (!frame)
+    return AV_NOPTS_VALUE;
+  return mpp_frame_get_pts(*frame);
+}
+
+bool VideoFrameQueue::eos_queued() {
+  //先丢掉作废的帧,其中可能有 EOS
+  ring_.Front(nullptr);
+  return ring_.has_marker();
 }
 
 MppFrame VideoFrameQueue::get(int64_t render_time) {
-  base::AutoLock l(lock_);
-  if (frame_list_.empty())
+  TRACE_EVENT0("queue", "VideoFrameQueue::get");
+  bool eos = false;
+  MppFrame *frame = ring_.Front(&eos);
+  if (!frame)
     return nullptr;
 
-  if (frame_list_.begin()->first <= render_time) {
-    MppFrame frame = frame_list_.begin()->second;
-    frame_list_.erase(frame_list_.begin());
-    DLOG(INFO) << "VideoFrameQueue size: " << frame_list_.size();
-    return frame;
-  }
-  if (frame_list_.size() == 1) {
-    MppFrame frame = frame_list_.begin()->second;
-    if (mpp_frame_get_eos(frame)) {
-      frame_list_.clear();
-      return frame;
-    }
+  if (eos || mpp_frame_get_pts(*frame) <= render_time) {
+    DLOG(INFO) << "VideoFrameQueue size: " << ring_.size() - 1;
+    TRACE_EVENT_FLOW_STEP0("media", "VideoFrame", mpp_frame_get_pts(*frame));
+    return ring_.Pop();
   }
   return nullptr;
 }
 
 void VideoFrameQueue::flush() {
-  base::AutoLock l(lock_);
-  for (auto &i : frame_list_) {
-    mpp_frame_deinit(&i.second);
-  }
-  frame_list_.clear();
+  ring_.Clear();
 }
 
 size_t VideoFrameQueue::size() {
-  base::AutoLock l(lock_);
-  return frame_list_.size();
+  ring_.Front(nullptr);
+  return ring_.size();
+}
+
+void VideoFrameQueue::shutdown() {
+  ring_.shutdown();
+}
+
+void VideoFrameQueue::interrupt_writer() {
+  ring_.InterruptWriter();
+}
+
+uint64_t VideoFrameQueue::wakeups() {
+  return ring_.wakeups();
 }
 
 size_t VideoFrameQueue::max_size() const {
   return max_size_;
 }
+
+size_t VideoFrameQueue::bytes() {
+  return ring_.bytes();
+}
+
+size_t VideoFrameQueue::peak_bytes() {
+  return ring_.peak_bytes();
+}
+
+void VideoFrameQueue::PushToRing(MppFrame frame, bool eos) {
+  if (ring_.full() && !ring_.wait_for_writable(base::TimeDelta::Max())) {
+    ReleaseFrame(frame);
+    return;
+  }
+  ring_.Push(frame, eos);
+}
+
+void VideoFrameQueue::ReleaseWindow() {
+  for (MppFrame frame : window_) {
+    ring_.SubBytes(FrameBytes(frame));
+    ReleaseFrame(frame);
+  }
+  window_.clear();
+}
 }
@@ -1,9 +1,11 @@
 #ifndef MEDIA_VIDEO_FRAME_QUEUE_H_
 #define MEDIA_VIDEO_FRAME_QUEUE_H_
 
-#include <map>
+#include <atomic>
+#include <vector>
 #include "base/macros.h"
-#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "media/frame_ring.h"
 #include "media/media_constants.h"
 #include <rockchip/mpp_frame.h>
 
@@ -13,34 +15,81 @@ namespace media {
 
 /*
  * 因为可能存在B帧,解码器出来的帧顺序不是真正的显示顺序,所以,
- * 我们要按照 PTS 进行排序,std::map可以对主键自动排序
- * 正是我们所需
+ * 我们要按照 PTS 进行排序
+ * 解码线程一侧有一个按 PTS 排好序的小窗口,大小为重排深度,窗口满了之后把 PTS 最小的帧放入无锁的 FrameRing,
+ * ring 中的帧已经是显示顺序,render 线程只看队首
+ * 窗口和 ring 的总容量为 max_size,不会占用更多的解码器 buffer
  */
 class VideoFrameQueue {
 public:
- explicit VideoFrameQueue(AVStream *stream, size_t max_size);
+ // reorder_depth: 重排窗口的大小,0 表示解码器输出的就是显示顺序
+ explicit VideoFrameQueue(AVStream *stream, size_t max_size, size_t reorder_depth = 0);
 
  virtual ~VideoFrameQueue();
 
+ // 以下只能在解码线程调用
+ // 解码线程等待队列可写,get/flush 会唤醒它
+ // 返回 false 表示超时或者已经 shutdown,timeout 为 base::TimeDelta::Max() 时一直等待
+ bool wait_for_writable(const base::TimeDelta &timeout);
+
+ // 和 wait_for_writable 一样一直等待,interrupt_writer 也会让它返回 false
+ bool wait_for_writable_or_interrupted();
+
+ void put(MppFrame frame);
+
+ // 解码线程收到 flush 包: 释放窗口中的帧,ring 中已有的帧作废,由 render 线程取到时释放
+ void invalidate();
+
+ // 以下只能在 render 线程调用
+ // ring 没满
  bool is_writable();
 
+ // 等待队列中有数据
+ bool wait_for_readable(const base::TimeDelta &timeout);
+
  int64_t startTimestamp();
 
- void put(MppFrame frame);
+ // 队列中是否已经有 EOS 帧
+ bool eos_queued();
 
  MppFrame get(int64_t render_time);
 
+ // 释放 ring 中所有的帧
+ // 解码线程退出时也会调用,这时 render 线程阻塞在等待解码线程结束上
  void flush();
 
+ // 已经可以显示的帧数,不含窗口中的帧
  size_t size();
 
+ // 以下可以在任意线程调用
+ // 唤醒所有等待的线程,之后的等待都立即返回 false
+ void shutdown();
+
+ // 唤醒阻塞在 wait_for_writable_or_interrupted 上的解码线程,没有在等待时下一次等待立即返回
+ void interrupt_writer();
+
+ // 等待线程被唤醒的次数
+ uint64_t wakeups();
+
  size_t max_size() const;
 
+ // 队列中解码帧(包括窗口中的)占用的字节数,以及曾经的最大值
+ size_t bytes();
+
+ size_t peak_bytes();
+
 private:
+ // 等待 ring 可写之后放入,正在退出时直接释放
+ void PushToRing(MppFrame frame, bool eos);
+
+ void ReleaseWindow();
+
  AVStream *stream_;
  size_t max_size_;
- std::map<int64_t, MppFrame> frame_list_;
- base::Lock lock_;
+ size_t reorder_depth_;
+ FrameRing<MppFrame> ring_;
+ // 按 PTS 从小到大排列,只有解码线程访问
+ std::vector<MppFrame> window_;
  DISALLOW_COPY_AND_ASSIGN(VideoFrameQueue);
 };
 }
@@ -1,6 +1,8 @@
 ﻿#include "base/logging.h"
+#include "base/trace_event/trace_event.h"
 #include "media/video_player.h"
 #include "media/mp4_dataset.h"
+#include "media/mp4_index.h"
 #include "media/audio_render.h"
 #include "media/mpp_decoder.h"
 #include "media/audio_frame_queue.h"
@@ -8,29 +10,62 @@
 #include "media/packet_queue.h"
 #include "media/audio_decoder_thread.h"
 #include "media/video_decoder_thread.h"
+#include "media/demux_thread.h"
+#include "media/decoded_clip_cache.h"
+#include "media/audio_time_stretcher.h"
+#include "media/audio_buffer_pool.h"
 #include "media/media_constants.h"
+#include "media/nal_unit.h"
+#include <algorithm>
 #include <functional>
 
 namespace media {
 
 VideoPlayer::VideoPlayer(Delegate *delegate,
                          Mp4Dataset *dataset,
-                         bool enable_audio,
-                         int volume,
-                         bool loop,
-                         double buffer_time)
+                         const Options &options)
     : delegate_(delegate),
       dataset_(dataset),
-      enable_audio_(enable_audio),
-      volume_(volume),
-      loop_(loop),
-      buffer_time_(buffer_time),
+      enable_audio_(options.enable_audio),
+      volume_(options.volume),
+      loop_(options.loop),
+      buffer_time_(options.buffer_time),
+      buffer_mode_(options.buffer_mode),
+      render_mode_(options.render_mode),
+      video_decoder_type_(options.video_decoder),
+      clock_mode_(options.clock_mode),
+      clip_cache_bytes_(options.clip_cache_bytes),
+      fast_start_(options.fast_start),
+      seek_mode_(options.seek_mode),
+      fast_start_frames_(0),
       mute_(false),
+      last_stats_wakeups_(0),
+      audio_buffer_duration_(0),
+      audio_clock_correction_us_(0),
+      audio_resyncs_(0),
+      ttff_us_(-1),
+      seek_serial_(0),
+      current_seek_mode_(SeekMode::kKeyFrame),
+      trick_speed_(0),
+      play_position_(0),
+      seeks_completed_(0),
+      seek_target_(0),
+      seek_target_mode_(SeekMode::kKeyFrame),
+      seek_task_posted_(false),
+      seeks_coalesced_(0),
+      audio_stretching_(false),
+      audio_stretch_us_(0),
+      frames_dropped_(0),
+      late_frames_(0),
+      on_time_frames_(0),
+      decoder_skipping_(false),
       thread_(new base::Thread("VideoPlayer")) {
   if (buffer_time_ < 0.2) buffer_time_ = 0.2;
-  base::SimpleThread::Options options;
-  options.set_priority(base::ThreadPriority::REALTIME_AUDIO);
-  thread_->StartWithOptions(options);
+  //音频没法"尽快"播放
+  if (render_mode_ == RenderMode::kFreeRun) enable_audio_ = false;
+  base::SimpleThread::Options thread_options;
+  thread_options.set_priority(base::ThreadPriority::REALTIME_AUDIO);
+  thread_->StartWithOptions(thread_options);
   thread_->PostTask(std::bind(&VideoPlayer::OnStart, this));
 }
 
@@ -43,34 +78,149 @@ VideoPlayer::~VideoPlayer() {
 }
 
 void VideoPlayer::Seek(double timestamp) {
+  Seek(timestamp, seek_mode_);
+}
+
+void VideoPlayer::Seek(double timestamp, SeekMode mode) {
+  {
+    base::AutoLock l(seek_lock_);
+    seek_target_ = timestamp;
+    seek_target_mode_ = mode;
+    seek_request_time_ = base::TimeTicks::Now();
+    //拖动进度条时 seek 一个接一个,还没执行的 seek 直接换成新的目标
+    if (seek_task_posted_) {
+      ++seeks_coalesced_;
+      return;
+    }
+    seek_task_posted_ = true;
+  }
+  thread_->PostTask(std::bind(&VideoPlayer::OnSeek, this));
+}
+
+void VideoPlayer::OnSeek() {
+  double timestamp;
+  SeekMode mode;
+  base::TimeTicks request_time;
+  {
+    base::AutoLock l(seek_lock_);
+    timestamp = seek_target_;
+    mode = seek_target_mode_;
+    request_time = seek_request_time_;
+    seek_task_posted_ = false;
+    //上一次 seek 还没完成,它解码出来的帧都用不上了
+    if (render_state_.seek_pending_streams)
+      ++seeks_coalesced_;
+  }
+  if (!dataset_->seekable() || !demux_thread_) {
+    OnMediaError(Error_SeekFailed);
+    return;
+  }
+  //填充到一半的缓存不再完整,放弃
+  if (clip_cache_ && !clip_cache_->sealed()) {
+    clip_cache_->Disable();
+    OnClipCacheDisabled();
+  }
+  /*
+   * seek flow:
+   * 1)stop render timer
+   * 2)clear all output buffer
+   * 3)new serial, mark streams pending
+   * 4)demux thread seek and flush packet queues (flush packet carries the serial)
+   * 5)waiting decoder thread flush decoder
+   * 6)restart render
+   * 新的 seek 直接取代还没完成的 seek: 只等待新 serial 的 flush,旧 serial 的回调全部忽略
+   */
+  io_timer_->Stop();
+
+  ++seek_serial_;
+  render_state_.seek_pending_streams = 0;
+  if (video_output_queue_) {
+    //flush很重要,万一decoder thread 阻塞,清空缓冲区就可以立即唤醒
+    video_output_queue_->flush();
+    render_state_.seek_pending_streams |= kSeekVideoPending;
+  }
+  if (audio_output_queue_) {
+    //flush很重要,万一decoder thread 阻塞,清空缓冲区就可以立即唤醒
+    audio_output_queue_->flush();
+    render_state_.seek_pending_streams |= kSeekAudioPending;
+  }
+  seek_start_time_ = request_time;
+  current_seek_mode_ = mode;
+  trick_speed_ = 0;
+  play_position_ = static_cast<int64_t>(timestamp * base::Time::kMicrosecondsPerSecond);
+  demux_thread_->Seek(timestamp, seek_serial_, mode == SeekMode::kAccurate);
+}
+
+void VideoPlayer::SetTrickPlay(int speed) {
+  thread_->PostTask(std::bind(&VideoPlayer::OnSetTrickPlay, this, speed));
+}
+
+void VideoPlayer::OnSetTrickPlay(int speed) {
+  if (speed >= -1 && speed <= 1) {
+    speed = 0;
+  } else {
+    speed = std::max(-kMaxTrickPlaySpeed, std::min(speed, kMaxTrickPlaySpeed));
+  }
+  if (speed == trick_speed_)
+    return;
+  if (!dataset_->seekable() || !demux_thread_) {
+    OnMediaError(Error_SeekFailed);
+    return;
+  }
+  //已经封存的缓存由解码线程在 EOS 时重放,和快进快退的时间戳对不上
+  if (clip_cache_ && clip_cache_->sealed()) {
+    LOG(WARNING) << "Trick play is not supported while replaying from clip cache";
+    return;
+  }
+  if (clip_cache_) {
+    clip_cache_->Disable();
+    OnClipCacheDisabled();
+  }
+  /*
+   * 和 seek 的流程一样: 停止定时器,清空输出队列,等待新 serial 的 flush 完成后重新开始 render
+   * 快进快退时解封装线程只送出同步帧,时间戳已经按速度换算过,render 的时钟不用改
+   */
+  io_timer_->Stop();
+
+  ++seek_serial_;
+  render_state_.seek_pending_streams = 0;
+  if (video_output_queue_) {
+    video_output_queue_->flush();
+    render_state_.seek_pending_streams |= kSeekVideoPending;
+  }
+  if (audio_output_queue_) {
+    audio_output_queue_->flush();
+    render_state_.seek_pending_streams |= kSeekAudioPending;
+  }
+  //不计入 seek 延迟
+  seek_start_time_ = base::TimeTicks();
+  trick_speed_ = speed;
+  LOG(INFO) << "Trick play speed: " << speed << ", position(us): " << play_position_;
+  demux_thread_->SetTrickPlay(speed, play_position_, seek_serial_);
+}
+
+void VideoPlayer::SetPlaybackRate(double rate) {
   if (!thread_->IsCurrent()) {
-    thread_->PostTask(std::bind(&VideoPlayer::Seek, this, timestamp));
+    thread_->PostTask(std::bind(&VideoPlayer::SetPlaybackRate, this, rate));
   } else {
-    int err = dataset_->seek(timestamp);
-    if (err >= 0) {
-      /*
-       * seek flow:
-       * 1)stop render timer
-       * 2)clear all output buffer
-       * 3)add stream pending counter
-       * 4)waiting decoder thread flush decoder
-       * 5)restart render
-       */
-      io_timer_->Stop();
-
-      if (video_output_queue_) {
-        //flush很重要,万一decoder thread 阻塞,清空缓冲区就可以立即唤醒
-        video_output_queue_->flush();
-        ++render_state_.stream_seek_pending;
-      }
-      if (audio_output_queue_) {
-        //flush很重要,万一decoder thread 阻塞,清空缓冲区就可以立即唤醒
-        audio_output_queue_->flush();
-        ++render_state_.stream_seek_pending;
-      }
+    rate = std::max(kMinPlaybackRate, std::min(rate, kMaxPlaybackRate));
+    if (rate == render_state_.rate)
+      return;
+    //保持当前的播放时间不变,之后按新的速度走(暂停时 Resume 会重新校准)
+    if (!render_state_.base_time.is_null()) {
+      base::TimeTicks now = base::TimeTicks::Now();
+      int64_t media_time = render_state_.MediaTime(now);
+      render_state_.rate = rate;
+      render_state_.base_time = now - render_state_.ToWallDelta(media_time);
     } else {
-      OnMediaError(Error_SeekFailed);
+      render_state_.rate = rate;
+    }
+    if (audio_stretcher_) {
+      audio_stretcher_->SetRate(rate);
+      if (rate != 1.0)
+        audio_stretching_ = true;
     }
+    LOG(INFO) << "Playback rate: " << rate;
   }
 }
 
@@ -113,22 +263,42 @@ void VideoPlayer::Resume() {
   }
 }
 
+PlaybackStats VideoPlayer::GetStats() {
+  base::AutoLock l(stats_lock_);
+  return stats_;
+}
+
 void VideoPlayer::OnStart() {
+  start_time_ = base::TimeTicks::Now();
+  InitClipCache();
   InitVideo();
   InitAudio();
   InitAudioRender();
-  io_timer_.reset(new base::Timer(false));
+  InitDemux();
+  io_timer_.reset(new base::HighResTimer());
+  base::PlatformThread::SetCurrentThreadTimerSlack(base::TimeDelta::FromMicroseconds(kRenderTimerSlack));
+  last_stats_time_ = base::TimeTicks::Now();
   ManageTimer(base::TimeDelta::FromMicroseconds(kRenderPollDelay));
 }
 
 void VideoPlayer::OnStop() {
   io_timer_.reset();
+  //解码线程销毁之前保存最后一次统计
+  UpdateStats(true);
   //在销毁解码线程之前,先让UI线程释放 mppframe,否则会导致RK解码器异常
   delegate_->OnMediaFrameArrival(nullptr);
 
+  //解码线程可能在等待另一个 stream 完成缓存
+  if (clip_cache_) {
+    clip_cache_->Abort();
+  }
+  //先停止解封装线程,它可能阻塞在包队列上
+  demux_thread_.reset();
   video_decoder_thread_.reset();
   audio_decoder_thread_.reset();
+  clip_cache_.reset();
   audio_render_.reset();
+  stretch_buffer_pool_.reset();
   audio_input_queue_.reset();
   video_input_queue_.reset();
   video_output_queue_.reset();
@@ -145,31 +315,144 @@ void VideoPlayer::InitAudio() {
   }
 
   //根据帧时长估计缓冲区大小
-  base::TimeDelta duration = media::ConvertFromTimeBase(stream->time_base, stream->codecpar->frame_size);
+  base::TimeDelta duration = media::ConvertFromTimeBase(stream->time_base, AudioFrameSize(stream));
   int count = static_cast<int>(buffer_time_ / duration.InSecondsF()) + 1;
   LOG(INFO) << "audio max buffer count:" << count;
   audio_output_queue_ = base::WrapUnique(new AudioFrameQueue(stream, count));
-  audio_input_queue_ = base::WrapUnique(new PacketQueue());
+  audio_input_queue_ = base::WrapUnique(new PacketQueue(stream,
+                                                        PacketBufferDuration(),
+                                                        kMaxAudioPacketBytes));
   dataset_->setAudioPacketQueue(audio_input_queue_.get());
   audio_decoder_thread_ = base::WrapUnique(new AudioDecoderThread(this,
                                                                   dataset_,
                                                                   audio_input_queue_.get(),
-                                                                  audio_output_queue_.get()));
+                                                                  audio_output_queue_.get(),
+                                                                  clip_cache_.get()));
 }
 
 void VideoPlayer::InitVideo() {
   AVStream *stream = dataset_->getVideoStream();
   AVRational frame_rate = av_guess_frame_rate(dataset_->getFormatContext(), stream, nullptr);
   double fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 30.0f;
-  int count = static_cast<int>(fps * buffer_time_);
-  LOG(INFO) << "video max buffer count:" << count;
-  video_output_queue_ = base::WrapUnique(new VideoFrameQueue(stream, count));
-  video_input_queue_ = base::WrapUnique(new PacketQueue());
+  int reorder_depth = VideoReorderDepth();
+  int count;
+  if (buffer_mode_ == BufferMode::kCompressedPackets) {
+    //缓冲时长由包队列保证,解码帧只要够 B 帧排序,再留一点余量吸收解码时间的抖动
+    count = reorder_depth + kDecodedFrameMargin;
+  } else {
+    count = static_cast<int>(fps * buffer_time_);
+  }
+  LOG(INFO) << "video reorder depth:" << reorder_depth << ", max buffer count:" << count;
+  //B 帧要等后面的帧解码出来才能输出,至少缓冲重排深度,否则一开始就欠载
+  //队列中的重排窗口会攒够这么多帧才送出第一帧,size() 只算已经排好序的帧
+  fast_start_frames_ = std::min(kFastStartExtraFrames,
+                                static_cast<size_t>(std::max(count - reorder_depth, 1)));
+  video_output_queue_ = base::WrapUnique(new VideoFrameQueue(stream, count, reorder_depth));
+  video_input_queue_ = base::WrapUnique(new PacketQueue(stream,
+                                                        PacketBufferDuration(),
+                                                        kMaxVideoPacketBytes));
   dataset_->setVideoPacketQueue(video_input_queue_.get());
   video_decoder_thread_ = base::WrapUnique(new VideoDecoderThread(this,
                                                                   dataset_,
                                                                   video_input_queue_.get(),
-                                                                  video_output_queue_.get()));
+                                                                  video_output_queue_.get(),
+                                                                  video_decoder_type_,
+                                                                  clip_cache_.get()));
+}
+
+void VideoPlayer::InitDemux() {
+  //循环播放时由解封装线程直接回到开头,解码和渲染都不中断
+  //只有回到开头失败时才会读到 EOS,再走 RewindRender
+  //有解码帧缓存时照常送出 EOS,解码线程读到 EOS 之后改为从缓存重放
+  dataset_->setLoop(loop_ && !clip_cache_);
+  demux_thread_ = base::WrapUnique(new DemuxThread(this,
+                                                   dataset_,
+                                                   audio_input_queue_.get(),
+                                                   video_input_queue_.get()));
+}
+
+void VideoPlayer::InitClipCache() {
+  if (!loop_ || clip_cache_bytes_ == 0)
+    return;
+  AVStream *audio_stream = enable_audio_ ? dataset_->getAudioStream() : nullptr;
+  size_t estimate = EstimateDecodedClipBytes(audio_stream);
+  if (estimate > clip_cache_bytes_) {
+    LOG(INFO) << "Clip too large to cache, estimated bytes: " << estimate;
+    return;
+  }
+  int streams = DecodedClipCache::kVideo;
+  AVRational audio_time_base = {1, static_cast<int>(base::Time::kMicrosecondsPerSecond)};
+  int audio_sample_rate = 0;
+  if (audio_stream) {
+    streams |= DecodedClipCache::kAudio;
+    audio_time_base = audio_stream->time_base;
+    audio_sample_rate = audio_stream->codecpar->sample_rate;
+  }
+  std::unique_ptr<DecodedClipCache> cache(new DecodedClipCache(clip_cache_bytes_,
+                                                               streams,
+                                                               audio_time_base,
+                                                               audio_sample_rate));
+  if (!cache->Init())
+    return;
+  clip_cache_ = std::move(cache);
+}
+
+size_t VideoPlayer::EstimateDecodedClipBytes(AVStream *audio_stream) {
+  AVFormatContext *format_ctx = dataset_->getFormatContext();
+  if (format_ctx->duration <= 0)
+    return 0;
+  double duration = static_cast<double>(format_ctx->duration) / AV_TIME_BASE;
+
+  AVStream *stream = dataset_->getVideoStream();
+  double frames = 0;
+  const Mp4Index *index = dataset_->index();
+  const Mp4Index::Track *track = index ? index->track(dataset_->getVideoStreamIndex()) : nullptr;
+  if (track) {
+    frames = track->sample_count();
+  } else {
+    AVRational frame_rate = av_guess_frame_rate(format_ctx, stream, nullptr);
+    double fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 30.0f;
+    frames = duration * fps;
+  }
+  //NV12,宽高按 16 对齐
+  double frame_bytes = FFALIGN(stream->codecpar->width, 16) * FFALIGN(stream->codecpar->height, 16) * 3 / 2;
+  double bytes = frames * frame_bytes;
+  if (audio_stream) {
+    bytes += duration * audio_stream->codecpar->sample_rate * kAudioChannels * sizeof(int16_t);
+  }
+  return static_cast<size_t>(bytes);
+}
+
+base::TimeDelta VideoPlayer::PacketBufferDuration() const {
+  //包队列要比输出队列多缓冲一些,用来吸收音视频交织不均匀的文件
+  return base::TimeDelta::FromSecondsD(buffer_time_)
+      + base::TimeDelta::FromMicroseconds(kPacketBufferExtraDuration);
+}
+
+int VideoPlayer::AudioFrameSize(AVStream *stream) {
+  //使用索引打开时没有 avformat_find_stream_info, AAC 的 frame_size 可能为 0
+  int frame_size = stream->codecpar->frame_size;
+  return frame_size > 0 ? frame_size : kDefaultAudioFrameSize;
+}
+
+int VideoPlayer::VideoReorderDepth() {
+  //SPS 中的 max_num_reorder_frames 是编码器承诺的上限,索引只能看到开头的一段
+  //两者都有时取较大的,避免 SPS 写错的文件排序出错
+  VideoReorderInfo reorder_info;
+  int sps_depth = -1;
+  if (ParseVideoReorderInfo(dataset_->getVideoStream()->codecpar, &reorder_info))
+    sps_depth = reorder_info.num_reorder_frames;
+  const Mp4Index *index = dataset_->index();
+  if (index) {
+    const Mp4Index::Track *track = index->track(dataset_->getVideoStreamIndex());
+    if (track)
+      return std::max(sps_depth, track->ReorderDepth(kReorderProbeSamples));
+  }
+  if (sps_depth >= 0)
+    return sps_depth;
+  //没有索引时只能相信 avformat_find_stream_info 得到的 video_delay
+  int delay = dataset_->getVideoStream()->codecpar->video_delay;
+  return delay > 0 ? delay : kDefaultReorderDepth;
 }
 
 void VideoPlayer::InitAudioRender() {
@@ -179,8 +462,7 @@ void VideoPlayer::InitAudioRender() {
   std::unique_ptr<RKAudioRender> audio_render;
   auto stream = dataset_->getAudioStream();
   int sample_rate = stream->codecpar->sample_rate;
-  int64_t frame_size = stream->codecpar->frame_size;
-  if (frame_size < 1) frame_size = 1024;
+  int64_t frame_size = AudioFrameSize(stream);
   std::unique_ptr<RKAudioRender> render = base::WrapUnique(new RKAudioRender());
   if (!render->Init("default",
                     sample_rate,
@@ -193,13 +475,28 @@ void VideoPlayer::InitAudioRender() {
     render->SetVolume(volume_);
   }
   audio_render_ = std::move(render);
+  std::unique_ptr<AudioTimeStretcher> stretcher = base::WrapUnique(new AudioTimeStretcher());
+  if (stretcher->Init(sample_rate, kAudioChannels)) {
+    stretcher->SetRate(render_state_.rate);
+    audio_stretcher_ = std::move(stretcher);
+    //最慢速度下一帧输入最多拉长到 1 / kMinPlaybackRate 倍,再留一点 stretcher 内部缓冲的余量
+    int64_t stretch_frames = static_cast<int64_t>((frame_size + kAudioPoolSampleMargin) / kMinPlaybackRate);
+    std::unique_ptr<RKAudioBufferPool> pool = base::WrapUnique(new RKAudioBufferPool());
+    if (pool->Init(stretch_frames * kAudioChannels * sizeof(int16_t),
+                   kAudioMasterQueueBuffers + kAudioPoolExtraBuffers)) {
+      stretch_buffer_pool_ = std::move(pool);
+    }
+  }
 }
 
 void VideoPlayer::OnRender() {
+  TRACE_EVENT0("render", "VideoPlayer::OnRender");
+  UpdateStats(false);
+
   if (!render_state_.started) {
     //我们要缓冲指定时间的视频帧,一是为了后面播放更为流畅,二是如果存在B帧,需要缓冲排序
-    if (video_output_queue_->is_writable()) {
-      ManageTimer(base::TimeDelta::FromMicroseconds(kRenderPollDelay));
+    if (NeedPrebuffer()) {
+      ManageTimer(base::TimeDelta::FromMicroseconds(fast_start_ ? kFastStartPollDelay : kRenderPollDelay));
       return;
     }
     render_state_.started = true;
@@ -213,31 +510,50 @@ void VideoPlayer::OnRender() {
      * 我们要根据视频缓冲区第一帧的时间戳来作为当前播放时间戳,在seek之后,第一帧时间戳不一定为 0
      * 我们播放时间戳要比第一帧时间戳略大
      */
-    int64_t timestamp = video_output_queue_->startTimestamp();
-    int64_t remainder = timestamp % kRenderPollDelay;
-    //转换为 kRenderPollDelay 的整数倍
-    render_state_.render_time = (timestamp / kRenderPollDelay) * kRenderPollDelay;
-    if (remainder > 0) render_state_.render_time += kRenderPollDelay;
+    int64_t timestamp = render_state_.preroll_pts != AV_NOPTS_VALUE
+                        ? render_state_.preroll_pts
+                        : video_output_queue_->startTimestamp();
+    if (render_mode_ != RenderMode::kFixedPoll) {
+      render_state_.render_time = timestamp;
+    } else {
+      int64_t remainder = timestamp % kRenderPollDelay;
+      //转换为 kRenderPollDelay 的整数倍
+      render_state_.render_time = (timestamp / kRenderPollDelay) * kRenderPollDelay;
+      if (remainder > 0) render_state_.render_time += kRenderPollDelay;
+    }
     //重新校准基准时间: 当前时间 - 已经播放的时间 (这里指 seek 之后的时间)
     render_state_.BasetimeCalibration();
+    //stretcher 中缓冲的是 seek 之前的样本
+    if (audio_stretcher_) {
+      audio_stretcher_->Reset();
+      audio_stretching_ = render_state_.rate != 1.0;
+    }
+    //seek 之后重新开始统计是否落后
+    late_frames_ = 0;
+    on_time_frames_ = 0;
+    SetDecoderSkip(false);
     DLOG(INFO) << "render timer reset";
+  } else if (render_mode_ == RenderMode::kNextFrame) {
+    //播放时间直接由基准时间算出,定时器早到或者晚到都不会累积误差
+    render_state_.render_time = render_state_.MediaTime(base::TimeTicks::Now());
   }
 
-  if (audio_render_) {
-    while (true) {
-      MEDIA_BUFFER audio_buffer = audio_output_queue_->get(render_state_.render_time);
-      if (!audio_buffer)
-        break;
-      DLOG(INFO) << "Render Audio frame PTS:" << RK_MPI_MB_GetTimestamp(audio_buffer);
-      if (mute_) {
-        memset(RK_MPI_MB_GetPtr(audio_buffer), 0, RK_MPI_MB_GetSize(audio_buffer));
-      }
-      audio_render_->SendInput(audio_buffer);
-      RK_MPI_MB_ReleaseBuffer(audio_buffer);
+  if (render_mode_ == RenderMode::kFreeRun) {
+    FreeRunRender();
+    return;
+  }
+
+  //快进快退时不播放音频
+  if (audio_render_ && trick_speed_ == 0) {
+    UpdateAudioClock();
+    if (clock_mode_ == ClockMode::kAudioMaster && render_mode_ == RenderMode::kNextFrame) {
+      render_state_.render_time = render_state_.MediaTime(base::TimeTicks::Now());
     }
+    SendAudio();
   }
 
   bool eos_reached = false;
+  MppFrame due_frame = nullptr;
 
   while (true) {
     MppFrame video_frame = video_output_queue_->get(render_state_.render_time);
@@ -249,28 +565,45 @@ void VideoPlayer::OnRender() {
       eos_reached = true;
       mpp_frame_deinit(&video_frame);
     } else {
-      delegate_->OnMediaFrameArrival(video_frame);
+      //同一次 render 中到期的帧只显示最新的一帧,更早的帧反正马上就被覆盖,送出去只会让画面越来越落后
+      if (due_frame) {
+        mpp_frame_deinit(&due_frame);
+        ++frames_dropped_;
+      }
+      due_frame = video_frame;
     }
   }
-  //next render time
-  render_state_.render_time += kRenderPollDelay;
+  if (due_frame) {
+    int64_t pts = mpp_frame_get_pts(due_frame);
+    RecordPresentationJitter(pts);
+    UpdateLateness(pts);
+    PresentFrame(due_frame);
+  }
 
   if (!eos_reached) {
-    //这里要对定时器进行误差修正,尽力保证实际间隔在 kRenderPollDelay
-    base::TimeTicks
-        expire_time = render_state_.base_time + base::TimeDelta::FromMicroseconds(render_state_.render_time);
+    if (render_mode_ == RenderMode::kNextFrame) {
+      ManageTimerAt(NextFrameTime());
+      return;
+    }
+    //next render time, 实际间隔是 kRenderPollDelay,播放时间按速度前进
+    render_state_.render_time += static_cast<int64_t>(kRenderPollDelay * render_state_.rate);
+    //定时器使用绝对时间,由基准时间算出,实际间隔保持在 kRenderPollDelay,不会累积误差
+    base::TimeTicks expire_time = render_state_.WallTime(render_state_.render_time);
     base::TimeTicks now = base::TimeTicks::Now();
     if (expire_time > now) {
-      base::TimeDelta delay = expire_time - now;
-      DLOG(INFO) << "render delay: " << delay.InMicroseconds();
-      ManageTimer(delay);
+      DLOG(INFO) << "render delay: " << (expire_time - now).InMicroseconds();
+      ManageTimerAt(expire_time);
     } else {
       ManageTimer(base::TimeDelta::FromMicroseconds(1000));
     }
+  } else if (trick_speed_ != 0) {
+    //快进到结尾或者快退到开头,画面停在最后一帧,等待 seek 或者退出快进快退
+    render_state_.Reset();
   } else {
     //播放完成
     render_state_.Reset();
     RenderCompleted();
+    UpdateStats(true);
     if (!loop_) {
       delegate_->OnMediaStop();
     } else {
@@ -279,13 +612,231 @@ void VideoPlayer::OnRender() {
   }
 }
 
-void VideoPlayer::RenderCompleted() {
-  if (audio_input_queue_) {
-    audio_input_queue_->flush();
+void VideoPlayer::FreeRunRender() {
+  //解码器按显示顺序输出,队列里有什么就送什么
+  bool eos_reached = false;
+  bool delivered = false;
+  while (MppFrame video_frame = video_output_queue_->get(INT64_MAX)) {
+    if (mpp_frame_get_eos(video_frame)) {
+      eos_reached = true;
+      mpp_frame_deinit(&video_frame);
+      break;
+    }
+    delivered = true;
+    PresentFrame(video_frame);
+  }
+  if (eos_reached) {
+    render_state_.Reset();
+    RenderCompleted();
+    UpdateStats(true);
+    if (!loop_) {
+      delegate_->OnMediaStop();
+    } else {
+      RewindRender();
+    }
+    return;
   }
-  if (video_input_queue_) {
-    video_input_queue_->flush();
+  //队列空了就等一下解码线程,不空转
+  ManageTimer(delivered ? base::TimeDelta()
+                        : base::TimeDelta::FromMicroseconds(kFreeRunPollDelay));
+}
+
+bool VideoPlayer::NeedPrebuffer() {
+  //快进快退时每一帧都隔得很远,有一帧就开始
+  if (trick_speed_ != 0)
+    return video_output_queue_->size() == 0 && !video_output_queue_->eos_queued();
+  if (!fast_start_)
+    return video_output_queue_->is_writable();
+
+  bool eos_queued = video_output_queue_->eos_queued();
+  //第一帧不等缓冲直接显示,开始走时钟之前画面一直停在这一帧
+  if (render_state_.preroll_pts == AV_NOPTS_VALUE && !eos_queued && video_output_queue_->size() > 0) {
+    MppFrame video_frame = video_output_queue_->get(INT64_MAX);
+    if (video_frame) {
+      render_state_.preroll_pts = mpp_frame_get_pts(video_frame);
+      PresentFrame(video_frame);
+    }
   }
+  //文件太短,EOS 已经到了,不用再等
+  if (eos_queued || !video_output_queue_->is_writable())
+    return false;
+  return video_output_queue_->size() < fast_start_frames_;
+}
+
+void VideoPlayer::PresentFrame(MppFrame frame) {
+  TRACE_EVENT1("render", "VideoPlayer::PresentFrame", "pts", mpp_frame_get_pts(frame));
+  TRACE_EVENT_FLOW_STEP0("media", "VideoFrame", mpp_frame_get_pts(frame));
+  if (ttff_us_ < 0) {
+    ttff_us_ = (base::TimeTicks::Now() - start_time_).InMicroseconds();
+    LOG(INFO) << "time to first frame(us): " << ttff_us_;
+  }
+  if (!seek_start_time_.is_null() && render_state_.seek_pending_streams == 0) {
+    //从发起 seek(合并时取最后一次)到目标位置的第一帧送出
+    int64_t latency = (base::TimeTicks::Now() - seek_start_time_).InMicroseconds();
+    if (current_seek_mode_ == SeekMode::kAccurate) {
+      accurate_seek_latency_.Add(latency);
+    } else {
+      seek_latency_.Add(latency);
+    }
+    seek_start_time_ = base::TimeTicks();
+    ++seeks_completed_;
+  }
+  play_position_ = mpp_frame_get_pts(frame);
+  delegate_->OnMediaFrameArrival(frame);
+}
+
+void VideoPlayer::SendAudio() {
+  int queued = 0;
+  int64_t send_time = render_state_.render_time;
+  if (clock_mode_ == ClockMode::kAudioMaster) {
+    //提前送入一小段,AO 中始终有数据,音频时钟才连续
+    queued = std::max(audio_render_->QueuedBuffers(), 0);
+    send_time += kAudioMasterLeadTime;
+  }
+  int sample_rate = dataset_->getAudioStream()->codecpar->sample_rate;
+  while (clock_mode_ != ClockMode::kAudioMaster || queued < kAudioMasterQueueBuffers) {
+    MEDIA_BUFFER audio_buffer = audio_output_queue_->get(send_time);
+    if (!audio_buffer)
+      break;
+    if (audio_stretching_) {
+      audio_buffer = StretchAudio(audio_buffer);
+      if (!audio_buffer)
+        continue;
+    }
+    int64_t pts = static_cast<int64_t>(RK_MPI_MB_GetTimestamp(audio_buffer));
+    DLOG(INFO) << "Render Audio frame PTS:" << pts;
+    if (sample_rate > 0) {
+      int64_t samples = RK_MPI_MB_GetSize(audio_buffer) / (kAudioChannels * sizeof(int16_t));
+      //按播放时间计算,变速时一个输出样本对应 rate 个输入样本
+      audio_buffer_duration_ =
+          static_cast<int64_t>(samples * render_state_.rate * base::Time::kMicrosecondsPerSecond / sample_rate);
+    }
+    render_state_.audio_sent_end =
+        media::ConvertFromTimeBase(dataset_->getAudioStream()->time_base, pts).InMicroseconds()
+            + audio_buffer_duration_;
+    ++render_state_.audio_sent_count;
+    if (mute_) {
+      memset(RK_MPI_MB_GetPtr(audio_buffer), 0, RK_MPI_MB_GetSize(audio_buffer));
+    }
+    audio_render_->SendInput(audio_buffer);
+    RK_MPI_MB_ReleaseBuffer(audio_buffer);
+    ++queued;
+  }
+}
+
+MEDIA_BUFFER VideoPlayer::StretchAudio(MEDIA_BUFFER audio_buffer) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  AVRational time_base = dataset_->getAudioStream()->time_base;
+  int64_t pts = static_cast<int64_t>(RK_MPI_MB_GetTimestamp(audio_buffer));
+  int frames = static_cast<int>(RK_MPI_MB_GetSize(audio_buffer) / (kAudioChannels * sizeof(int16_t)));
+  audio_stretcher_->Push(static_cast<const int16_t *>(RK_MPI_MB_GetPtr(audio_buffer)),
+                         frames,
+                         media::ConvertFromTimeBase(time_base, pts).InMicroseconds());
+  RK_MPI_MB_ReleaseBuffer(audio_buffer);
+
+  MEDIA_BUFFER output = nullptr;
+  int available = audio_stretcher_->available();
+  if (available > 0) {
+    size_t size = available * kAudioChannels * sizeof(int16_t);
+    output = stretch_buffer_pool_
+             ? stretch_buffer_pool_->Get(size)
+             : RK_MPI_MB_CreateAudioBuffer(static_cast<RK_U32>(size), RK_FALSE);
+    if (output) {
+      int64_t timestamp = 0;
+      int pulled = audio_stretcher_->Pull(static_cast<int16_t *>(RK_MPI_MB_GetPtr(output)), available, &timestamp);
+      RK_MPI_MB_SetSize(output, static_cast<RK_U32>(pulled * kAudioChannels * sizeof(int16_t)));
+      RK_MPI_MB_SetTimestamp(output, static_cast<RK_U64>(
+          media::ConvertToTimeBase(time_base, base::TimeDelta::FromMicroseconds(timestamp))));
+    }
+  }
+  audio_stretch_us_ += (base::TimeTicks::Now() - start).InMicroseconds();
+  return output;
+}
+
+void VideoPlayer::UpdateAudioClock() {
+  if (render_state_.audio_sent_end == AV_NOPTS_VALUE || render_state_.base_time.is_null())
+    return;
+  int queued = audio_render_->QueuedBuffers();
+  //AO 是空的(还没开始,欠载或者音频已经结束),或者还有 seek 之前送入的数据,这时音频时钟不可信
+  if (queued <= 0 || queued > render_state_.audio_sent_count)
+    return;
+  //只知道 AO 中还有几个 buffer,正在播放的那个播放了多少无法知道,取中间值
+  int64_t audio_clock = render_state_.audio_sent_end - queued * audio_buffer_duration_ + audio_buffer_duration_ / 2;
+  int64_t video_clock = render_state_.MediaTime(base::TimeTicks::Now());
+  int64_t error = audio_clock - video_clock;
+  av_drift_samples_.Add(error < 0 ? -error : error);
+  run_av_drift_.Add(error < 0 ? -error : error);
+  if (clock_mode_ != ClockMode::kAudioMaster)
+    return;
+
+  int64_t correction;
+  if (error > kAudioResyncThreshold || error < -kAudioResyncThreshold) {
+    //seek 之后或者欠载恢复,直接对齐
+    correction = error;
+    ++audio_resyncs_;
+  } else {
+    //按 buffer 计数得到的音频时钟是阶梯状的,每次只修正一小部分,把阶梯误差平滑掉
+    correction = error / kAudioClockSmoothing;
+    audio_clock_correction_us_ += correction;
+  }
+  render_state_.base_time -= render_state_.ToWallDelta(correction);
+}
+
+base::TimeTicks VideoPlayer::NextFrameTime() {
+  int64_t next = video_output_queue_->startTimestamp();
+  if (audio_render_) {
+    int64_t audio_pts = audio_output_queue_->startTimestamp();
+    if (audio_pts != AV_NOPTS_VALUE) {
+      int64_t audio_time = media::ConvertFromTimeBase(dataset_->getAudioStream()->time_base, audio_pts).InMicroseconds();
+      if (clock_mode_ == ClockMode::kAudioMaster)
+        audio_time -= kAudioMasterLeadTime;
+      if (next == AV_NOPTS_VALUE || audio_time < next)
+        next = audio_time;
+    }
+  }
+  base::TimeTicks now = base::TimeTicks::Now();
+  //队列是空的,解码跟不上,按原来的间隔轮询
+  if (next == AV_NOPTS_VALUE)
+    return now + base::TimeDelta::FromMicroseconds(kRenderPollDelay);
+
+  //已经过去的时间点由定时器立即触发
+  base::TimeTicks expire_time = render_state_.WallTime(next);
+  //EOS 帧的时间戳不可靠,限制最长等待时间
+  return std::min(expire_time, now + base::TimeDelta::FromMicroseconds(kMaxRenderScheduleDelay));
+}
+
+void VideoPlayer::RecordPresentationJitter(int64_t pts) {
+  base::TimeTicks ideal_time = render_state_.WallTime(pts);
+  int64_t jitter = (base::TimeTicks::Now() - ideal_time).InMicroseconds();
+  jitter_samples_.Add(jitter < 0 ? -jitter : jitter);
+  run_jitter_.Add(jitter < 0 ? -jitter : jitter);
+}
+
+void VideoPlayer::UpdateLateness(int64_t pts) {
+  if (!video_decoder_thread_)
+    return;
+  int64_t lateness = static_cast<int64_t>((render_state_.render_time - pts) / render_state_.rate);
+  if (lateness > kLateFrameThreshold) {
+    on_time_frames_ = 0;
+    if (++late_frames_ >= kLateFramesBeforeSkip)
+      SetDecoderSkip(true);
+  } else {
+    late_frames_ = 0;
+    if (++on_time_frames_ >= kOnTimeFramesBeforeResume)
+      SetDecoderSkip(false);
+  }
+}
+
+void VideoPlayer::SetDecoderSkip(bool skip) {
+  if (skip == decoder_skipping_ || !video_decoder_thread_)
+    return;
+  decoder_skipping_ = skip;
+  video_decoder_thread_->SetSkipNonReference(skip);
+  LOG(INFO) << (skip ? "Render is late, decoder skips non-reference frames"
+                     : "Render caught up, decoder decodes all frames");
+}
+
+void VideoPlayer::RenderCompleted() {
   if (audio_output_queue_) {
     audio_output_queue_->flush();
   }
@@ -295,7 +846,8 @@ void VideoPlayer::RenderCompleted() {
 }
 
 void VideoPlayer::RewindRender() {
-  dataset_->rewind();
+  //解封装线程负责 rewind 并清空包队列
+  demux_thread_->Rewind();
   ManageTimer(base::TimeDelta::FromMicroseconds(kRenderPollDelay));
 }
 
@@ -303,21 +855,126 @@ void VideoPlayer::ManageTimer(const base::TimeDelta &delay) {
   io_timer_->Start(std::bind(&VideoPlayer::OnRender, this), delay);
 }
 
-void VideoPlayer::OnFlushCompleted(int stream_idx) {
+void VideoPlayer::ManageTimerAt(base::TimeTicks deadline) {
+  io_timer_->StartAt(std::bind(&VideoPlayer::OnRender, this), deadline);
+}
+
+uint64_t VideoPlayer::CountWakeups() {
+  uint64_t wakeups = 0;
+  if (demux_thread_) wakeups += demux_thread_->wakeups();
+  if (video_input_queue_) wakeups += video_input_queue_->wakeups();
+  if (audio_input_queue_) wakeups += audio_input_queue_->wakeups();
+  if (video_output_queue_) wakeups += video_output_queue_->wakeups();
+  if (audio_output_queue_) wakeups += audio_output_queue_->wakeups();
+  return wakeups;
+}
+
+void VideoPlayer::UpdateStats(bool force) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::TimeDelta elapsed = now - last_stats_time_;
+  if (!force && elapsed.InMicroseconds() < kStatsReportInterval)
+    return;
+  if (elapsed <= base::TimeDelta())
+    return;
+
+  //暂停期间不会调用到这里,恢复后的第一次统计覆盖了整个暂停时段
+  uint64_t wakeups = CountWakeups();
+  base::AutoLock l(stats_lock_);
+  stats_.wakeups = wakeups;
+  stats_.wakeups_per_second = (wakeups - last_stats_wakeups_) / elapsed.InSecondsF();
+  last_stats_wakeups_ = wakeups;
+  last_stats_time_ = now;
+  stats_.peak_packet_bytes = 0;
+  if (video_input_queue_) stats_.peak_packet_bytes += video_input_queue_->peak_bytes();
+  if (audio_input_queue_) stats_.peak_packet_bytes += audio_input_queue_->peak_bytes();
+  stats_.peak_frame_bytes = 0;
+  if (video_output_queue_) stats_.peak_frame_bytes += video_output_queue_->peak_bytes();
+  if (audio_output_queue_) stats_.peak_frame_bytes += audio_output_queue_->peak_bytes();
+  //这个周期内没有样本(EOS 之后,或者紧接着上一次统计的强制统计)时保留上一个周期的值
+  if (jitter_samples_.count() > 0) {
+    stats_.jitter_p50_us = jitter_samples_.Percentile(50);
+    stats_.jitter_p99_us = jitter_samples_.Percentile(99);
+    stats_.jitter_max_us = jitter_samples_.Max();
+    jitter_samples_.Reset();
+  }
+  if (av_drift_samples_.count() > 0) {
+    stats_.av_drift_p50_us = av_drift_samples_.Percentile(50);
+    stats_.av_drift_p99_us = av_drift_samples_.Percentile(99);
+    stats_.av_drift_max_us = av_drift_samples_.Max();
+    av_drift_samples_.Reset();
+  }
+  stats_.run_jitter_p50_us = run_jitter_.Percentile(50);
+  stats_.run_jitter_p99_us = run_jitter_.Percentile(99);
+  stats_.run_jitter_max_us = run_jitter_.Max();
+  stats_.run_av_drift_p50_us = run_av_drift_.Percentile(50);
+  stats_.run_av_drift_p99_us = run_av_drift_.Percentile(99);
+  stats_.run_av_drift_max_us = run_av_drift_.Max();
+  stats_.audio_clock_correction_us = audio_clock_correction_us_;
+  stats_.audio_resyncs = audio_resyncs_;
+  stats_.ttff_us = ttff_us_;
+  stats_.seeks = seeks_completed_;
+  stats_.seek_p50_us = seek_latency_.Percentile(50);
+  stats_.seek_p99_us = seek_latency_.Percentile(99);
+  stats_.accurate_seek_p50_us = accurate_seek_latency_.Percentile(50);
+  stats_.accurate_seek_p99_us = accurate_seek_latency_.Percentile(99);
+  {
+    base::AutoLock seek_lock(seek_lock_);
+    stats_.seeks_coalesced = seeks_coalesced_;
+  }
+  stats_.frames_dropped = frames_dropped_;
+  stats_.playback_rate = render_state_.rate;
+  stats_.audio_stretch_us = audio_stretch_us_;
+  stats_.loops = dataset_->loopCount();
+  if (clip_cache_) {
+    stats_.loops += clip_cache_->replays();
+    stats_.clip_cache_bytes = clip_cache_->bytes();
+    stats_.clip_cache_hits = clip_cache_->hits();
+  }
+  if (video_decoder_thread_) {
+    video_decoder_thread_->GetDecodeLatency(&stats_.decode_p50_us, &stats_.decode_p99_us);
+    stats_.seek_discarded_frames = video_decoder_thread_->seek_discarded_frames();
+    stats_.frames_skipped = video_decoder_thread_->skipped_frames();
+  }
+  //一直运行的设备上不定期打印,只在停止/播放完成时打印一次,数据随时可以通过 GetStats 获取
+  LOG_IF(INFO, force || DLOG_IS_ON(INFO)) << "pipeline wakeups/s: " << stats_.wakeups_per_second
+            << ", peak packet bytes: " << stats_.peak_packet_bytes
+            << ", peak frame bytes: " << stats_.peak_frame_bytes
+            << ", jitter p50/p99/max(us): " << stats_.jitter_p50_us
+            << "/" << stats_.jitter_p99_us << "/" << stats_.jitter_max_us
+            << ", decode p50/p99(us): " << stats_.decode_p50_us << "/" << stats_.decode_p99_us
+            << ", av drift p50/p99/max(us): " << stats_.av_drift_p50_us
+            << "/" << stats_.av_drift_p99_us << "/" << stats_.av_drift_max_us
+            << ", audio clock correction(us): " << stats_.audio_clock_correction_us
+            << ", resyncs: " << stats_.audio_resyncs
+            << ", clip cache bytes: " << stats_.clip_cache_bytes
+            << ", clip cache hits: " << stats_.clip_cache_hits
+            << ", frames dropped: " << stats_.frames_dropped
+            << ", frames skipped: " << stats_.frames_skipped;
+}
+
+void VideoPlayer::OnFlushCompleted(int stream_idx, int serial) {
   if (!thread_->IsCurrent()) {
-    thread_->PostTask(std::bind(&VideoPlayer::OnFlushCompleted, this, stream_idx));
+    thread_->PostTask(std::bind(&VideoPlayer::OnFlushCompleted, this, stream_idx, serial));
   } else {
-    if (render_state_.stream_seek_pending < 1)
+    if (render_state_.seek_pending_streams == 0)
       return; //当前没有seek
+    if (serial != seek_serial_)
+      return; //已经被新的 seek 取代
 
-    --render_state_.stream_seek_pending;
-    if (render_state_.stream_seek_pending == 0) {
+    render_state_.seek_pending_streams &=
+        stream_idx == dataset_->getVideoStreamIndex() ? ~kSeekVideoPending : ~kSeekAudioPending;
+    if (render_state_.seek_pending_streams == 0) {
       render_state_.Reset();
       OnRender();
     }
   }
 }
 
+void VideoPlayer::OnClipCacheDisabled() {
+  LOG(INFO) << "Clip cache disabled, fall back to gapless demux loop";
+  dataset_->setLoop(loop_);
+}
+
 void VideoPlayer::OnMediaError(int err) {
   delegate_->OnMediaError(err);
 }
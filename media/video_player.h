@@ -7,8 +7,12 @@
 #include "base/synchronization/lock.h"
 #include "base/timer/timer.h"
 #include "base/threading/thread.h"
-#include "base/timer/timer.h"
+#include "base/timer/high_res_timer.h"
+#include "base/metrics/log_histogram.h"
+#include "base/metrics/sample_stats.h"
 #include "media/ffmpeg_common.h"
+#include "media/playback_stats.h"
+#include "media/video_decoder.h"
 #include <rkmedia/rkmedia_api.h>
 #include <rockchip/mpp_frame.h>
 
@@ -20,6 +24,10 @@ class AudioFrameQueue;
 class RKAudioRender;
 class AudioDecoderThread;
 class VideoDecoderThread;
+class DemuxThread;
+class DecodedClipCache;
+class AudioTimeStretcher;
+class RKAudioBufferPool;
 
 enum MediaError {
   Error_VideoCodecUnsupported,
@@ -42,17 +50,87 @@ public:
  private:
   DISALLOW_COPY_AND_ASSIGN(Delegate);
  };
+ enum class BufferMode {
+   // 按 buffer_time 缓冲解码后的视频帧
+   kDecodedFrames,
+   // buffer_time 的缓冲放在压缩包队列中,解码后的视频帧只保留重排深度加上少量余量
+   kCompressedPackets,
+ };
+
+ enum class RenderMode {
+   // 每 kRenderPollDelay 检查一次,显示 pts <= render_time 的帧
+   kFixedPoll,
+   // 定时器对准音视频队列中下一帧的显示时间
+   kNextFrame,
+   // 不按时间戳等待,解码出来就立即送出,用来测量解码吞吐量,这个模式下不播放音频
+   kFreeRun,
+ };
+
+ enum class SeekMode {
+   // 回到目标之前最近的关键帧,从关键帧开始播放,最快
+   kKeyFrame,
+   // 从关键帧开始解码,目标之前的音视频帧在解码线程中丢弃,从目标位置开始播放
+   kAccurate,
+ };
+
+ enum class ClockMode {
+   // 以系统时钟(定时器)为基准,音频按时间戳送入 AO
+   kSystemClock,
+   // 以 AO 实际播放到的位置为基准,视频跟随音频,长时间播放时不会因为声卡时钟偏差而欠载
+   kAudioMaster,
+ };
+
+ struct Options {
+   bool enable_audio;
+   int volume;
+   bool loop;
+   double buffer_time; //秒
+   BufferMode buffer_mode;
+   RenderMode render_mode;
+   VideoDecoderType video_decoder;
+   ClockMode clock_mode;
+   // 循环播放时缓存整段解码结果的内存预算(字节),0 表示不缓存
+   // 估计的解码数据量超过预算的文件直接走普通的循环播放
+   size_t clip_cache_bytes;
+   // 解码出第一帧就立即显示,只缓冲重排深度加上少量余量就开始播放,其余的边播边缓冲
+   // 开始播放和 seek 之后都生效
+   bool fast_start;
+   // Seek(timestamp) 使用的 seek 方式
+   SeekMode seek_mode;
+   Options()
+       : enable_audio(true),
+         volume(-1),
+         loop(false),
+         buffer_time(0.8),
+         buffer_mode(BufferMode::kDecodedFrames),
+         render_mode(RenderMode::kFixedPoll),
+         video_decoder(VideoDecoderType::kAuto),
+         clock_mode(ClockMode::kSystemClock),
+         clip_cache_bytes(0),
+         fast_start(false),
+         seek_mode(SeekMode::kKeyFrame) {}
+ };
+
  explicit VideoPlayer(Delegate *delegate,
                       Mp4Dataset *dataset,
-                      bool enable_audio,
-                      int volume,
-                      bool loop,
-                      double buffer_time);
+                      const Options &options);
 
  virtual ~VideoPlayer();
 
+ // 可以在任意线程调用,连续调用时只执行最后一次,新的 seek 会取代还没完成的 seek
  void Seek(double timestamp);
 
+ void Seek(double timestamp, SeekMode mode);
+
+ // 快进快退: speed 为 2~32 倍快进,-2~-32 倍快退,超出范围时取最近的值,0/1/-1 回到正常播放
+ // 只解码关键帧,不播放音频,解码的帧数与速度无关
+ // 可以在任意线程调用,Seek 会退出快进快退
+ void SetTrickPlay(int speed);
+
+ // 播放速度 0.5~2.0,超出范围时取最近的值,音频变速不变调
+ // 可以在任意线程调用
+ void SetPlaybackRate(double rate);
+
  void SetVolume(int volume);
 
  void Mute(bool enable);
@@ -61,21 +139,33 @@ public:
 
  void Resume();
 
+ // 可以在任意线程调用
+ PlaybackStats GetStats();
+
 protected:
  Delegate *delegate() {
    return delegate_;
  }
 
- void OnFlushCompleted(int stream_idx);
+ // serial 是 flush 包对应的 seek 序号
+ void OnFlushCompleted(int stream_idx, int serial);
 
  void OnMediaError(int err);
 
+ // 解码帧缓存在填充过程中被放弃,退回到解封装线程无缝循环,可以在任意线程调用
+ void OnClipCacheDisabled();
+
 private:
  friend class VideoDecoderThread;
  friend class AudioDecoderThread;
+ friend class DemuxThread;
 
  void OnStart();
 
+ void OnSeek();
+
+ void OnSetTrickPlay(int speed);
+
  void OnStop();
 
  void InitAudio();
@@ -84,14 +174,63 @@ private:
 
  void InitAudioRender();
 
+ void InitDemux();
+
+ void InitClipCache();
+
+ // 按文件时长估计整段解码后的视频帧和 PCM 的字节数,无法估计时返回 0
+ size_t EstimateDecodedClipBytes(AVStream *audio_stream);
+
+ base::TimeDelta PacketBufferDuration() const;
+
+ static int AudioFrameSize(AVStream *stream);
+
+ int VideoReorderDepth();
+
  void OnRender();
 
  void ManageTimer(const base::TimeDelta &delay);
 
+ // 在绝对时间 deadline 运行 OnRender,不受 OnRender 本身耗时的影响
+ void ManageTimerAt(base::TimeTicks deadline);
+
+ // 音视频队列中最早一帧的显示时间
+ base::TimeTicks NextFrameTime();
+
+ void RecordPresentationJitter(int64_t pts);
+
+ // 根据显示的帧落后多少决定解码器是否跳过不参考的帧
+ void UpdateLateness(int64_t pts);
+
+ void SetDecoderSkip(bool skip);
+
+ void SendAudio();
+
+ // 变速时把一个音频 buffer 送入 stretcher,返回处理好的 buffer,还不够一段时返回 nullptr
+ // 输入的 buffer 在这里释放
+ MEDIA_BUFFER StretchAudio(MEDIA_BUFFER audio_buffer);
+
+ // 根据 AO 中剩余的 buffer 估计音频实际播放的位置,统计 A/V 偏差
+ // kAudioMaster 模式下据此修正基准时间
+ void UpdateAudioClock();
+
+ // RenderMode::kFreeRun 下送出队列中所有已解码的帧
+ void FreeRunRender();
+
+ // 开始播放之前是否还要继续缓冲,fast start 时顺便把第一帧显示出来
+ bool NeedPrebuffer();
+
+ void PresentFrame(MppFrame frame);
+
  void RenderCompleted();
 
  void RewindRender();
 
+ // force 为 true 时不管统计周期是否已到,立即更新
+ void UpdateStats(bool force);
+
+ uint64_t CountWakeups();
+
  Delegate *delegate_;
 
  Mp4Dataset *dataset_;
@@ -104,38 +243,175 @@ private:
 
  double buffer_time_;
 
+ BufferMode buffer_mode_;
+
+ RenderMode render_mode_;
+
+ VideoDecoderType video_decoder_type_;
+
+ ClockMode clock_mode_;
+
+ size_t clip_cache_bytes_;
+
+ bool fast_start_;
+
+ SeekMode seek_mode_;
+
+ // fast start 时开始走时钟前至少缓冲的帧数
+ size_t fast_start_frames_;
+
  bool mute_;
 
  struct RenderState {
    bool started;
    int64_t render_time;
    base::TimeTicks base_time; //基准时间,用来消除定时器误差
-   int stream_seek_pending;
-   RenderState() {
+   int seek_pending_streams; //还没有完成 flush 的 stream(kSeekVideoPending/kSeekAudioPending)
+   int64_t audio_sent_end; //最后送入 AO 的音频 buffer 的结束时间(微秒)
+   int audio_sent_count; //Reset 之后送入 AO 的 buffer 数
+   int64_t preroll_pts; //fast start 时开始走时钟之前已经显示的第一帧
+   double rate; //播放速度,Reset 时保留
+   RenderState() : rate(1.0) {
      Reset();
    }
    void Reset() {
      started = false;
      render_time = AV_NOPTS_VALUE;
      base_time = base::TimeTicks();
-     stream_seek_pending = 0;
+     seek_pending_streams = 0;
+     audio_sent_end = AV_NOPTS_VALUE;
+     audio_sent_count = 0;
+     preroll_pts = AV_NOPTS_VALUE;
    }
 
    void BasetimeCalibration() {
-     base_time = base::TimeTicks::Now() - base::TimeDelta::FromMicroseconds(render_time);
+     base_time = base::TimeTicks::Now() - ToWallDelta(render_time);
+   }
+
+   //播放时间(微秒)换算为基准时间之后的实际时间
+   base::TimeDelta ToWallDelta(int64_t media_time) const {
+     return base::TimeDelta::FromMicroseconds(static_cast<int64_t>(media_time / rate));
+   }
+
+   base::TimeTicks WallTime(int64_t media_time) const {
+     return base_time + ToWallDelta(media_time);
+   }
+
+   //实际时间 now 对应的播放时间(微秒)
+   int64_t MediaTime(base::TimeTicks now) const {
+     return static_cast<int64_t>((now - base_time).InMicroseconds() * rate);
    }
  };
 
  RenderState render_state_;
 
- std::unique_ptr<base::Timer> io_timer_;
+ base::Lock stats_lock_;
+
+ PlaybackStats stats_;
+
+ base::TimeTicks last_stats_time_;
+
+ uint64_t last_stats_wakeups_;
+
+ // 视频帧实际送出时间与理想显示时间之差(微秒),每个统计周期清空
+ base::SampleStats jitter_samples_;
+
+ // 音频实际播放位置与视频时钟之差的绝对值(微秒),每个统计周期清空
+ base::SampleStats av_drift_samples_;
+
+ // 和上面两个相同的样本,整个播放过程累计,不清空
+ base::LogHistogram run_jitter_;
+
+ base::LogHistogram run_av_drift_;
+
+ // 最近送入 AO 的 buffer 的时长(微秒)
+ int64_t audio_buffer_duration_;
+
+ // kAudioMaster 模式下对基准时间的累计修正(不含 resync)
+ int64_t audio_clock_correction_us_;
+
+ uint64_t audio_resyncs_;
+
+ base::TimeTicks start_time_;
+
+ // 从开始播放到第一帧送出的时间(微秒),还没有送出时为 -1
+ int64_t ttff_us_;
+
+ enum SeekPendingFlags {
+   kSeekVideoPending = 1,
+   kSeekAudioPending = 2,
+ };
+
+ // 当前 seek 的序号,只在 render 线程访问
+ int seek_serial_;
+
+ // 当前 seek 的发起时间,目标位置的第一帧送出后清空
+ base::TimeTicks seek_start_time_;
+
+ // 当前 seek 的方式
+ SeekMode current_seek_mode_;
+
+ // 快进快退的速度,0 表示正常播放,只在 render 线程访问
+ int trick_speed_;
+
+ // 最近送出的帧的时间戳,还没送出时为最近的 seek 目标(微秒),快进快退从这里开始
+ int64_t play_position_;
+
+ // 从发起 seek 到目标位置第一帧送出的时间(微秒),两种 seek 方式分开统计
+ base::SampleStats seek_latency_;
+
+ base::SampleStats accurate_seek_latency_;
+
+ uint64_t seeks_completed_;
+
+ // 以下由 seek_lock_ 保护,Seek 可以在任意线程调用
+ base::Lock seek_lock_;
+
+ double seek_target_;
+
+ SeekMode seek_target_mode_;
+
+ base::TimeTicks seek_request_time_;
+
+ bool seek_task_posted_;
+
+ // 被后来的 seek 取代的次数
+ uint64_t seeks_coalesced_;
+
+ std::unique_ptr<base::HighResTimer> io_timer_;
 
  std::unique_ptr<AudioDecoderThread> audio_decoder_thread_;
 
  std::unique_ptr<VideoDecoderThread> video_decoder_thread_;
 
+ std::unique_ptr<DemuxThread> demux_thread_;
+
+ std::unique_ptr<DecodedClipCache> clip_cache_;
+
  std::unique_ptr<RKAudioRender> audio_render_;
 
+ // 变速不变调,只在 render 线程访问
+ std::unique_ptr<AudioTimeStretcher> audio_stretcher_;
+
+ // stretcher 输出的 buffer 池,只在 render 线程访问
+ std::unique_ptr<RKAudioBufferPool> stretch_buffer_pool_;
+
+ // 音频是否经过 stretcher: 速度不是 1 时打开,回到 1 之后等到下一次 seek 才关闭,避免丢掉其中缓冲的样本
+ bool audio_stretching_;
+
+ int64_t audio_stretch_us_;
+
+ // 以下只在 render 线程访问
+ uint64_t frames_dropped_;
+
+ // 连续落后和连续准时的帧数
+ int late_frames_;
+
+ int on_time_frames_;
+
+ // 解码器是否正在跳过不参考的帧
+ bool decoder_skipping_;
+
  std::unique_ptr<PacketQueue> video_input_queue_;
 
  std::unique_ptr<PacketQueue> audio_input_queue_;
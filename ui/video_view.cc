@@ -9,6 +9,7 @@
 #include "media/rga_utils.h"
 #include "media/ffmpeg_common.h"
 #include "base/logging.h"
+#include "base/trace_event/trace_event.h"
 
 namespace ui {
 
@@ -55,6 +56,8 @@ void VideoView::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
   MppFrameFormat fmt = mpp_frame_get_fmt(frame_);
   RgaSURF_FORMAT rga_fmt = media::mpp_format_to_rga_format(fmt);
   int64_t pts = mpp_frame_get_pts(frame_);
+  TRACE_EVENT1("ui", "VideoView::paint", "pts", pts);
+  TRACE_EVENT_FLOW_END0("media", "VideoFrame", pts);
 
   if (buffer && rga_fmt != RK_FORMAT_UNKNOWN) {
     QRect src_rect(0, 0, width, height);
@@ -77,8 +80,19 @@ void VideoView::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 
 bool VideoView::start(const std::string &file, bool enable_audio, int volume, bool loop) {
   stop();
-  dataset_ = media::Mp4Dataset::create(file);
-  player_.reset(new media::VideoPlayer(this, dataset_.get(), enable_audio, volume, loop, 0.8));
+  media::Mp4Dataset::Options options;
+  options.use_mmap = true;
+  dataset_ = media::Mp4Dataset::create(file, options);
+  media::VideoPlayer::Options player_options;
+  player_options.enable_audio = enable_audio;
+  player_options.volume = volume;
+  player_options.loop = loop;
+  player_options.buffer_mode = media::VideoPlayer::BufferMode::kCompressedPackets;
+  player_options.render_mode = media::VideoPlayer::RenderMode::kNextFrame;
+  //广告片长时间循环播放,以声卡时钟为准
+  player_options.clock_mode = media::VideoPlayer::ClockMode::kAudioMaster;
+  player_options.fast_start = true;
+  player_.reset(new media::VideoPlayer(this, dataset_.get(), player_options));
   return true;
 }
 